@@ -0,0 +1,372 @@
+#pragma once
+
+#include "hazard_pointers.h"
+
+#include <atomic>
+#include <vector>
+
+namespace Stitch {
+
+using std::atomic;
+using std::vector;
+
+/*! \brief Unordered set stored in a contiguous array, replaced on every modification.
+ *
+ * Element type T must support equality comparison (operator '==').
+ *
+ * This is an alternative to \ref Set for sets which are iterated much
+ * more often than modified, for example lists of connections.
+ *
+ * The elements are stored in an immutable array. Insertion and removal
+ * create a modified copy of the array and atomically replace the old one,
+ * which is reclaimed using hazard pointers once no iterator uses it.
+ * An iterator therefore visits a consistent snapshot of the set,
+ * without ever restarting, and accesses elements contiguously in memory.
+ *
+ * Progress guarantees in method descriptions use the following parameters:
+ * - N = Number of elements currently in the set.
+ * - K = Number of hazard pointers in use.
+ * - H = Maximum allowable number of hazard pointers.
+ */
+
+template <typename T>
+class Array_Set
+{
+private:
+    struct Array
+    {
+        vector<T> items;
+    };
+
+    using Hazard_Pointer = Detail::Hazard_Pointer<Array>;
+
+    // Sets the hazard pointer to the current array and returns it.
+    static Array * protect(const atomic<Array*> & source, Hazard_Pointer & hp)
+    {
+        Array * a = source.load();
+
+        for(;;)
+        {
+            hp.pointer = a;
+            Array * b = source.load();
+            if (a == b)
+                return a;
+            a = b;
+        }
+    }
+
+    struct Guard
+    {
+        Guard(): hp(Detail::Hazard_Pointers::acquire<Array>()) {}
+        ~Guard() { hp.pointer = nullptr; hp.release(); }
+        Hazard_Pointer & hp;
+    };
+
+    // Replaces the array with a new one computed by 'modify(old, new)'.
+    // A null array represents an empty set.
+    // 'modify' returns false if no change is needed.
+    template <typename F>
+    bool replace(F modify)
+    {
+        Guard guard;
+
+        for(;;)
+        {
+            Array * old_array = protect(d_array, guard.hp);
+            Array * new_array = nullptr;
+
+            if (!modify(old_array, new_array))
+                return false;
+
+            if (d_array.compare_exchange_strong(old_array, new_array))
+            {
+                guard.hp.pointer = nullptr;
+                if (old_array)
+                    Detail::Hazard_Pointers::reclaim(old_array);
+                return true;
+            }
+
+            delete new_array;
+        }
+    }
+
+    static bool contains(const Array * a, const T & value)
+    {
+        if (!a)
+            return false;
+
+        for (const T & item : a->items)
+        {
+            if (item == value)
+                return true;
+        }
+
+        return false;
+    }
+
+    atomic<Array*> d_array { nullptr };
+
+public:
+
+    /*!
+     * \brief Default constructor.
+     *
+     * - Progress: Wait-free
+     * - Time complexity: O(1)
+     */
+
+    Array_Set() {}
+
+    /*!
+     * \brief Destructor.
+     *
+     * - Progress: Blocking
+     * - Time complexity: O(N)
+     */
+
+    ~Array_Set()
+    {
+        delete d_array.load();
+    }
+
+    Array_Set(const Array_Set &) = delete;
+    Array_Set & operator=(const Array_Set &) = delete;
+
+    /*!
+     * \brief Returns whether the set contains no elements.
+     *
+     * - Progress: Wait-free
+     * - Time complexity: O(1)
+     */
+
+    bool empty() const
+    {
+        return d_array.load() == nullptr;
+    }
+
+    /*!
+     * \brief Inserts the given value if it is not already in the set.
+     *
+     * Throws std::runtime_error if a hazard pointer can not be allocated.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: Asymptotic O(N). Worst-case O(N + H).
+     */
+
+    void insert(const T & value)
+    {
+        replace([&](const Array * old_array, Array *& new_array)
+        {
+            if (contains(old_array, value))
+                return false;
+
+            new_array = new Array;
+            if (old_array)
+            {
+                new_array->items.reserve(old_array->items.size() + 1);
+                new_array->items = old_array->items;
+            }
+            new_array->items.push_back(value);
+            return true;
+        });
+    }
+
+    /*!
+     * \brief Removes the given value if it is in the set.
+     *
+     * Returns whether the value was in the set.
+     *
+     * Throws std::runtime_error if a hazard pointer can not be allocated.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: Asymptotic O(N). Worst-case O(N + H).
+     */
+
+    bool remove(const T & value)
+    {
+        return replace([&](const Array * old_array, Array *& new_array)
+        {
+            if (!contains(old_array, value))
+                return false;
+
+            if (old_array->items.size() > 1)
+            {
+                new_array = new Array;
+                new_array->items.reserve(old_array->items.size() - 1);
+                for (const T & item : old_array->items)
+                {
+                    if (!(item == value))
+                        new_array->items.push_back(item);
+                }
+            }
+
+            return true;
+        });
+    }
+
+    /*!
+     * \brief Removes all elements.
+     *
+     * - Progress: Wait-free
+     * - Time complexity: Asymptotic O(1). Worst-case O(N + H).
+     */
+
+    void clear()
+    {
+        Array * old_array = d_array.exchange(nullptr);
+        if (old_array)
+            Detail::Hazard_Pointers::reclaim(old_array);
+    }
+
+    /*!
+     * \brief Returns whether the given value is in the set.
+     *
+     * - Progress: Lock-free.
+     * - Time complexity: O(N)
+     */
+
+    bool contains(const T & value)
+    {
+        for (const T & v : *this)
+        {
+            if (v == value)
+                return true;
+        }
+
+        return false;
+    }
+
+    /*!
+     * \brief Iterates over a snapshot of the set taken by \ref begin.
+     *
+     * Elements inserted or removed after the snapshot was taken
+     * do not affect the iteration.
+     */
+    struct Iterator
+    {
+        // End iterator
+        Iterator() {}
+
+        Iterator(const atomic<Array*> & source):
+            hp(&Detail::Hazard_Pointers::acquire<Array>())
+        {
+            array = protect(source, *hp);
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        Iterator(const Iterator & other)
+        {
+            *this = other;
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        Iterator & operator=(const Iterator & other)
+        {
+            if (this == &other)
+                return *this;
+
+            if (other.hp && !hp)
+                hp = &Detail::Hazard_Pointers::acquire<Array>();
+
+            // The array is still protected by 'other'.
+            if (hp)
+                hp->pointer = other.array;
+
+            array = other.array;
+            index = other.index;
+
+            return *this;
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        ~Iterator()
+        {
+            if (hp)
+            {
+                hp->pointer = nullptr;
+                hp->release();
+            }
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        bool operator==(const Iterator & other) const
+        {
+            if (at_end() || other.at_end())
+                return at_end() && other.at_end();
+
+            return array == other.array && index == other.index;
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        bool operator!=(const Iterator & other) const
+        {
+            return !(*this == other);
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        T & operator*()
+        {
+            return array->items[index];
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        Iterator & operator++()
+        {
+            ++index;
+            return *this;
+        }
+
+    private:
+        bool at_end() const
+        {
+            return !array || index >= array->items.size();
+        }
+
+        Hazard_Pointer * hp = nullptr;
+        Array * array = nullptr;
+        size_t index = 0;
+    };
+
+    /*!
+     * Throws std::runtime_error if a hazard pointer can not be allocated.
+     *
+     * - Progress: Lock-free. Retries only if the set is concurrently modified.
+     * - Time complexity: O(1).
+     */
+    Iterator begin()
+    {
+        return Iterator(d_array);
+    }
+
+    /*!
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    Iterator end()
+    {
+        return Iterator();
+    }
+};
+
+}
@@ -2,6 +2,7 @@
 
 #include <atomic>
 #include <cstdint>
+#include <new>
 
 #include "hazard_pointers.h"
 
@@ -33,26 +34,114 @@ public:
         d_current(new Node(value, 1))
     {}
 
+    /*!
+    \brief Constructs the Atom with nodes for `capacity` readers and writers.
+
+    All nodes are allocated up front in a contiguous block of memory,
+    so constructing up to `capacity` \ref AtomReader "AtomReaders" and
+    \ref AtomWriter "AtomWriters" at the same time does not allocate memory.
+    When more are constructed, additional nodes are allocated individually.
+
+    Each node is aligned to a cache line.
+    */
+    Atom(const T & value, int capacity)
+    {
+        d_pool_size = capacity + 1;
+        d_pool = static_cast<Node*>(::operator new(sizeof(Node) * d_pool_size, std::align_val_t(alignof(Node))));
+
+        for (int i = 0; i < d_pool_size; ++i)
+            new (&d_pool[i]) Node(value, 0);
+
+        d_pool[0].ref = 1;
+        d_current = &d_pool[0];
+
+        for (int i = d_pool_size - 1; i > 0; --i)
+            push(d_spare, &d_pool[i]);
+    }
+
     ~Atom()
     {
         Node * c = d_current.load();
-        delete c;
+
+        // Release history nodes except the current one, which is deleted below.
+        for (int i = 0; i < d_history_size; ++i)
+        {
+            Node * n = d_history[i].load().node;
+            if (n && n != c)
+                unref(n);
+        }
+        delete[] d_history;
+
+        if (!is_pooled(c))
+            delete c;
+
+        // Nodes allocated by acquire_or_allocate may remain in free list.
+        while(Node * n = acquire())
+        {
+            if (!is_pooled(n))
+                delete n;
+        }
+
+        if (d_pool)
+        {
+            for (int i = 0; i < d_pool_size; ++i)
+                d_pool[i].~Node();
+
+            ::operator delete(d_pool, std::align_val_t(alignof(Node)));
+        }
     }
 
     Atom(const Atom &) = delete;
     Atom & operator=(const Atom &) = delete;
 
+    /*!
+    \brief Keeps the last `size` stored values, so they can be replayed
+    using \ref AtomReader::load_since.
+
+    The values are kept in the nodes which were current,
+    so storing does not copy values. However, up to `size`
+    additional nodes remain allocated.
+
+    Must be called before the Atom is used by other threads,
+    and at most once.
+    */
+    void keep_history(int size)
+    {
+        d_history_size = size;
+        d_history = new atomic<History_Entry>[size];
+        for (int i = 0; i < size; ++i)
+            d_history[i] = History_Entry();
+
+        Node * c = d_current.load();
+        c->version = d_version.load();
+        c->ref.fetch_add(1);
+        d_history[c->version % size] = History_Entry { c->version, c };
+    }
+
+    int history_size() const { return d_history_size; }
+
 private:
-    struct Node
+    struct alignas(64) Node
     {
         Node(int refcount): ref(refcount) {}
         Node(const T & value, int refcount): value(value), ref(refcount) {}
         Node(const Node &) = delete;
         Node & operator=(const Node &) = delete;
 
-        Node * next = nullptr;
+        // Atomic because a popping thread may read it while
+        // another thread pops the same node and pushes it again.
+        atomic<Node*> next { nullptr };
         T value {};
         atomic<int> ref;
+        // Version of the value, if history is kept.
+        // Set before the node is made current.
+        uint64_t version = 0;
+    };
+
+    struct History_Entry
+    {
+        uint64_t version = 0;
+        Node * node = nullptr;
     };
 
     struct Head
@@ -77,12 +166,31 @@ private:
         // so that node is still valid if allocation fails and
         // throws exception.
         Detail::Hazard_Pointer<Node> & hp = Detail::Hazard_Pointers::acquire<Node>();
-        auto & h = hp.pointer;
 
         unref(node);
 
-        for(;; c = d_current.load())
+        return ref_current(hp);
+    }
+
+    // Get current and increase its reference count.
+
+    // If hazard pointer can't be allocated, throws exception.
+    Node * ref_current()
+    {
+        return ref_current(Detail::Hazard_Pointers::acquire<Node>());
+    }
+
+    // Get current and increase its reference count,
+    // using and then releasing the given hazard pointer.
+    Node * ref_current(Detail::Hazard_Pointer<Node> & hp)
+    {
+        auto & h = hp.pointer;
+
+        Node * c;
+
+        for(;;)
         {
+            c = d_current.load();
             // Protect the node being deleted while we inspect it.
             h = c;
             if (d_current != h)
@@ -94,8 +202,13 @@ private:
             int ref = c->ref.load();
             if (ref == 0)
                 continue;
-            if (c->ref.compare_exchange_weak(ref, ref+1))
+            if (!c->ref.compare_exchange_weak(ref, ref+1))
+                continue;
+            // The node may have been reused by a new reader or writer
+            // since it was current, so check that it is still current.
+            if (d_current.load() == c)
                 break;
+            unref(c);
         }
 
         h = nullptr;
@@ -110,21 +223,262 @@ private:
     // Acquire and return new node.
     Node * make_current(Node * n)
     {
+        if (d_history)
+        {
+            // The version of the node must follow the one it replaces,
+            // so the node is made current as in an update.
+            for(;;)
+            {
+                Node * c = ref_current();
+                bool ok = replace_current(c, n);
+                unref(c);
+                if (ok)
+                    return acquire_or_allocate();
+            }
+        }
+
         n->ref.store(1);
 
         Node * old = d_current.exchange(n);
 
+        d_version.fetch_add(1, std::memory_order_release);
+
         unref(old);
 
-        return acquire();
+        return acquire_or_allocate();
+    }
+
+    // Assuming: node has reference count 0
+    // If 'expected' is current, set reference count of 'n' to 1,
+    // make it current, and reduce reference count of 'expected'.
+    // Returns whether 'n' was made current.
+    // If not, 'n' may be replaced by a copy (see retract).
+    // Assuming: 'expected' is referenced by the caller.
+    bool replace_current(Node * expected, Node *& n)
+    {
+        if (!d_history)
+        {
+            n->ref.store(1);
+
+            if (!d_current.compare_exchange_strong(expected, n))
+            {
+                retract(n, 1);
+                return false;
+            }
+
+            d_version.fetch_add(1, std::memory_order_release);
+
+            unref(expected);
+
+            return true;
+        }
+
+        // Each version is recorded before it is replaced,
+        // so versions are recorded in order.
+        record(expected, expected->version);
+
+        // One reference for the history.
+        // The version is published together with the node.
+        uint64_t version = expected->version + 1;
+        n->ref.store(2);
+        n->version = version;
+
+        if (!d_current.compare_exchange_strong(expected, n))
+        {
+            retract(n, 2);
+            return false;
+        }
+
+        // Once current, the node may be replaced, recorded
+        // and released by other writers, so it is not accessed anymore.
+        record(n, version);
+
+        unref(expected);
+
+        return true;
+    }
+
+    // Takes back the references of a node which was not made current.
+    // A reader may have found the node while it could have been made current,
+    // and holds a reference until it sees otherwise.
+    // Then the node is left to the reader to release, and replaced by a copy.
+    void retract(Node *& n, int refs)
+    {
+        int ref = refs;
+        if (n->ref.compare_exchange_strong(ref, 0))
+            return;
+
+        Node * copy = acquire_or_allocate();
+        copy->value = n->value;
+        unref(n, refs);
+        n = copy;
+    }
+
+    // Puts a node which is or was current into history,
+    // replacing the node with the version 'history size' older,
+    // unless this or a newer version is already recorded.
+    // Then advances d_version to the version of the node.
+
+    // Called by the writer which made the node current, and by any writer
+    // about to replace it, so each version is recorded exactly once,
+    // and only after all older versions.
+    // Assuming: the node has a reference for the history until it is recorded.
+    // Once recorded, the node may be released, but then a newer version
+    // is recorded in its place, so it is not accessed.
+    void record(Node * n, uint64_t version)
+    {
+        auto & slot = d_history[version % d_history_size];
+        History_Entry entry = slot.load();
+
+        while (entry.version < version || !entry.node)
+        {
+            if (slot.compare_exchange_weak(entry, History_Entry { version, n }))
+            {
+                if (entry.node)
+                    unref(entry.node);
+                break;
+            }
+        }
+
+        uint64_t latest = d_version.load();
+        while (latest < version &&
+               !d_version.compare_exchange_weak(latest, version, std::memory_order_release))
+        {}
+    }
+
+    enum History_Result
+    {
+        Found,
+        // Not recorded yet.
+        Not_Yet,
+        // Replaced by a newer version.
+        Replaced
+    };
+
+    // Gets the node with the given version from history and increases its reference count.
+    Node * ref_history(uint64_t version, Detail::Hazard_Pointer<Node> & hp, History_Result & result)
+    {
+        auto & slot = d_history[version % d_history_size];
+        auto & h = hp.pointer;
+
+        History_Entry entry;
+        Node * n;
+
+        for(;;)
+        {
+            entry = slot.load();
+            n = entry.node;
+            if (!n)
+            {
+                result = Not_Yet;
+                return nullptr;
+            }
+            h = n;
+            if (slot.load().node != n)
+                continue;
+            // While in history, the node has a reference.
+            // If the count is 0, it was just removed from history.
+            int ref = n->ref.load();
+            if (ref == 0)
+                continue;
+            if (!n->ref.compare_exchange_weak(ref, ref+1))
+                continue;
+            // The node may have been reused since, so check it is still in history.
+            History_Entry current = slot.load();
+            if (current.node == n && current.version == entry.version)
+                break;
+            unref(n);
+        }
+
+        h = nullptr;
+
+        if (entry.version == version)
+        {
+            result = Found;
+            return n;
+        }
+
+        result = entry.version < version ? Not_Yet : Replaced;
+        unref(n);
+        return nullptr;
+    }
+
+    // Calls fn(value, version) for each value stored after 'version' (see AtomReader::load_since).
+    template <typename F>
+    uint64_t replay(uint64_t version, F & fn)
+    {
+        if (d_version.load(std::memory_order_acquire) <= version)
+            return version;
+
+        if (d_history)
+        {
+            Detail::Hazard_Pointer<Node> & hp = Detail::Hazard_Pointers::acquire<Node>();
+
+            History_Result result = Found;
+
+            for(;;)
+            {
+                Node * n = ref_history(version + 1, hp, result);
+                if (!n)
+                    break;
+
+                try { fn(static_cast<const T&>(n->value), version + 1); }
+                catch (...) { unref(n); hp.release(); throw; }
+
+                unref(n);
+                ++version;
+            }
+
+            if (result == Not_Yet)
+            {
+                hp.release();
+                return version;
+            }
+
+            // Values were lost: pass the latest one in history.
+            uint64_t latest = d_version.load(std::memory_order_acquire);
+
+            for(;;)
+            {
+                Node * n = ref_history(latest, hp, result);
+
+                if (n)
+                {
+                    hp.release();
+
+                    try { fn(static_cast<const T&>(n->value), latest); }
+                    catch (...) { unref(n); throw; }
+
+                    unref(n);
+                    return latest;
+                }
+
+                if (result == Not_Yet)
+                    --latest; // Being recorded by a writer
+                else
+                    latest = d_version.load(std::memory_order_acquire);
+            }
+        }
+
+        // No history: pass the current value.
+        // The version is read first, so the value is at least as new.
+        uint64_t latest = d_version.load(std::memory_order_acquire);
+        Node * c = ref_current();
+
+        try { fn(static_cast<const T&>(c->value), latest); }
+        catch (...) { unref(c); throw; }
+
+        unref(c);
+
+        return latest;
     }
 
     // Reduce reference count and release node if count is 0
-    void unref(Node * n)
+    void unref(Node * n, int count = 1)
     {
-        int last_ref = n->ref.fetch_sub(1);
+        int last_ref = n->ref.fetch_sub(count);
 
-        if (last_ref == 1)
+        if (last_ref == count)
         {
             release(n);
         }
@@ -132,33 +486,104 @@ private:
 
     // Put node into free list
     void release(Node * n)
+    {
+        push(d_free, n);
+    }
+
+    // Get node from free list
+    Node * acquire()
+    {
+        return pop(d_free);
+    }
+
+    // Get node from free list, or allocate one if the list is empty.
+    // The list can be empty while a writer is in the middle of an update,
+    // because it holds an additional node.
+    Node * acquire_or_allocate()
+    {
+        Node * n = acquire();
+        if (!n)
+            n = new Node(0);
+        return n;
+    }
+
+    // Get a node for a new reader or writer
+    Node * allocate(const T & value, int refcount)
+    {
+        Node * n = pop(d_spare);
+        if (!n)
+            return new Node(value, refcount);
+
+        n->value = value;
+        n->ref.store(refcount);
+        return n;
+    }
+
+    // Give back a node when a reader or writer is destroyed
+    void deallocate(Node * n)
+    {
+        if (!n)
+            return;
+
+        // Pooled nodes are only destroyed together with the Atom,
+        // so they can be reused while other threads still hold
+        // hazard pointers to them, just like nodes in the free list.
+        if (is_pooled(n))
+            push(d_spare, n);
+        else
+            Detail::Hazard_Pointers::reclaim(n);
+    }
+
+    bool is_pooled(Node * n) const
+    {
+        return n >= d_pool && n < d_pool + d_pool_size;
+    }
+
+    static void push(atomic<Head> & list, Node * n)
     {
         for(;;)
         {
-            auto head = d_free.load();
-            n->next = head.first;
+            auto head = list.load();
+            n->next.store(head.first, std::memory_order_relaxed);
             Head new_head { head.version + 1, n };
-            if(d_free.compare_exchange_weak(head, new_head))
+            if(list.compare_exchange_weak(head, new_head))
                 break;
         }
     }
 
-    // Get node from free list
-    Node * acquire()
+    static Node * pop(atomic<Head> & list)
     {
         for (;;)
         {
-            auto head = d_free.load();
+            auto head = list.load();
             if (!head.first)
                 return nullptr;
-            Head new_head { head.version + 1, head.first->next };
-            if(d_free.compare_exchange_weak(head, new_head))
+            Head new_head { head.version + 1, head.first->next.load(std::memory_order_relaxed) };
+            if(list.compare_exchange_weak(head, new_head))
                 return head.first;
         }
     }
 
     atomic<Node*> d_current { nullptr };
     atomic<Head> d_free;
+
+    // Preallocated nodes
+    Node * d_pool = nullptr;
+    int d_pool_size = 0;
+    // Pooled nodes not used by any reader or writer
+    atomic<Head> d_spare;
+
+    // Nodes with the last stored values, indexed by version modulo size.
+    // Entries include the version, so a slot is not replaced by an older
+    // version even if the node it holds was reused.
+    atomic<History_Entry> * d_history = nullptr;
+    int d_history_size = 0;
+
+    // Number of stores. Incremented after a new node is made current,
+    // and if history is kept, after it is recorded.
+    // Kept on its own cache line, so polling it does not contend with
+    // the free list.
+    alignas(64) atomic<uint64_t> d_version { 0 };
 };
 
 template <typename T>
@@ -169,14 +594,14 @@ class AtomWriter
 public:
     AtomWriter(Atom<T> & atom, T value = T()):
         d_atom(atom),
-        d_node(new Node(value, 0))
+        d_node(atom.allocate(value, 0))
     {}
 
     ~AtomWriter()
     {
         // Since we allocated a node in constructor,
-        // reclaim one now.
-        Detail::Hazard_Pointers::reclaim(d_node);
+        // deallocate one now.
+        d_atom.deallocate(d_node);
     }
 
     AtomWriter(const AtomWriter &) = delete;
@@ -195,6 +620,55 @@ public:
         store();
     }
 
+    /*!
+    \brief Modifies the current value using `fn` and publishes the result.
+
+    The current value is copied into \ref value, and `fn` is called
+    with a reference to it. The result is stored only if the current value
+    has not been replaced in the meantime (by this or other writers).
+    Otherwise, this is repeated with the new current value.
+    Hence, concurrent updates by multiple writers are not lost,
+    unlike with \ref store.
+
+    Since `fn` may be called multiple times, it should only modify its argument.
+
+    Nodes are recycled between retries, so this does not allocate memory,
+    except if nodes temporarily run out because of concurrent updates.
+
+    Throws std::runtime_error if a hazard pointer can not be allocated.
+
+    - Progress: Lock-free
+    */
+    template <typename F>
+    void update(F && fn)
+    {
+        for(;;)
+        {
+            Node * c = d_atom.ref_current();
+
+            try
+            {
+                d_node->value = c->value;
+                fn(d_node->value);
+            }
+            catch (...)
+            {
+                d_atom.unref(c);
+                throw;
+            }
+
+            bool ok = d_atom.replace_current(c, d_node);
+
+            d_atom.unref(c);
+
+            if (ok)
+            {
+                d_node = d_atom.acquire_or_allocate();
+                return;
+            }
+        }
+    }
+
 private:
     Atom<T> & d_atom;
     Node * d_node;
@@ -208,7 +682,7 @@ class AtomReader
 public:
     AtomReader(Atom<T> & atom, T value = T()):
         d_atom(atom),
-        d_node(new Node(value, 1))
+        d_node(atom.allocate(value, 1))
     {}
 
     AtomReader(const AtomReader &) = delete;
@@ -219,22 +693,98 @@ public:
         d_atom.unref(d_node);
 
         // Since we allocated a node in constructor,
-        // reclaim one now.
+        // deallocate one now.
         Node * node = d_atom.acquire();
-        Detail::Hazard_Pointers::reclaim(node);
+        d_atom.deallocate(node);
     }
 
     const T & value() { return d_node->value; }
 
     const T & load()
     {
+        // Read version before the node, so that the node
+        // is at least as new as the version.
+        d_version = d_atom.d_version.load(std::memory_order_acquire);
         d_node = d_atom.get_current(d_node);
         return d_node->value;
     }
 
+    /*!
+    \brief Returns the number of values stored in the Atom so far.
+
+    - Progress: Wait-free
+    - Time complexity: O(1)
+    */
+    uint64_t version() const
+    {
+        return d_atom.d_version.load(std::memory_order_relaxed);
+    }
+
+    /*!
+    \brief Whether a value was stored since the last \ref load.
+
+    Before the first load, this returns true.
+
+    This is a single relaxed atomic load and does not touch the nodes
+    or their reference counts, so it is cheap to call frequently.
+
+    - Progress: Wait-free
+    - Time complexity: O(1)
+    */
+    bool changed() const
+    {
+        return version() != d_version;
+    }
+
+    /*!
+    \brief Loads the current value if \ref changed returns true.
+
+    \return Whether the value was loaded.
+
+    - Progress: Wait-free if not changed, otherwise same as \ref load.
+    */
+    bool load_if_changed()
+    {
+        if (!changed())
+            return false;
+        load();
+        return true;
+    }
+
+    /*!
+    \brief Passes each value stored after `version` to `fn`, in order of storing.
+
+    `fn` is called as `fn(const T & value, uint64_t version)`,
+    with a reference to the value kept in the Atom's history
+    (see \ref Atom::keep_history), so values are not copied.
+
+    If some of the values are no longer in history,
+    `fn` is instead called once with the latest value in history.
+    If history is not kept, `fn` is called once with the current value,
+    and the version passed is the version at the time of loading,
+    or older if values are stored concurrently.
+
+    Does not change \ref value.
+
+    \return The version of the last value passed to `fn`,
+    or `version` if no value was stored since.
+
+    Throws std::runtime_error if a hazard pointer can not be allocated.
+
+    - Progress: Lock-free
+    - Time complexity: O(number of values passed)
+    */
+    template <typename F>
+    uint64_t load_since(uint64_t version, F && fn)
+    {
+        return d_atom.replay(version, fn);
+    }
+
 private:
     Atom<T> & d_atom;
     Node * d_node;
+    // Version at the last load
+    uint64_t d_version = ~uint64_t(0);
 };
 
 }
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+namespace Stitch {
+
+using std::atomic;
+using std::array;
+
+/*!
+\brief Multi-writer-multi-reader atomically updated container of a single value of type T.
+
+Type T must be trivially copyable.
+This class is intended for small values (a few cache lines).
+
+This class is a sequence lock:
+Writers serialize by atomically changing the sequence number from even to odd,
+and readers retry copying the value until the sequence number is even and unchanged.
+Readers never write to shared memory, so loading has lower latency than
+with \ref Atom, and writing by multiple threads is safe, unlike with \ref SPMC_Atom.
+
+The value is stored in atomic words accessed with relaxed ordering, so
+concurrent copying is well defined.
+
+The container contains no pointers, so it can be placed
+in memory shared between processes.
+
+It will operate correctly as long as less than 2^63 values are stored
+during a single \ref load.
+*/
+
+template <typename T>
+class MPMC_Atom
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Value type must be trivially copyable.");
+
+public:
+    static bool is_lockfree()
+    {
+        return atomic<uint64_t>::is_always_lock_free;
+    }
+
+    /*!
+     * \brief Constructs the container with a default-constructed value.
+     */
+    MPMC_Atom(): MPMC_Atom(T()) {}
+
+    /*!
+     * \brief Constructs the container with a given value.
+     */
+    MPMC_Atom(const T & value)
+    {
+        write(value);
+    }
+
+    MPMC_Atom(const MPMC_Atom &) = delete;
+    MPMC_Atom & operator=(const MPMC_Atom &) = delete;
+
+    /*!
+    \brief Store `value` in the container.
+
+    Waits while another writer is storing.
+
+    - Progress: Blocking (with respect to other writers)
+    - Time complexity: O(size of T)
+    */
+    void store(const T & value)
+    {
+        uint64_t sequence = lock();
+        write(value);
+        unlock(sequence);
+    }
+
+    /*!
+    \brief Modifies the stored value using `fn`.
+
+    Calls `fn` with a reference to a copy of the current value and
+    stores the result. No other writer can store in the meantime,
+    so concurrent updates are not lost.
+
+    `fn` should be short, since other writers wait for it.
+
+    If `fn` throws, the stored value is not changed and the exception is propagated.
+
+    - Progress: Blocking (with respect to other writers)
+    - Time complexity: O(size of T) plus `fn`.
+    */
+    template <typename F>
+    void update(F && fn)
+    {
+        uint64_t sequence = lock();
+
+        try
+        {
+            T value = read();
+            fn(value);
+            write(value);
+        }
+        catch (...)
+        {
+            cancel(sequence);
+            throw;
+        }
+
+        unlock(sequence);
+    }
+
+    /*!
+    \brief Load the last value stored in the container.
+
+    Retries while a writer is storing.
+
+    - Progress: Lock-free (with respect to writers)
+    - Time complexity: O(size of T)
+    */
+    T load() const
+    {
+        for(;;)
+        {
+            uint64_t before = d_sequence.load(std::memory_order_acquire);
+
+            if (before & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            T value = read();
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            uint64_t after = d_sequence.load(std::memory_order_relaxed);
+
+            if (before == after)
+                return value;
+        }
+    }
+
+    /*!
+    \brief Returns the number of values stored so far.
+
+    - Progress: Wait-free
+    - Time complexity: O(1)
+    */
+    uint64_t version() const
+    {
+        return d_sequence.load(std::memory_order_relaxed) / 2;
+    }
+
+private:
+    static constexpr int Word_Count = (sizeof(T) + 7) / 8;
+
+    uint64_t lock()
+    {
+        for(;;)
+        {
+            uint64_t sequence = d_sequence.load(std::memory_order_relaxed);
+
+            if (sequence & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            if (d_sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire))
+            {
+                // Order the following writes of data after the sequence change.
+                std::atomic_thread_fence(std::memory_order_release);
+                return sequence;
+            }
+        }
+    }
+
+    void unlock(uint64_t sequence)
+    {
+        d_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Releases the lock without storing a value.
+    // Nothing was written, so readers may still use copies made before locking.
+    void cancel(uint64_t sequence)
+    {
+        d_sequence.store(sequence, std::memory_order_release);
+    }
+
+    T read() const
+    {
+        array<uint64_t, Word_Count> words;
+
+        for (int i = 0; i < Word_Count; ++i)
+            words[i] = d_words[i].load(std::memory_order_relaxed);
+
+        // Copied via bytes, so T need not be default-constructible.
+        array<unsigned char, sizeof(T)> bytes;
+        std::memcpy(bytes.data(), words.data(), sizeof(T));
+        return std::bit_cast<T>(bytes);
+    }
+
+    void write(const T & value)
+    {
+        auto bytes = std::bit_cast<array<unsigned char, sizeof(T)>>(value);
+
+        array<uint64_t, Word_Count> words {};
+        std::memcpy(words.data(), bytes.data(), sizeof(T));
+
+        for (int i = 0; i < Word_Count; ++i)
+            d_words[i].store(words[i], std::memory_order_relaxed);
+    }
+
+    alignas(64) atomic<uint64_t> d_sequence { 0 };
+    array<atomic<uint64_t>, Word_Count> d_words;
+};
+
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace Stitch {
+
+using std::atomic;
+using std::array;
+
+/*!
+\brief Wait-free atomically updated container of a single value of type T,
+with a single writer and at most `Max_Readers` concurrent readers.
+
+Unlike \ref SPMC_Atom, loading never retries, regardless of how often
+the value is stored, so the latency of \ref load is bounded
+by the time to copy a value.
+
+The container has `Max_Readers + 2` copies of the value
+(triple buffering in case of a single reader).
+A reader claims the copy with the latest value and copies it out,
+while the writer stores new values into copies which are not claimed by any reader.
+Since each of at most `Max_Readers` concurrent readers claims at most one copy,
+there is always a copy available to the writer besides the latest one.
+
+If more than `Max_Readers` threads load at the same time,
+\ref store may fail to find an available copy.
+
+A single atomic 64-bit word is used to publish the latest copy and
+count the readers claiming it. It will operate correctly as long as
+\ref load is executed less than 2^56 times between two stores.
+*/
+
+template <typename T, int Max_Readers = 1>
+class Waitfree_SPMC_Atom
+{
+    static_assert(Max_Readers > 0, "Max_Readers must be positive.");
+
+public:
+    static constexpr int Copy_Count = Max_Readers + 2;
+
+    static bool is_lockfree()
+    {
+        return atomic<uint64_t>::is_always_lock_free;
+    }
+
+    /*!
+     * \brief Constructs the container with a default-constructed value.
+     */
+    Waitfree_SPMC_Atom() {}
+
+    /*!
+     * \brief Constructs the container with a given value.
+     */
+    Waitfree_SPMC_Atom(const T & value)
+    {
+        d_copies[0].value = value;
+    }
+
+    Waitfree_SPMC_Atom(const Waitfree_SPMC_Atom &) = delete;
+    Waitfree_SPMC_Atom & operator=(const Waitfree_SPMC_Atom &) = delete;
+
+    /*!
+    \brief Store `value` in the container.
+
+    Must not be called by multiple threads concurrently.
+
+    \return True on success.
+    False if more than `Max_Readers` readers are loading concurrently
+    and so no copy is available for writing.
+
+    - Progress: Wait-free
+    - Time complexity: O(Max_Readers) plus the time to copy the value.
+    */
+    bool store(const T & value)
+    {
+        int target = -1;
+
+        for (int i = 0; i < Copy_Count; ++i)
+        {
+            if (i == d_latest_index)
+                continue;
+
+            Copy & copy = d_copies[i];
+            if (copy.released.load(std::memory_order_acquire) == copy.claimed)
+            {
+                target = i;
+                break;
+            }
+        }
+
+        if (target < 0)
+            return false;
+
+        d_copies[target].value = value;
+
+        uint64_t old = d_latest.exchange(uint64_t(target) << Index_Shift, std::memory_order_acq_rel);
+
+        // Readers that claimed the previous copy will release it later.
+        d_copies[d_latest_index].claimed += old & Count_Mask;
+
+        d_latest_index = target;
+
+        return true;
+    }
+
+    /*!
+    \brief Load the last value stored in the container.
+
+    - Progress: Wait-free
+    - Time complexity: The time to copy the value.
+    */
+    T load()
+    {
+        uint64_t latest = d_latest.fetch_add(1, std::memory_order_acq_rel);
+
+        Copy & copy = d_copies[latest >> Index_Shift];
+
+        T value = copy.value;
+
+        copy.released.fetch_add(1, std::memory_order_release);
+
+        return value;
+    }
+
+private:
+    static constexpr int Index_Shift = 56;
+    static constexpr uint64_t Count_Mask = (uint64_t(1) << Index_Shift) - 1;
+
+    struct alignas(64) Copy
+    {
+        T value {};
+        // Number of times readers stopped using this copy.
+        atomic<uint64_t> released { 0 };
+        // Number of times readers claimed this copy,
+        // while it is not the latest. Only used by the writer.
+        uint64_t claimed = 0;
+    };
+
+    array<Copy,Copy_Count> d_copies;
+
+    // Index of the latest copy, and the number of times readers claimed it.
+    alignas(64) atomic<uint64_t> d_latest { 0 };
+
+    // Index of the latest copy. Only used by the writer.
+    int d_latest_index = 0;
+};
+
+}
@@ -1,12 +1,46 @@
 #pragma once
 
+#include "slot_set.h"
 #include "lockfree_set.h"
+#include "array_set.h"
 
+#include <algorithm>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
 
 namespace Stitch {
 
 using std::shared_ptr;
+using std::vector;
+
+/*!
+ * \brief Selects the set type used to store connections of \ref Client "Clients" and \ref Server "Servers" sharing objects of type T.
+ *
+ * By default, connections are stored in a \ref Slot_Set, which makes connecting
+ * and disconnecting constant-time, and free of memory allocation
+ * after reserving connections using \ref Client::reserve and \ref Server::reserve.
+ * Iterating connections is lock-free, and an iteration never observes
+ * only some of the changes made by a \ref Topology_Transaction.
+ * For connections which change rarely, but are iterated often (for example by
+ * \ref Stream_Producer::push), the \ref Array_Set can be selected by
+ * specializing this template:
+ *
+ *     template <>
+ *     struct Stitch::Connection_Traits<My_Object>
+ *     {
+ *         template <typename E> using Set = Stitch::Array_Set<E>;
+ *     };
+ *
+ * The specialization must be visible wherever Clients or Servers of type T are used.
+ */
+template <typename T>
+struct Connection_Traits
+{
+    template <typename E> using Set = Stitch::Slot_Set<E>;
+};
 
 namespace Detail {
 
@@ -21,36 +55,230 @@ struct Link
 {
     shared_ptr<PortData<T>> peer;
     shared_ptr<T> data;
-};
-
-template <typename T>
-using LinkPtr = shared_ptr<Link<T>>;
+    // The peer's link to this port, when links are stored in a Slot_Set.
+    Slot_Handle mate;
 
+    bool operator==(const Link & other) const
+    {
+        return peer == other.peer && data == other.data;
+    }
+};
 
 template <typename T>
 struct PortData
 {
-    LinkPtr<T> find_link(PortPtr<T> peer)
+    using Link_Set = typename Connection_Traits<T>::template Set<Link<T>>;
+
+    // Whether links can be removed in constant time using handles.
+    static constexpr bool Has_Handles = requires (Link_Set & set, Slot_Handle handle) { set.remove(handle); };
+
+    // Whether shared objects are notified about clients connecting and disconnecting.
+    // See Client.
+    static constexpr bool Notifies = requires (T & data, const void * client)
     {
-        for (const auto & link : links)
+        data.client_connected(client);
+        data.client_disconnected(client);
+    };
+
+    // Notifies the object shared by a new link of this port.
+    void connected(const shared_ptr<T> & data)
+    {
+        if constexpr (Notifies)
+        {
+            if (data)
+                data->client_connected(this);
+        }
+    }
+
+    // Notifies the object shared by a removed link of this port.
+    void disconnected(const shared_ptr<T> & data)
+    {
+        if constexpr (Notifies)
+        {
+            if (data)
+                data->client_disconnected(this);
+        }
+    }
+
+    // Returns whether this port has a link to the peer.
+    bool has_link(const PortData * peer)
+    {
+        for (auto & link : links)
         {
-            if (link->peer == peer)
-                return link;
+            if (link.peer.get() == peer)
+                return true;
         }
 
-        return nullptr;
+        return false;
+    }
+
+    // Removes a link to the peer and the peer's link to this port.
+    void unlink(const PortData * peer)
+    {
+        if constexpr (Has_Handles)
+        {
+            for (auto it = links.begin(); it != links.end(); ++it)
+            {
+                if ((*it).peer.get() != peer)
+                    continue;
+
+                (*it).peer->remove_link((*it).mate);
+                remove_link(it.handle());
+                return;
+            }
+        }
+        else
+        {
+            for (auto & link : links)
+            {
+                if (link.peer.get() != peer)
+                    continue;
+
+                // The link is protected by the iterator, so it is not copied.
+                link.peer->remove_link_to(this);
+                if (links.remove(link))
+                    disconnected(link.data);
+                return;
+            }
+        }
+    }
+
+    // Removes the links of all peers to this port.
+    // Links of this port are destroyed with it, but are removed first
+    // if the shared objects are notified, so that a link also removed
+    // by a peer concurrently is only reported once.
+    void unlink_peers()
+    {
+        for (auto & link : links)
+        {
+            if constexpr (Has_Handles)
+                link.peer->remove_link(link.mate);
+            else
+                link.peer->remove_link_to(this);
+        }
+
+        if constexpr (Notifies)
+        {
+            if constexpr (Has_Handles)
+            {
+                for (auto it = links.begin(); it != links.end(); ++it)
+                    remove_link(it.handle());
+            }
+            else
+            {
+                for (auto & link : links)
+                {
+                    if (links.remove(link))
+                        disconnected(link.data);
+                }
+            }
+        }
+    }
+
+    // With handles: Removes a link, unless it was already removed.
+    void remove_link(const Slot_Handle & handle)
+    {
+        if constexpr (Notifies)
+        {
+            typename Link_Set::Update update(links);
+
+            if (!update.remove(handle))
+                return;
+
+            // The shared object is notified after the link is no longer visible.
+            shared_ptr<T> data = links.get(handle).data;
+            update.publish();
+            disconnected(data);
+        }
+        else
+        {
+            links.remove(handle);
+        }
+    }
+
+    // Without handles: Removes a link to the peer.
+    void remove_link_to(const PortData * peer)
+    {
+        for (auto & link : links)
+        {
+            if (link.peer.get() == peer)
+            {
+                if (links.remove(link))
+                    disconnected(link.data);
+                return;
+            }
+        }
+    }
+
+    void reserve(int count)
+    {
+        if constexpr (requires { links.reserve(count); })
+            links.reserve(count);
+    }
+
+    Link_Set links;
+};
+
+// Links ports 'a' and 'b' to each other.
+// Each port's link provides the given data.
+template <typename T>
+void link(const shared_ptr<PortData<T>> & a, const shared_ptr<T> & a_data,
+          const shared_ptr<PortData<T>> & b, const shared_ptr<T> & b_data)
+{
+    if constexpr (PortData<T>::Has_Handles)
+    {
+        using Update = typename PortData<T>::Link_Set::Update;
+
+        // Both links refer to each other before either is published,
+        // so unlinking either port always finds the peer's link.
+        Update a_update(a->links);
+        Update b_update(b->links);
+
+        Slot_Handle a_link = a_update.insert(Link<T> { b, a_data, {} });
+        Slot_Handle b_link = b_update.insert(Link<T> { a, b_data, a_link });
+        a->links.get(a_link).mate = b_link;
+
+        a->connected(a_data);
+        b->connected(b_data);
+
+        a_update.publish();
+        b_update.publish();
     }
+    else
+    {
+        a->connected(a_data);
+        b->connected(b_data);
+
+        a->links.insert(Link<T> { b, a_data, {} });
+        b->links.insert(Link<T> { a, b_data, {} });
+    }
+}
 
-    Set<LinkPtr<T>> links;
+// The type of a link set's updates, if it has any.
+template <typename S>
+struct Link_Set_Update
+{
+    struct Type {};
+};
+
+template <typename S> requires requires { typename S::Update; }
+struct Link_Set_Update<S>
+{
+    using Type = typename S::Update;
 };
 
 template <typename T>
-using LinkIterator = typename Set<LinkPtr<T>>::Iterator;
+using LinkIterator = typename PortData<T>::Link_Set::Iterator;
+
+// The type returned by end() of the link set, which may differ from LinkIterator.
+template <typename T>
+using LinkSentinel = decltype(std::declval<typename PortData<T>::Link_Set&>().end());
 
 }
 
 template <typename T> class Client;
 template <typename T> class Server;
+template <typename T> class Topology_Transaction;
 
 template <typename T>
 void connect(Client<T> & client, Server<T> & server);
@@ -86,6 +314,14 @@ bool are_connected(Client<T> &, Server<T> &);
  * a range-based for loop, with this Client as the range. For example:
  *
  *     for(auto & object : client) { process(object); }
+ *
+ * If T has methods `client_connected(const void * client)` and
+ * `client_disconnected(const void * client)`, they are called on the shared
+ * object whenever a Client gains or loses access to it, whether by \ref connect,
+ * \ref disconnect, a \ref Topology_Transaction, or destruction of a Client or Server.
+ * The argument identifies the Client, and equals \ref id.
+ * `client_connected` is called before the connection is visible to iterations,
+ * and `client_disconnected` after it is no longer visible.
  */
 
 template <typename T>
@@ -98,13 +334,19 @@ public:
     friend void disconnect<T>(Client<T> &, Server<T> &);
     friend bool are_connected<T>(Client<T> &, Server<T> &);
     friend bool are_connected<T>(Client<T> &, Client<T> &);
+    friend class Topology_Transaction<T>;
+
+    struct Sentinel
+    {
+        Detail::LinkSentinel<T> link;
+    };
 
     class Iterator
     {
         Detail::LinkIterator<T> link;
 
     public:
-        Iterator(const Detail::LinkIterator<T> & link): link(link) {}
+        Iterator(Detail::LinkIterator<T> && link): link(std::move(link)) {}
 
         Iterator & operator++()
         {
@@ -114,10 +356,10 @@ public:
 
         T & operator*()
         {
-            return *((*link)->data);
+            return *((*link).data);
         }
 
-        bool operator!=(Iterator & other) const
+        bool operator!=(const Sentinel & other) const
         {
             return link != other.link;
         }
@@ -129,19 +371,15 @@ public:
      * \brief Destroys all Client's connections.
      *
      * The objects shared with other Clients are destroyed.
+     *
+     * With the default \ref Connection_Traits:
+     * - Progress: Lock-free
+     * - Time complexity: O(number of connections)
      */
 
     ~Client()
     {
-        for(const auto & link : p->links)
-        {
-            auto peer = link->peer;
-            auto peer_link = peer->find_link(p);
-            if (peer_link)
-            {
-                peer->links.remove(peer_link);
-            }
-        };
+        p->unlink_peers();
     }
 
     Client(const Client &) = delete;
@@ -156,11 +394,25 @@ public:
     }
 
     /*!
-     * \brief Returns an iterator representing the end of the sequence of shared objects.
+     * \brief Returns a sentinel representing the end of the sequence of shared objects.
+     */
+    Sentinel end()
+    {
+        return Sentinel { p->links.end() };
+    }
+
+    /*!
+     * \brief Preallocates records for `count` connections.
+     *
+     * Connecting and disconnecting up to `count` peers then does not allocate memory,
+     * provided that the peers also reserved enough connections.
+     * Has no effect if another set type was selected using \ref Connection_Traits.
+     *
+     * Progress: Blocking.
      */
-    Iterator end()
+    void reserve(int count)
     {
-        return Iterator(p->links.end());
+        p->reserve(count);
     }
 
     bool has_connections() const
@@ -168,6 +420,16 @@ public:
         return !p->links.empty();
     }
 
+    /*!
+     * \brief Returns the identity of this Client passed to the shared objects it connects to.
+     *
+     * Progress: Wait-free.
+     */
+    const void * id() const
+    {
+        return p.get();
+    }
+
 private:
     shared_ptr<Detail::PortData<T>> p;
 };
@@ -200,6 +462,7 @@ public:
     friend void connect<T>(Client<T> & client, Server<T> & server);
     friend void disconnect<T>(Client<T> & client, Server<T> & server);
     friend bool are_connected<T>(Client<T> &, Server<T> &);
+    friend class Topology_Transaction<T>;
 
     /*!
      * \brief Constructs Server with an externally allocated shared object.
@@ -220,17 +483,12 @@ public:
 
     /*! \brief Destroyes all connections to the Server and its shared object.
      *
-     * Progress: Blocking.
+     * Progress: Blocking. With the default \ref Connection_Traits,
+     * destroying the connections takes O(number of connections) time.
      */
     ~Server()
     {
-        for(const auto & link : p->links)
-        {
-            auto peer = link->peer;
-            auto link2 = peer->find_link(p);
-            if (link2)
-                peer->links.remove(link2);
-        };
+        p->unlink_peers();
     }
 
     Server(const Server &) = delete;
@@ -261,6 +519,18 @@ public:
         return *d;
     }
 
+    /*!
+     * \brief Preallocates records for `count` connections.
+     *
+     * See \ref Client::reserve.
+     *
+     * Progress: Blocking.
+     */
+    void reserve(int count)
+    {
+        p->reserve(count);
+    }
+
     bool has_connections() const
     {
         return !p->links.empty();
@@ -273,43 +543,36 @@ private:
 
 /*!
  * \brief Connects a Client to a Server.
+ *
+ * With the default \ref Connection_Traits:
+ * - Progress: Lock-free if connections are reserved (see \ref Client::reserve). Blocking otherwise.
+ * - Time complexity: O(1)
  */
 template <typename T>
 void connect(Client<T> & client, Server<T> & server)
 {
-    {
-        auto link = std::make_shared<Detail::Link<T>>();
-        link->peer = server.p;
-        link->data = server.d;
-        client.p->links.insert(link);
-    }
-    {
-        auto link = std::make_shared<Detail::Link<T>>();
-        link->peer = client.p;
-        server.p->links.insert(link);
-    }
+    Detail::link<T>(client.p, server.d, server.p, nullptr);
 }
 
 /*!
  * \brief Disconnects a Client from a Server.
+ *
+ * With the default \ref Connection_Traits:
+ * - Progress: Lock-free
+ * - Time complexity: O(number of client's connections)
  */
 template <typename T>
 void disconnect(Client<T> & client, Server<T> & server)
 {
-    {
-        auto link = client.p->find_link(server.p);
-        if (link)
-            client.p->links.remove(link);
-    }
-    {
-        auto link = server.p->find_link(client.p);
-        if (link)
-            server.p->links.remove(link);
-    }
+    client.p->unlink(server.p.get());
 }
 
 /*!
  * \brief Connects two Clients with the given shared object.
+ *
+ * With the default \ref Connection_Traits:
+ * - Progress: Lock-free if connections are reserved (see \ref Client::reserve). Blocking otherwise.
+ * - Time complexity: O(1)
  */
 template <typename T>
 void connect(Client<T> & client1, Client<T> & client2, const shared_ptr<T> & data)
@@ -317,18 +580,7 @@ void connect(Client<T> & client1, Client<T> & client2, const shared_ptr<T> & dat
     if (&client1 == &client2)
         return;
 
-    {
-        auto link = std::make_shared<Detail::Link<T>>();
-        link->peer = client2.p;
-        link->data = data;
-        client1.p->links.insert(link);
-    }
-    {
-        auto link = std::make_shared<Detail::Link<T>>();
-        link->peer = client1.p;
-        link->data = data;
-        client2.p->links.insert(link);
-    }
+    Detail::link<T>(client1.p, data, client2.p, data);
 }
 
 /*!
@@ -347,20 +599,15 @@ void connect(Client<T> & client1, Client<T> & client2)
  * \brief Disconnects two Clients.
  *
  * The object shared between the clients is destroyed, unless it has another reference.
+ *
+ * With the default \ref Connection_Traits:
+ * - Progress: Lock-free
+ * - Time complexity: O(number of client1's connections)
  */
 template <typename T>
 void disconnect(Client<T> & client1, Client<T> & client2)
 {
-    {
-        auto link = client1.p->find_link(client2.p);
-        if (link)
-            client2.p->links.remove(link);
-    }
-    {
-        auto link = client2.p->find_link(client1.p);
-        if (link)
-            client2.p->links.remove(link);
-    }
+    client1.p->unlink(client2.p.get());
 }
 
 /*!
@@ -369,7 +616,7 @@ void disconnect(Client<T> & client1, Client<T> & client2)
 template <typename T>
 bool are_connected(Client<T> & c1, Client<T> & c2)
 {
-    return c1.p->find_link(c2.p) != nullptr;
+    return c1.p->has_link(c2.p.get());
 }
 
 /*!
@@ -378,7 +625,327 @@ bool are_connected(Client<T> & c1, Client<T> & c2)
 template <typename T>
 bool are_connected(Client<T> & c, Server<T> & s)
 {
-    return c.p->find_link(s.p) != nullptr;
+    return c.p->has_link(s.p.get());
 }
 
+/*!
+ * \brief Collects connections and disconnections to be applied together.
+ *
+ * Reconfiguring many connections using \ref connect and \ref disconnect
+ * publishes each change separately, so that iterating Clients may observe
+ * a partially reconfigured topology.
+ * Instead, a transaction collects changes and applies them in \ref commit,
+ * so that all the changes to the connections of a Client or Server
+ * are published at once, and an iteration over its connections
+ * observes either all or none of them.
+ * Changes to different Clients and Servers are still published one after another.
+ *
+ * Example:
+ *
+ *     Topology_Transaction<Data> transaction;
+ *     transaction.disconnect(client, old_server);
+ *     transaction.connect(client, new_server);
+ *     transaction.commit();
+ *
+ * Disconnections are applied to the connections existing at the time of \ref commit,
+ * except that disconnecting a pair connected earlier in the same transaction
+ * cancels the connection.
+ *
+ * If another set type was selected using \ref Connection_Traits,
+ * the changes are applied one by one.
+ *
+ * The Clients and Servers must not be destroyed before the transaction is committed.
+ *
+ * A transaction can only be used safely from one thread.
+ */
+template <typename T>
+class Topology_Transaction
+{
+public:
+    /*!
+     * \brief Adds connection of a Client to a Server.
+     */
+    void connect(Client<T> & client, Server<T> & server)
+    {
+        add({ client.p, server.d, server.p, nullptr, true });
+    }
+
+    /*!
+     * \brief Adds connection of two Clients with the given shared object.
+     */
+    void connect(Client<T> & client1, Client<T> & client2, const shared_ptr<T> & data)
+    {
+        if (&client1 == &client2)
+            return;
+
+        add({ client1.p, data, client2.p, data, true });
+    }
+
+    /*!
+     * \brief Adds connection of two Clients with a default-constructed shared object.
+     */
+    void connect(Client<T> & client1, Client<T> & client2)
+    {
+        if (&client1 == &client2)
+            return;
+
+        connect(client1, client2, std::make_shared<T>());
+    }
+
+    /*!
+     * \brief Adds disconnection of a Client from a Server.
+     */
+    void disconnect(Client<T> & client, Server<T> & server)
+    {
+        remove(client.p, server.p);
+    }
+
+    /*!
+     * \brief Adds disconnection of two Clients.
+     */
+    void disconnect(Client<T> & client1, Client<T> & client2)
+    {
+        remove(client1.p, client2.p);
+    }
+
+    /*!
+     * \brief Returns whether the transaction contains no changes.
+     */
+    bool empty() const
+    {
+        return d_changes.empty();
+    }
+
+    /*!
+     * \brief Discards all changes.
+     */
+    void clear()
+    {
+        d_changes.clear();
+    }
+
+    /*!
+     * \brief Preallocates storage for `count` changes.
+     *
+     * Adding up to `count` changes and committing them then does not allocate memory,
+     * provided that the affected Clients and Servers also reserved enough connections
+     * (see \ref Client::reserve). Connecting two Clients without a given shared object
+     * still allocates the object.
+     *
+     * Progress: Blocking.
+     */
+    void reserve(int count)
+    {
+        d_changes.reserve(count);
+
+        if constexpr (Detail::PortData<T>::Has_Handles)
+            reserve_scratch(count);
+    }
+
+    /*!
+     * \brief Applies all changes, publishing them once per affected Client and Server.
+     *
+     * The transaction is empty afterwards.
+     *
+     * With the default \ref Connection_Traits:
+     * - Progress: Lock-free if the transaction and the connections are reserved
+     *   (see \ref reserve and \ref Client::reserve). Blocking otherwise.
+     * - Time complexity: O(N * (N + L)), where N is the number of changes
+     *   and L is the number of connections of a disconnected Client.
+     */
+    void commit()
+    {
+        if constexpr (Detail::PortData<T>::Has_Handles)
+            apply_per_port();
+        else
+            apply_one_by_one();
+
+        d_changes.clear();
+    }
+
+private:
+    using Port = Detail::PortData<T>;
+    using Link = Detail::Link<T>;
+
+    struct Change
+    {
+        Detail::PortPtr<T> a;
+        shared_ptr<T> a_data;
+        Detail::PortPtr<T> b;
+        shared_ptr<T> b_data;
+        bool connect;
+    };
+
+    // A change of one port's links
+    struct Operation
+    {
+        Port * port;
+        // The link to remove
+        Slot_Handle handle;
+        // The link to insert, or the removed link's shared object to notify
+        Link link;
+        // Where to store the handle of the inserted link, or null for a removal
+        Slot_Handle * inserted;
+        // Whether the link to remove was still present
+        bool removed;
+    };
+
+    using Update = typename Detail::Link_Set_Update<typename Port::Link_Set>::Type;
+
+    void add(Change && change)
+    {
+        d_changes.push_back(std::move(change));
+    }
+
+    void remove(const Detail::PortPtr<T> & a, const Detail::PortPtr<T> & b)
+    {
+        // Cancel the last connection of the same pair in this transaction, if any.
+        for (auto it = d_changes.rbegin(); it != d_changes.rend(); ++it)
+        {
+            if (it->connect && ((it->a == a && it->b == b) || (it->a == b && it->b == a)))
+            {
+                d_changes.erase(std::next(it).base());
+                return;
+            }
+        }
+
+        d_changes.push_back({ a, nullptr, b, nullptr, false });
+    }
+
+    void apply_one_by_one()
+    {
+        for (auto & change : d_changes)
+        {
+            if (change.connect)
+                Detail::link<T>(change.a, change.a_data, change.b, change.b_data);
+            else
+                change.a->unlink(change.b.get());
+        }
+    }
+
+    // Ensures that committing 'count' changes does not allocate memory.
+    void reserve_scratch(size_t count)
+    {
+        d_operations.reserve(count * 2);
+        d_new_links.reserve(count);
+
+        // Each change affects at most two ports.
+        if (d_update_count < count * 2)
+        {
+            d_updates = std::make_unique<std::optional<Update>[]>(count * 2);
+            d_update_count = count * 2;
+        }
+    }
+
+    void apply_per_port()
+    {
+        reserve_scratch(d_changes.size());
+
+        // Find links to remove, each only once.
+        for (auto & change : d_changes)
+        {
+            if (change.connect)
+                continue;
+
+            for (auto it = change.a->links.begin(); it != change.a->links.end(); ++it)
+            {
+                Slot_Handle handle = it.handle();
+
+                if ((*it).peer != change.b || scheduled(change.a.get(), handle))
+                    continue;
+
+                d_operations.push_back({ change.a.get(), handle, {}, nullptr, false });
+                d_operations.push_back({ change.b.get(), (*it).mate, {}, nullptr, false });
+                break;
+            }
+        }
+
+        // Handles of new links of ports 'a' and 'b' of each connection
+        d_new_links.assign(d_changes.size(), {});
+
+        for (size_t i = 0; i < d_changes.size(); ++i)
+        {
+            auto & change = d_changes[i];
+            if (!change.connect)
+                continue;
+
+            d_operations.push_back({ change.a.get(), {}, Link { change.b, change.a_data, {} }, &d_new_links[i].first, false });
+            d_operations.push_back({ change.b.get(), {}, Link { change.a, change.b_data, {} }, &d_new_links[i].second, false });
+        }
+
+        // Group operations by port, to make each port's changes in one update.
+        std::sort(d_operations.begin(), d_operations.end(), [](const Operation & x, const Operation & y)
+        {
+            return std::less<Port*>()(x.port, y.port);
+        });
+
+        size_t port_count = 0;
+
+        for (size_t i = 0; i < d_operations.size(); ++i)
+        {
+            auto & op = d_operations[i];
+
+            if (i == 0 || op.port != d_operations[i - 1].port)
+                d_updates[port_count++].emplace(op.port->links);
+
+            auto & update = *d_updates[port_count - 1];
+
+            if (op.inserted)
+            {
+                op.port->connected(op.link.data);
+                *op.inserted = update.insert(std::move(op.link));
+            }
+            else if (update.remove(op.handle))
+            {
+                op.removed = true;
+                if constexpr (Port::Notifies)
+                    op.link.data = op.port->links.get(op.handle).data;
+            }
+        }
+
+        // Let each new link refer to the peer's link before any is published,
+        // so unlinking either port always finds the peer's link.
+        for (size_t i = 0; i < d_changes.size(); ++i)
+        {
+            auto & change = d_changes[i];
+            if (!change.connect)
+                continue;
+
+            change.a->links.get(d_new_links[i].first).mate = d_new_links[i].second;
+            change.b->links.get(d_new_links[i].second).mate = d_new_links[i].first;
+        }
+
+        for (size_t i = 0; i < port_count; ++i)
+            d_updates[i].reset();
+
+        for (auto & op : d_operations)
+        {
+            if (op.removed)
+                op.port->disconnected(op.link.data);
+        }
+
+        d_operations.clear();
+    }
+
+    // Returns whether removal of the port's link is already scheduled.
+    bool scheduled(const Port * port, const Slot_Handle & handle) const
+    {
+        for (auto & op : d_operations)
+        {
+            if (op.port == port && op.handle.slot == handle.slot && op.handle.generation == handle.generation)
+                return true;
+        }
+
+        return false;
+    }
+
+    vector<Change> d_changes;
+
+    // Storage used by commit, kept to avoid allocation
+    vector<Operation> d_operations;
+    vector<std::pair<Slot_Handle, Slot_Handle>> d_new_links;
+    std::unique_ptr<std::optional<Update>[]> d_updates;
+    size_t d_update_count = 0;
+};
+
 }
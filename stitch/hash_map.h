@@ -0,0 +1,672 @@
+#pragma once
+
+#include "hazard_pointers.h"
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+namespace Stitch {
+
+using std::atomic;
+
+/*! \brief Lock-free unordered map.
+ *
+ * Key type K must support equality comparison (operator '==') and hashing by `Hash`.
+ *
+ * Values are immutable once inserted: \ref find returns a copy of the value.
+ * To change the value of a key, \ref erase it and \ref insert it again,
+ * or use a value type which is itself thread-safe (for example a shared_ptr to an atomic).
+ *
+ * The map grows automatically, without moving its elements.
+ *
+ * Progress guarantees in method descriptions use the following parameters:
+ * - N = Number of elements currently in the map.
+ * - B = Number of elements in a bucket (expected to be constant).
+ * - K = Number of hazard pointers in use.
+ * - H = Maximum allowable number of hazard pointers.
+ */
+
+// This is a split-ordered list as described by O.Shalev and N.Shavit (2006):
+// All elements are in a single lock-free ordered list (see lockfree_set.h),
+// sorted by the bit-reversed hash of their key (the "split-order key").
+// Each bucket points to a dummy node in the list, so that the elements
+// of the bucket follow it.
+// When the number of buckets doubles, each bucket splits into two: the elements
+// of the new bucket are already consecutive in the list, following the elements
+// of the old bucket, so only a new dummy node needs to be inserted between them.
+// Buckets are initialized lazily on first access.
+//
+// Dummy nodes are never removed until the map is destroyed.
+// Data nodes are removed like in lockfree_set.h and reclaimed using hazard pointers.
+//
+// Data nodes with equal split-order keys are in order of insertion: a new node
+// is linked after all of them. Each data node records its insertion order,
+// so that iterators can find their position among such nodes after restarting.
+
+template <typename K, typename V, typename Hash = std::hash<K>>
+class Hash_Map
+{
+public:
+    using Entry = std::pair<const K, V>;
+
+private:
+    struct Node
+    {
+        Node(uint64_t so_key): so_key(so_key) {}
+
+        // Least significant bit marks this node as removed.
+        atomic<Node*> next { nullptr };
+        // Least significant bit is 1 for data nodes and 0 for dummy nodes.
+        const uint64_t so_key;
+    };
+
+    struct Data_Node : Node
+    {
+        Data_Node(uint64_t so_key, const K & key, const V & value):
+            Node(so_key), entry(key, value) {}
+
+        // Increases with position among nodes with equal so_key.
+        uint64_t order = 0;
+        Entry entry;
+    };
+
+    using Hazard_Pointer = Detail::Hazard_Pointer<Node>;
+
+    static constexpr int Segment_Bits = 10;
+    static constexpr uint64_t Segment_Size = uint64_t(1) << Segment_Bits;
+    static constexpr int Max_Segments = 4096;
+    static constexpr uint64_t Max_Bucket_Count = Segment_Size * Max_Segments;
+    // Average number of elements per bucket above which the number of buckets doubles.
+    static constexpr int Load_Factor = 2;
+
+    struct Segment
+    {
+        atomic<Node*> buckets[Segment_Size] = {};
+    };
+
+    // Hazard pointers used by modifying methods
+    struct Guard
+    {
+        Guard(): prev(&Detail::Hazard_Pointers::acquire<Node>())
+        {
+            try { cur = &Detail::Hazard_Pointers::acquire<Node>(); }
+            catch (...) { prev->release(); throw; }
+        }
+
+        ~Guard()
+        {
+            prev->pointer = cur->pointer = nullptr;
+            prev->release();
+            cur->release();
+        }
+
+        Hazard_Pointer * prev;
+        Hazard_Pointer * cur;
+    };
+
+    static bool is_marked(Node * n) { return uintptr_t(n) & 1; }
+    static Node * marked(Node * n) { return (Node*)(uintptr_t(n) | 1); }
+    static Node * unmarked(Node * n) { return (Node*)(uintptr_t(n) & ~uintptr_t(1)); }
+
+    static bool is_dummy(const Node * n) { return (n->so_key & 1) == 0; }
+
+    static uint64_t reverse_bits(uint64_t x)
+    {
+        x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+        x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+        x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+        return __builtin_bswap64(x);
+    }
+
+    static uint64_t data_key(uint64_t hash)
+    {
+        return reverse_bits(hash | (uint64_t(1) << 63));
+    }
+
+    static uint64_t dummy_key(uint64_t bucket)
+    {
+        return reverse_bits(bucket);
+    }
+
+public:
+
+    /*!
+     * \brief Constructs an empty map.
+     *
+     * - Progress: Blocking
+     * - Time complexity: O(1)
+     */
+
+    Hash_Map()
+    {
+        store_bucket(0, &d_head);
+    }
+
+    /*!
+     * \brief Destroys the map and all its elements.
+     *
+     * - Progress: Blocking
+     * - Time complexity: O(N)
+     */
+
+    ~Hash_Map()
+    {
+        Node * n = unmarked(d_head.next.load());
+        while(n)
+        {
+            Node * next = unmarked(n->next.load());
+            if (is_dummy(n))
+                delete n;
+            else
+                delete static_cast<Data_Node*>(n);
+            n = next;
+        }
+
+        for (auto & segment : d_segments)
+            delete segment.load();
+    }
+
+    Hash_Map(const Hash_Map &) = delete;
+    Hash_Map & operator=(const Hash_Map &) = delete;
+
+    /*!
+     * \brief Returns the number of elements.
+     *
+     * Elements inserted or erased concurrently may or may not be counted.
+     *
+     * - Progress: Wait-free
+     * - Time complexity: O(1)
+     */
+
+    int size() const
+    {
+        return (int) d_size.load();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /*!
+     * \brief Inserts the key with the given value, if the key is not already in the map.
+     *
+     * Returns whether the key was inserted.
+     *
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: Expected O(B). Worst-case O(N + H).
+     */
+
+    bool insert(const K & key, const V & value)
+    {
+        uint64_t hash = d_hash(key);
+        uint64_t so_key = data_key(hash);
+        Node * start = bucket_for(hash);
+
+        Guard guard;
+        Node * prev, * cur;
+        Data_Node * node = nullptr;
+
+        for(;;)
+        {
+            if (find(start, so_key, key, prev, cur, guard))
+            {
+                delete node;
+                return false;
+            }
+
+            if (!node)
+                node = new Data_Node(so_key, key, value);
+
+            node->next = cur;
+
+            // Taken after 'find', so it is greater than the order of any node
+            // with equal so_key that can precede this one.
+            node->order = d_insertion_count.fetch_add(1);
+
+            if (prev->next.compare_exchange_strong(cur, node))
+                break;
+        }
+
+        uint64_t size = d_size.fetch_add(1) + 1;
+        uint64_t bucket_count = d_bucket_count.load();
+        if (size > bucket_count * Load_Factor && bucket_count < Max_Bucket_Count)
+            d_bucket_count.compare_exchange_strong(bucket_count, bucket_count * 2);
+
+        return true;
+    }
+
+    /*!
+     * \brief Removes the key, if it is in the map.
+     *
+     * Returns whether the key was in the map.
+     *
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: Expected O(B). Worst-case O(N + H).
+     */
+
+    bool erase(const K & key)
+    {
+        uint64_t hash = d_hash(key);
+        uint64_t so_key = data_key(hash);
+        Node * start = bucket_for(hash);
+
+        Guard guard;
+        Node * prev, * cur;
+
+        for(;;)
+        {
+            if (!find(start, so_key, key, prev, cur, guard))
+                return false;
+
+            if (mark(cur))
+                break;
+        }
+
+        Node * expected = cur;
+        if (prev->next.compare_exchange_strong(expected, unmarked(cur->next.load())))
+            Detail::Hazard_Pointers::reclaim(static_cast<Data_Node*>(cur));
+        else
+            find(start, so_key, key, prev, cur, guard); // Unlinks the node
+
+        d_size.fetch_sub(1);
+
+        return true;
+    }
+
+    /*!
+     * \brief Copies the value of the key into `value`, if the key is in the map.
+     *
+     * Returns whether the key is in the map.
+     *
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: Expected O(B). Worst-case O(N + H).
+     */
+
+    bool find(const K & key, V & value)
+    {
+        uint64_t hash = d_hash(key);
+        Node * start = bucket_for(hash);
+
+        Guard guard;
+        Node * prev, * cur;
+
+        if (!find(start, data_key(hash), key, prev, cur, guard))
+            return false;
+
+        value = static_cast<Data_Node*>(cur)->entry.second;
+        return true;
+    }
+
+    /*!
+     * \brief Returns whether the key is in the map.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: Expected O(B). Worst-case O(N + H).
+     */
+
+    bool contains(const K & key)
+    {
+        uint64_t hash = d_hash(key);
+        Node * start = bucket_for(hash);
+
+        Guard guard;
+        Node * prev, * cur;
+
+        return find(start, data_key(hash), key, prev, cur, guard);
+    }
+
+    /*!
+     * \brief Iterates over all elements.
+     *
+     * Like with \ref Set, the iterator may skip elements inserted or erased
+     * during iteration, but it never visits an element more than once.
+     *
+     * Dereferencing the iterator gives an \ref Entry, a pair of key and value.
+     */
+    struct Iterator
+    {
+        // End iterator
+        Iterator() {}
+
+        Iterator(Hash_Map * map): map(map)
+        {
+            acquire();
+            hp0->pointer = &map->d_head;
+            ++(*this);
+        }
+
+        Iterator(const Iterator & other)
+        {
+            *this = other;
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        Iterator & operator=(const Iterator & other)
+        {
+            if (this == &other)
+                return *this;
+
+            if (other.hp0 && !hp0)
+                acquire();
+
+            map = other.map;
+            last_key = other.last_key;
+            last_order = other.last_order;
+            restarted = other.restarted;
+
+            // The node is still protected by 'other'.
+            if (hp0)
+                hp0->pointer = other.hp0 ? other.hp0->pointer.load() : nullptr;
+
+            return *this;
+        }
+
+        ~Iterator()
+        {
+            if (hp0)
+            {
+                hp0->pointer = hp1->pointer = nullptr;
+                hp0->release();
+                hp1->release();
+            }
+        }
+
+        bool operator==(const Iterator & other) const
+        {
+            return node() == other.node();
+        }
+
+        bool operator!=(const Iterator & other) const
+        {
+            return !(*this == other);
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        Entry & operator*()
+        {
+            return static_cast<Data_Node*>(node())->entry;
+        }
+
+        Entry * operator->()
+        {
+            return &static_cast<Data_Node*>(node())->entry;
+        }
+
+        /*!
+         * - Progress: Lock-free.
+         * - Time complexity: O(N + K).
+         */
+        Iterator & operator++()
+        {
+            auto & h0 = hp0->pointer;
+            auto & h1 = hp1->pointer;
+
+            Node * current = h0.load();
+
+            for(;;)
+            {
+                Node * next = current->next;
+
+                if (is_marked(next))
+                {
+                    // Restart from head and skip visited elements.
+                    h0 = current = &map->d_head;
+                    restarted = true;
+                    continue;
+                }
+
+                h1 = next;
+
+                if (current->next != next)
+                    continue;
+
+                h0 = current = next;
+
+                if (!current)
+                    break;
+
+                if (is_dummy(current))
+                    continue;
+
+                if (restarted && visited(static_cast<Data_Node*>(current)))
+                    continue;
+
+                break;
+            }
+
+            if (current)
+            {
+                last_key = current->so_key;
+                last_order = static_cast<Data_Node*>(current)->order;
+                restarted = false;
+            }
+
+            return *this;
+        }
+
+    private:
+        void acquire()
+        {
+            hp0 = &Detail::Hazard_Pointers::acquire<Node>();
+            try { hp1 = &Detail::Hazard_Pointers::acquire<Node>(); }
+            catch (...) { hp0->release(); hp0 = nullptr; throw; }
+        }
+
+        Node * node() const
+        {
+            return hp0 ? hp0->pointer.load() : nullptr;
+        }
+
+        // Whether the node is the last visited node or precedes it.
+        bool visited(const Data_Node * node) const
+        {
+            return node->so_key < last_key || (node->so_key == last_key && node->order <= last_order);
+        }
+
+        Hash_Map * map = nullptr;
+        Hazard_Pointer * hp0 = nullptr;
+        Hazard_Pointer * hp1 = nullptr;
+        uint64_t last_key = 0;
+        uint64_t last_order = 0;
+        bool restarted = false;
+    };
+
+    /*!
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free.
+     * - Time complexity: O(N + K).
+     */
+    Iterator begin()
+    {
+        return Iterator(this);
+    }
+
+    /*!
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    Iterator end()
+    {
+        return Iterator();
+    }
+
+private:
+    // Finds a node with key 'so_key' in the list following 'start'.
+    // For data nodes, the node must also have key equal to 'key'.
+    // Returns whether found as 'cur'.
+    // Otherwise, 'cur' is the first node after the position of the key.
+    // 'prev' is the node linking to 'cur'.
+    // Both are protected by the guard's hazard pointers.
+    // Marked nodes encountered on the way are unlinked and reclaimed.
+    bool find(Node * start, uint64_t so_key, const K * key, Node *& prev, Node *& cur, Guard & guard)
+    {
+        restart:
+
+        prev = start;
+        cur = start->next;
+
+        for(;;)
+        {
+            if (!cur)
+                return false;
+
+            guard.cur->pointer = cur;
+
+            // Make sure cur was not removed before it was protected.
+            if (prev->next != cur)
+                goto restart;
+
+            Node * next = cur->next;
+
+            if (is_marked(next))
+            {
+                next = unmarked(next);
+
+                Node * expected = cur;
+                if (!prev->next.compare_exchange_strong(expected, next))
+                    goto restart;
+
+                Detail::Hazard_Pointers::reclaim(static_cast<Data_Node*>(cur));
+
+                cur = next;
+                continue;
+            }
+
+            if (cur->so_key > so_key)
+                return false;
+
+            if (cur->so_key == so_key && (!key || static_cast<Data_Node*>(cur)->entry.first == *key))
+                return true;
+
+            prev = cur;
+            std::swap(guard.prev, guard.cur);
+            cur = next;
+        }
+    }
+
+    bool find(Node * start, uint64_t so_key, const K & key, Node *& prev, Node *& cur, Guard & guard)
+    {
+        return find(start, so_key, &key, prev, cur, guard);
+    }
+
+    // Marks the node as removed. Returns false if it was already marked.
+    static bool mark(Node * n)
+    {
+        Node * next = n->next;
+
+        while (!is_marked(next))
+        {
+            if (n->next.compare_exchange_weak(next, marked(next)))
+                return true;
+        }
+
+        return false;
+    }
+
+    Node * bucket_for(uint64_t hash)
+    {
+        uint64_t bucket = hash & (d_bucket_count.load() - 1);
+
+        Node * dummy = load_bucket(bucket);
+        if (!dummy)
+            dummy = initialize_bucket(bucket);
+
+        return dummy;
+    }
+
+    Node * load_bucket(uint64_t bucket)
+    {
+        Segment * segment = d_segments[bucket >> Segment_Bits];
+        if (!segment)
+            return nullptr;
+        return segment->buckets[bucket & (Segment_Size - 1)];
+    }
+
+    void store_bucket(uint64_t bucket, Node * dummy)
+    {
+        auto & segment_ptr = d_segments[bucket >> Segment_Bits];
+
+        Segment * segment = segment_ptr;
+        if (!segment)
+        {
+            Segment * new_segment = new Segment;
+            if (segment_ptr.compare_exchange_strong(segment, new_segment))
+                segment = new_segment;
+            else
+                delete new_segment;
+        }
+
+        Node * expected = nullptr;
+        segment->buckets[bucket & (Segment_Size - 1)].compare_exchange_strong(expected, dummy);
+    }
+
+    // Inserts the dummy node of the bucket into the list
+    // after the dummy node of its parent bucket.
+    Node * initialize_bucket(uint64_t bucket)
+    {
+        uint64_t parent = bucket & ~std::bit_floor(bucket);
+
+        Node * start = load_bucket(parent);
+        if (!start)
+            start = initialize_bucket(parent);
+
+        uint64_t so_key = dummy_key(bucket);
+
+        Guard guard;
+        Node * prev, * cur;
+        Node * dummy = nullptr;
+
+        for(;;)
+        {
+            if (find(start, so_key, nullptr, prev, cur, guard))
+            {
+                // Inserted by another thread
+                delete dummy;
+                dummy = cur;
+                break;
+            }
+
+            if (!dummy)
+                dummy = new Node(so_key);
+
+            dummy->next = cur;
+
+            if (prev->next.compare_exchange_strong(cur, dummy))
+                break;
+        }
+
+        store_bucket(bucket, dummy);
+
+        return dummy;
+    }
+
+    Hash d_hash;
+
+    // Dummy node of bucket 0
+    Node d_head { 0 };
+
+    atomic<uint64_t> d_bucket_count { 2 };
+    atomic<uint64_t> d_size { 0 };
+    atomic<uint64_t> d_insertion_count { 0 };
+
+    atomic<Segment*> d_segments[Max_Segments] = {};
+};
+
+}
@@ -4,6 +4,9 @@ namespace Stitch {
 namespace Detail {
 
 thread_local Hazard_Pointers::Thread_Record Hazard_Pointers::d_thread_record;
+thread_local Hazard_Pointers::Thread_Cache Hazard_Pointers::d_thread_cache;
+std::mutex Hazard_Pointers::d_orphans_mutex;
+list<Hazard_Pointers::Owned_Ptr> Hazard_Pointers::d_orphans;
 atomic<int> Hazard_Pointers::d_pointer_alloc_hint;
 array<Hazard_Pointer<void>,Hazard_Pointers::H> Hazard_Pointers::d_pointers;
 
@@ -2,6 +2,7 @@
 
 #include <atomic>
 #include <list>
+#include <mutex>
 #include <vector>
 #include <array>
 #include <unordered_set>
@@ -16,14 +17,19 @@ using std::vector;
 using std::array;
 using std::unordered_set;
 
+class Hazard_Pointers;
+
 template <typename T>
 class Hazard_Pointer
 {
 public:
     atomic<T*> pointer;
     bool acquire() { return !used.test_and_set(); }
-    void release() { used.clear(); }
+    // Clears the pointer and makes the slot available to all threads.
+    // The slot is remembered by the thread's cache, to be tried first.
+    void release();
 private:
+    friend class Hazard_Pointers;
     std::atomic_flag used;
 };
 
@@ -33,9 +39,22 @@ public:
     // NOTE: H must be power of two
     static constexpr int H = 256;
 
+    // Number of slots released by each thread which are tried first
+    // when the thread acquires a slot, before probing the shared array.
+    // Cached slots are not reserved, so they may be taken by other threads.
+    static constexpr int Cache_Size = 4;
+
     template<typename T> static
     Hazard_Pointer<T> & acquire()
     {
+        Thread_Cache & cache = d_thread_cache;
+        while (cache.size > 0)
+        {
+            auto * slot = cache.slots[--cache.size];
+            if (slot->acquire())
+                return reinterpret_cast<Hazard_Pointer<T>&>(*slot);
+        }
+
         int i = d_pointer_alloc_hint.load();
         int j = i;
         int m = H-1;
@@ -58,6 +77,18 @@ public:
         throw std::runtime_error("Ran out of pointers.");
     }
 
+    template <typename T>
+    static void release(Hazard_Pointer<T> & hp)
+    {
+        auto & slot = reinterpret_cast<Hazard_Pointer<void>&>(hp);
+        slot.pointer = nullptr;
+        slot.used.clear();
+
+        Thread_Cache & cache = d_thread_cache;
+        if (cache.size < Cache_Size)
+            cache.slots[cache.size++] = &slot;
+    }
+
     template <typename T>
     static void reclaim(T * p)
     {
@@ -69,6 +100,19 @@ public:
         d_thread_record.cleanup();
     }
 
+    // Returns whether any hazard pointer points to 'p'.
+    // Used by structures which recycle objects instead of reclaiming them.
+    static bool is_protected(const void * p)
+    {
+        for (const auto & pointer : d_pointers)
+        {
+            if (pointer.pointer.load() == p)
+                return true;
+        }
+
+        return false;
+    }
+
 private:
 
     template <typename T>
@@ -94,6 +138,14 @@ private:
         ~Thread_Record()
         {
             cleanup();
+
+            // Objects still protected by other threads are left
+            // for other threads to delete.
+            if (!owned.empty())
+            {
+                std::lock_guard<std::mutex> lock(d_orphans_mutex);
+                d_orphans.splice(d_orphans.end(), owned);
+            }
         }
 
         // NOTE: This must be reentrant!
@@ -115,6 +167,13 @@ private:
 
             cleanup_in_progress = true;
 
+            // Adopt objects left by exited threads.
+            {
+                std::unique_lock<std::mutex> lock(d_orphans_mutex, std::try_to_lock);
+                if (lock.owns_lock())
+                    owned.splice(owned.end(), d_orphans);
+            }
+
             unordered_set<void*> hs;
 
             for (const auto & pointer : Hazard_Pointers::d_pointers)
@@ -146,11 +205,28 @@ private:
         bool cleanup_in_progress = false;
     };
 
+    // Slots last released by this thread.
+    struct Thread_Cache
+    {
+        array<Hazard_Pointer<void>*, Cache_Size> slots;
+        int size = 0;
+    };
+
     thread_local static Thread_Record d_thread_record;
+    thread_local static Thread_Cache d_thread_cache;
+
+    static std::mutex d_orphans_mutex;
+    static list<Owned_Ptr> d_orphans;
 
     static atomic<int> d_pointer_alloc_hint;
     static array<Hazard_Pointer<void>,H> d_pointers;
 };
 
+template <typename T>
+void Hazard_Pointer<T>::release()
+{
+    Hazard_Pointers::release(*this);
+}
+
 }
 }
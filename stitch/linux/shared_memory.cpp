@@ -0,0 +1,240 @@
+#include "shared_memory.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+using namespace std;
+
+namespace Stitch {
+
+Shared_Memory::~Shared_Memory()
+{
+    release();
+}
+
+void Shared_Memory::create(size_t size)
+{
+    release();
+
+    int fd = memfd_create("stitch", MFD_CLOEXEC);
+    if (fd == -1)
+        throw std::runtime_error(string("'memfd_create' failed: ") + strerror(errno));
+
+    if (ftruncate(fd, size) == -1)
+    {
+        close(fd);
+        throw std::runtime_error(string("'ftruncate' failed: ") + strerror(errno));
+    }
+
+    map(fd);
+}
+
+void Shared_Memory::map(int fd)
+{
+    release();
+
+    struct stat info;
+    if (fstat(fd, &info) == -1)
+    {
+        close(fd);
+        throw std::runtime_error(string("'fstat' failed: ") + strerror(errno));
+    }
+
+    size_t size = info.st_size;
+
+    void * data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        close(fd);
+        throw std::runtime_error(string("'mmap' failed: ") + strerror(errno));
+    }
+
+    d_fd = fd;
+    d_data = data;
+    d_size = size;
+}
+
+void Shared_Memory::release()
+{
+    if (d_data)
+        munmap(d_data, d_size);
+    if (d_fd != -1)
+        close(d_fd);
+
+    d_fd = -1;
+    d_data = nullptr;
+    d_size = 0;
+}
+
+static sockaddr_un make_address(const string & path)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("Socket path too long: " + path);
+
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    return address;
+}
+
+Unix_Socket_Listener::Unix_Socket_Listener(const string & path):
+    d_path(path)
+{
+    auto address = make_address(path);
+
+    d_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (d_fd == -1)
+        throw std::runtime_error(string("'socket' failed: ") + strerror(errno));
+
+    unlink(path.c_str());
+
+    if (bind(d_fd, (sockaddr*) &address, sizeof(address)) == -1)
+    {
+        close(d_fd);
+        throw std::runtime_error(string("'bind' failed: ") + strerror(errno));
+    }
+
+    if (listen(d_fd, 16) == -1)
+    {
+        close(d_fd);
+        unlink(path.c_str());
+        throw std::runtime_error(string("'listen' failed: ") + strerror(errno));
+    }
+}
+
+Unix_Socket_Listener::~Unix_Socket_Listener()
+{
+    close(d_fd);
+    unlink(d_path.c_str());
+}
+
+int Unix_Socket_Listener::accept()
+{
+    int result;
+
+    do { result = accept4(d_fd, nullptr, nullptr, SOCK_CLOEXEC); }
+    while (result == -1 && errno == EINTR);
+
+    return result;
+}
+
+Event Unix_Socket_Listener::event()
+{
+    Event e;
+    e.fd = d_fd;
+    e.epoll_events = EPOLLIN;
+    e.poll_events = POLLIN;
+    e.clear = [](){};
+    return e;
+}
+
+int connect_unix_socket(const string & path)
+{
+    auto address = make_address(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        throw std::runtime_error(string("'socket' failed: ") + strerror(errno));
+
+    int result;
+
+    do { result = connect(fd, (sockaddr*) &address, sizeof(address)); }
+    while (result == -1 && errno == EINTR);
+
+    if (result == -1)
+    {
+        close(fd);
+        throw std::runtime_error(string("'connect' failed: ") + strerror(errno));
+    }
+
+    return fd;
+}
+
+void send_file_descriptors(int socket, const void * data, int size, const int * fds, int count)
+{
+    iovec io;
+    io.iov_base = const_cast<void*>(data);
+    io.iov_len = size;
+
+    vector<char> control(CMSG_SPACE(sizeof(int) * count));
+
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data();
+    message.msg_controllen = control.size();
+
+    cmsghdr * header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+    memcpy(CMSG_DATA(header), fds, sizeof(int) * count);
+
+    int result;
+
+    do { result = sendmsg(socket, &message, MSG_NOSIGNAL); }
+    while (result == -1 && errno == EINTR);
+
+    if (result != size)
+        throw std::runtime_error(string("'sendmsg' failed: ") + strerror(errno));
+}
+
+int receive_file_descriptors(int socket, void * data, int size, int * fds, int max_count)
+{
+    iovec io;
+    io.iov_base = data;
+    io.iov_len = size;
+
+    vector<char> control(CMSG_SPACE(sizeof(int) * max_count));
+
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data();
+    message.msg_controllen = control.size();
+
+    int result;
+
+    do { result = recvmsg(socket, &message, MSG_CMSG_CLOEXEC | MSG_WAITALL); }
+    while (result == -1 && errno == EINTR);
+
+    if (result != size)
+        throw std::runtime_error(string("'recvmsg' failed: ") + strerror(errno));
+
+    int count = 0;
+
+    for (cmsghdr * header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header))
+    {
+        if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        int n = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const int * received = (const int*) CMSG_DATA(header);
+        for (int i = 0; i < n; ++i)
+        {
+            if (count < max_count)
+                fds[count++] = received[i];
+            else
+                close(received[i]);
+        }
+    }
+
+    return count;
+}
+
+}
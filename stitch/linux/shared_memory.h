@@ -0,0 +1,123 @@
+#pragma once
+
+#include "events.h"
+
+#include <cstddef>
+#include <string>
+
+namespace Stitch {
+
+using std::string;
+
+/*!
+  \brief A region of memory which can be shared with other processes.
+
+  The region is backed by an anonymous memory file (see `memfd_create`).
+  Another process gains access to the region when it receives the
+  file descriptor (for example using \ref send_file_descriptors)
+  and maps it using \ref map.
+
+  The region may be mapped at different addresses in different processes,
+  so data placed in it should not contain pointers.
+*/
+
+class Shared_Memory
+{
+public:
+    /*! \brief Constructs an object representing no memory. */
+    Shared_Memory() {}
+
+    /*! \brief Unmaps the memory and closes the file descriptor. */
+    ~Shared_Memory();
+
+    Shared_Memory(const Shared_Memory &) = delete;
+    Shared_Memory & operator=(const Shared_Memory &) = delete;
+
+    /*! \brief Creates and maps a new region of `size` bytes, initialized to zero.
+
+      Any previously held region is released.
+      Throws std::runtime_error on failure.
+    */
+    void create(size_t size);
+
+    /*! \brief Maps an existing region given its file descriptor.
+
+      Takes ownership of the file descriptor.
+      Any previously held region is released.
+      Throws std::runtime_error on failure.
+    */
+    void map(int fd);
+
+    /*! \brief Unmaps the memory and closes the file descriptor. */
+    void release();
+
+    void * data() { return d_data; }
+    size_t size() const { return d_size; }
+    int fd() const { return d_fd; }
+
+private:
+    int d_fd = -1;
+    void * d_data = nullptr;
+    size_t d_size = 0;
+};
+
+/*!
+  \brief A listening Unix domain socket.
+
+  Used to hand over file descriptors to other processes which
+  connect to the socket using \ref connect_unix_socket.
+
+  The socket file is removed when this object is destroyed.
+*/
+
+class Unix_Socket_Listener
+{
+public:
+    /*! \brief Creates a socket file at `path` and starts listening.
+
+      An existing file at `path` is removed first.
+      Throws std::runtime_error on failure.
+    */
+    Unix_Socket_Listener(const string & path);
+    ~Unix_Socket_Listener();
+
+    Unix_Socket_Listener(const Unix_Socket_Listener &) = delete;
+    Unix_Socket_Listener & operator=(const Unix_Socket_Listener &) = delete;
+
+    /*! \brief Accepts a pending connection without waiting.
+
+      Returns the file descriptor of the connection,
+      or -1 if there is no pending connection.
+    */
+    int accept();
+
+    /*! \brief Returns a conditional event active while there are pending connections. */
+    Event event();
+
+private:
+    string d_path;
+    int d_fd;
+};
+
+/*! \brief Connects to a \ref Unix_Socket_Listener at `path`.
+
+  Returns the file descriptor of the connection.
+  Throws std::runtime_error on failure.
+*/
+int connect_unix_socket(const string & path);
+
+/*! \brief Sends `size` bytes at `data` together with `count` file descriptors over a Unix domain socket.
+
+  Throws std::runtime_error on failure.
+*/
+void send_file_descriptors(int socket, const void * data, int size, const int * fds, int count);
+
+/*! \brief Receives `size` bytes into `data` together with up to `max_count` file descriptors.
+
+  Waits until data is received.
+  Returns the number of received file descriptors.
+  Throws std::runtime_error on failure.
+*/
+int receive_file_descriptors(int socket, void * data, int size, int * fds, int max_count);
+
+}
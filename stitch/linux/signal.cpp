@@ -61,6 +61,10 @@ Detail::SignalChannel::SignalChannel()
         throw std::runtime_error("'eventfd' failed.");
 }
 
+Detail::SignalChannel::SignalChannel(int fd):
+    fd(fd)
+{}
+
 Detail::SignalChannel::~SignalChannel()
 {
     close(fd);
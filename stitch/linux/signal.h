@@ -12,6 +12,8 @@ namespace Detail {
 struct SignalChannel
 {
     SignalChannel();
+    // Takes ownership of an existing eventfd.
+    explicit SignalChannel(int fd);
     ~SignalChannel();
     void notify();
     void clear();
@@ -3,12 +3,12 @@
 #include "hazard_pointers.h"
 
 #include <atomic>
-#include <mutex>
+#include <cstdint>
+#include <utility>
 
 namespace Stitch {
 
 using std::atomic;
-using std::mutex;
 
 // Unordered set.
 // Element type T must support equality comparison (operator '==').
@@ -46,20 +46,57 @@ using std::mutex;
 // This is an over-approximation: we may skip some new nodes, but we will
 // never re-visit a node.
 
+// Insertion and removal use the lock-free ordered list algorithm by
+// T.L.Harris (2001) with hazard pointers as described by M.M.Michael (2004):
+// A node is removed by first marking its link to the next node (logical removal),
+// and then unlinking it from its predecessor (physical removal).
+// Any thread inserting or removing unlinks marked nodes it encounters,
+// and the thread which unlinks a node reclaims it.
+// An iterator treats a marked node like a removed node.
+
+// Since nodes are ordered by address and not by value, concurrent insertion
+// of equal values may insert multiple nodes. After inserting, the inserting
+// thread removes all nodes with equal values except the one with
+// the lowest address, so that eventually a single node remains.
+
 template <typename T>
 class Set
 {
 private:
     struct Node
     {
+        // Least significant bit marks this node as removed.
         atomic<Node*> next { nullptr };
-        atomic<bool> removed { false };
         T value;
     };
 
-    Node head;
+    using Hazard_Pointer = Detail::Hazard_Pointer<Node>;
+
+    static bool is_marked(Node * n) { return uintptr_t(n) & 1; }
+    static Node * marked(Node * n) { return (Node*)(uintptr_t(n) | 1); }
+    static Node * unmarked(Node * n) { return (Node*)(uintptr_t(n) & ~uintptr_t(1)); }
+
+    // Hazard pointers used by insert and remove
+    struct Guard
+    {
+        Guard(): prev(&Detail::Hazard_Pointers::acquire<Node>())
+        {
+            try { cur = &Detail::Hazard_Pointers::acquire<Node>(); }
+            catch (...) { prev->release(); throw; }
+        }
 
-    mutex d_mux;
+        ~Guard()
+        {
+            prev->pointer = cur->pointer = nullptr;
+            prev->release();
+            cur->release();
+        }
+
+        Hazard_Pointer * prev;
+        Hazard_Pointer * cur;
+    };
+
+    Node head;
 
 public:
 
@@ -75,7 +112,7 @@ public:
     /*!
      * \brief Destructor.
      *
-     * - Progress: Blocking
+     * - Progress: Lock-free
      * - Time complexity: Asymptotic O(N). Worst-case O(N + H).
      */
 
@@ -92,6 +129,8 @@ public:
     /*!
      * \brief Returns whether the set contains no elements.
      *
+     * An element being removed by another thread may still be counted.
+     *
      * - Progress: Wait-free
      * - Time complexity: O(1)
      */
@@ -104,32 +143,55 @@ public:
     /*!
      * \brief Inserts the given value if it is not already in the set.
      *
-     * - Progress: Blocking
-     * - Time complexity: O(N)
+     * When the same value is inserted by multiple threads concurrently,
+     * iteration may briefly encounter it more than once.
+     *
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: Asymptotic O(N). Worst-case O(N + H).
      */
 
     void insert(const T & value)
     {
-        std::lock_guard<mutex> lock(d_mux);
+        Guard guard;
+        Node * prev, * cur;
+
+        auto equal = [&](Node * n) { return n->value == value; };
 
         // If value already is already in the set, abort.
-        for(Node * n = head.next; n != nullptr; n = n->next)
-        {
-            if (n->value == value)
-                return;
-        }
+        if (find(equal, prev, cur, guard))
+            return;
 
         // Create node
         Node *node = new Node;
         node->value = value;
 
         // Insert nodes in increasing order of their addresses
-        Node * prev = &head;
-        while(prev->next && prev->next < node)
-            prev = prev->next;
+        for(;;)
+        {
+            find([&](Node * n){ return n >= node; }, prev, cur, guard);
 
-        node->next = prev->next.load();
-        prev->next = node;
+            node->next = cur;
+
+            if (prev->next.compare_exchange_strong(cur, node))
+                break;
+        }
+
+        // Remove duplicates inserted concurrently, except the one with the lowest address.
+        // The node inserted here may already have been removed, so do not access it.
+        Node * first = nullptr;
+        find([&](Node * n)
+        {
+            if (!equal(n))
+                return false;
+            if (!first || n <= first)
+                first = n;
+            else
+                mark(n);
+            return false;
+        },
+        prev, cur, guard);
     }
 
     /*!
@@ -137,52 +199,48 @@ public:
      *
      * Returns whether the value was in the set.
      *
-     * - Progress: Blocking
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free
      * - Time complexity: Asymptotic O(N). Worst-case O(N + H).
      */
 
     bool remove(const T & value)
     {
-        std::lock_guard<mutex> lock(d_mux);
-
+        Guard guard;
         Node * prev, * cur;
-        prev = &head;
-        while((cur = prev->next))
+
+        for(;;)
         {
-            if (cur->value == value)
-            {
-                prev->next = cur->next.load();
-                cur->removed = true;
-                Detail::Hazard_Pointers::reclaim(cur);
-                return true;
-            }
+            if (!find([&](Node * n) { return n->value == value; }, prev, cur, guard))
+                return false;
 
-            prev = cur;
+            if (mark(cur))
+                break;
         }
 
-        return false;
+        unlink(prev, cur, guard);
+
+        return true;
     }
 
     /*!
      * \brief Removes all elements.
      *
-     * - Progress: Blocking
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free
      * - Time complexity: Asymptotic O(N). Worst-case O(N + H).
      */
 
     void clear()
     {
-        std::lock_guard<mutex> lock(d_mux);
+        Guard guard;
+        Node * prev, * cur;
 
-        Node * n = head.next;
-        head.next = nullptr;
-        while(n)
-        {
-            Node * next = n->next;
-            n->removed = true;
-            Detail::Hazard_Pointers::reclaim(n);
-            n = next;
-        }
+        // Each call to find unlinks nodes marked so far.
+        while(find([](Node *) { return true; }, prev, cur, guard))
+            mark(cur);
     }
 
     /*!
@@ -203,40 +261,65 @@ public:
         return false;
     }
 
+    /*!
+     * \brief Marks the end of iteration.
+     *
+     * Unlike an \ref Iterator, it does not use hazard pointers,
+     * so it costs nothing to create and compare.
+     */
+    struct Sentinel {};
+
     /*!
      * Progress guarantees in method descriptions use the following parameters:
      * - N = Number of elements currently in the set.
      * - K = Number of hazard pointers in use.
      * - H = Maximum allowable number of hazard pointers.
+     *
+     * Hazard pointers are only acquired once the iterator
+     * reaches an element, so iterating an empty set uses none.
      */
     struct Iterator
     {
-        Iterator(Node * head): head(head)
-        {
-            hp0.pointer = head;
-            hp1.pointer = nullptr;
-        }
+        Iterator(Node * head): head(head), current(head) {}
 
         // End iterator
         Iterator()
         {}
 
+        /*!
+         * Throws std::runtime_error if hazard pointers can not be allocated.
+         *
+         * - Progress: Wait-free.
+         * - Time complexity: O(1) if hazard pointers are cached by this thread, otherwise O(H).
+         */
         Iterator(const Iterator & other)
         {
-            head = other.head;
-            hp0.pointer = other.hp0.pointer.load();
-            hp1.pointer = nullptr;
+            *this = other;
         }
 
         /*!
+         * Throws std::runtime_error if hazard pointers can not be allocated.
+         *
          * - Progress: Wait-free.
-         * - Time complexity: O(1).
+         * - Time complexity: O(1) if hazard pointers are cached by this thread, otherwise O(H).
          */
         Iterator & operator=(const Iterator & other)
         {
+            if (this == &other)
+                return *this;
+
             head = other.head;
-            hp0.pointer = other.hp0.pointer.load();
-            hp1.pointer = nullptr;
+            last_visited_pos = other.last_visited_pos;
+            current = other.current;
+
+            // The element is still protected by 'other'.
+            if (current && current != head)
+            {
+                if (!hp0)
+                    acquire();
+                hp0->pointer = current;
+            }
+
             return *this;
         }
 
@@ -246,9 +329,11 @@ public:
          */
         ~Iterator()
         {
-            hp0.pointer = hp1.pointer = nullptr;
-            hp0.release();
-            hp1.release();
+            if (hp0)
+            {
+                hp0->release();
+                hp1->release();
+            }
         }
 
         /*!
@@ -257,7 +342,7 @@ public:
          */
         bool operator==(const Iterator & other) const
         {
-            return hp0.pointer == other.hp0.pointer;
+            return current == other.current;
         }
 
         /*!
@@ -269,46 +354,72 @@ public:
             return !(*this == other);
         }
 
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        bool operator==(const Sentinel &) const
+        {
+            return current == nullptr;
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        bool operator!=(const Sentinel &) const
+        {
+            return current != nullptr;
+        }
+
         /*!
          * - Progress: Wait-free.
          * - Time complexity: O(1).
          */
         T & operator*()
         {
-            return hp0.pointer.load()->value;
+            return current->value;
         }
 
         /*!
+         * Throws std::runtime_error if hazard pointers can not be allocated.
+         *
          * - Progress: Lock-free.
          * - Time complexity: O(N + K).
          */
         Iterator & operator++()
         {
-            auto &h0 = hp0.pointer;
-            auto &h1 = hp1.pointer;
-
-            Node * current;
             Node * next;
 
-            current = h0.load();
-
             do
             {
                 next = current->next;
-                h1 = next;
 
-                if (current->removed)
+                if (is_marked(next))
                 {
                     // Restart from head
-                    h0 = current = head;
+                    current = head;
                     continue;
                 }
-                else if (current->next == next)
+
+                if (!next)
+                {
+                    current = nullptr;
+                    break;
+                }
+
+                if (!hp0)
+                    acquire();
+
+                hp1->pointer = next;
+
+                if (current->next == next)
                 {
                     // Successfully got next, so make it current
-                    h0 = current = next;
+                    current = next;
+                    std::swap(hp0, hp1);
                     // Stop if this is a previously unvisited element
-                    if (!current || current > last_visited_pos)
+                    if (current > last_visited_pos)
                         break;
                 }
                 // Repeat for the current element
@@ -322,29 +433,120 @@ public:
         }
 
     private:
+        void acquire()
+        {
+            hp0 = &Detail::Hazard_Pointers::acquire<Node>();
+            try { hp1 = &Detail::Hazard_Pointers::acquire<Node>(); }
+            catch (...) { hp0->release(); hp0 = nullptr; throw; }
+        }
+
         Node * head = nullptr;
         Node * last_visited_pos = nullptr;
-        Detail::Hazard_Pointer<Node> & hp0 = Detail::Hazard_Pointers::acquire<Node>();
-        Detail::Hazard_Pointer<Node> & hp1 = Detail::Hazard_Pointers::acquire<Node>();
+        // The head, an element protected by hp0, or null at the end.
+        Node * current = nullptr;
+        Hazard_Pointer * hp0 = nullptr;
+        Hazard_Pointer * hp1 = nullptr;
     };
 
     /*!
-     * - Progress: Wait-free.
-     * - Time complexity: O(1).
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free.
+     * - Time complexity: O(N + K).
      */
     Iterator begin()
     {
         Iterator it(&head);
-        return ++it;
+        ++it;
+        return it;
     }
 
     /*!
      * - Progress: Wait-free.
      * - Time complexity: O(1).
      */
-    Iterator end()
+    Sentinel end()
+    {
+        return Sentinel();
+    }
+
+private:
+    // Finds the first unmarked node 'cur' for which 'predicate(cur)' returns true.
+    // Returns whether found.
+    // 'prev' is the node linking to 'cur', or the last node if not found.
+    // Both are protected by the guard's hazard pointers.
+    // Marked nodes encountered on the way are unlinked and reclaimed.
+    template <typename P>
+    bool find(P predicate, Node *& prev, Node *& cur, Guard & guard)
     {
-        return Iterator(nullptr);
+        restart:
+
+        prev = &head;
+        cur = head.next;
+
+        for(;;)
+        {
+            if (!cur)
+                return false;
+
+            guard.cur->pointer = cur;
+
+            // Make sure cur was not removed before it was protected.
+            if (prev->next != cur)
+                goto restart;
+
+            Node * next = cur->next;
+
+            if (is_marked(next))
+            {
+                next = unmarked(next);
+
+                Node * expected = cur;
+                if (!prev->next.compare_exchange_strong(expected, next))
+                    goto restart;
+
+                Detail::Hazard_Pointers::reclaim(cur);
+
+                cur = next;
+            }
+            else
+            {
+                if (predicate(cur))
+                    return true;
+
+                prev = cur;
+                std::swap(guard.prev, guard.cur);
+                cur = next;
+            }
+        }
+    }
+
+    // Marks the node as removed. Returns false if it was already marked.
+    static bool mark(Node * n)
+    {
+        Node * next = n->next;
+
+        while (!is_marked(next))
+        {
+            if (n->next.compare_exchange_weak(next, marked(next)))
+                return true;
+        }
+
+        return false;
+    }
+
+    // Unlinks a marked node 'cur' following 'prev'.
+    void unlink(Node * prev, Node * cur, Guard & guard)
+    {
+        Node * expected = cur;
+        if (prev->next.compare_exchange_strong(expected, unmarked(cur->next.load())))
+        {
+            Detail::Hazard_Pointers::reclaim(cur);
+            return;
+        }
+
+        // Failed because the predecessor changed: find unlinks it.
+        find([&](Node * n){ return n >= cur; }, prev, cur, guard);
     }
 };
 
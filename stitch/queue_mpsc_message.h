@@ -0,0 +1,518 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <cstring>
+#include <vector>
+#include <type_traits>
+#include <stdexcept>
+
+namespace Stitch {
+
+using std::vector;
+using std::atomic;
+
+namespace Detail {
+
+/*
+Control block of a Message_Ring.
+
+It contains only positions (not pointers),
+so that a ring can be placed in memory shared between processes,
+where it is mapped at different addresses.
+
+Positions are in units of 8-byte words and increase monotonically.
+A position is wrapped to an index into the data by masking with (capacity - 1).
+*/
+
+struct Message_Ring_Control
+{
+    // Position up to which space was reserved by producers.
+    alignas(64) atomic<uint64_t> reserved { 0 };
+    // Position up to which space was released by the consumer.
+    alignas(64) atomic<uint64_t> released { 0 };
+    // Capacity in words. Must be a power of two.
+    alignas(64) uint64_t capacity = 0;
+};
+
+/*
+A ring of variable-length records.
+
+Each record consists of a header word followed by the payload,
+padded to a whole number of words.
+The header contains the payload size in bytes and flags.
+A record which does not fit before the end of the ring is preceded by
+a padding record which fills the space up to the end of the ring.
+
+Producers reserve space by advancing the 'reserved' position using CAS,
+and publish a record by setting the 'committed' flag in its header.
+
+The consumer reads the record at the 'released' position if its header
+has the 'committed' flag. After consuming, it zeroes the record
+and advances the 'released' position.
+All words in the unreserved space are therefore zero,
+so a header which is not yet committed never appears committed.
+*/
+
+class Message_Ring
+{
+public:
+    static constexpr uint64_t Size_Mask = 0xFFFFFFFF;
+    static constexpr uint64_t Committed = uint64_t(1) << 32;
+    static constexpr uint64_t Padding = uint64_t(1) << 33;
+
+    Message_Ring() {}
+
+    Message_Ring(Message_Ring_Control * control, uint64_t * data):
+        d_control(control),
+        d_data(data),
+        d_mask(control->capacity - 1)
+    {}
+
+    // Number of words occupied by a record with payload of 'size' bytes.
+    static uint64_t record_words(uint64_t size)
+    {
+        return 1 + (size + 7) / 8;
+    }
+
+    // The capacity is read from the control block only on construction,
+    // so that changing it in shared memory can not make the ring access other memory.
+    uint64_t capacity_words() const { return d_mask + 1; }
+
+    // Number of words (a power of two) needed for a capacity of at least 'bytes'.
+    static uint64_t words_for_capacity(uint64_t bytes)
+    {
+        uint64_t v = (std::max<uint64_t>(bytes, 16) + 7) / 8;
+        v--;
+        v |= v >> 1;
+        v |= v >> 2;
+        v |= v >> 4;
+        v |= v >> 8;
+        v |= v >> 16;
+        v |= v >> 32;
+        v++;
+        return v;
+    }
+
+    // Reserves space for 'count' consecutive records, each with payload of 'size' bytes.
+    // Returns index of the first record's header, or -1 if there is not enough space.
+    int64_t reserve(uint64_t size, uint64_t count = 1)
+    {
+        uint64_t capacity = capacity_words();
+        uint64_t record = record_words(size);
+        uint64_t need = record * count;
+
+        if (size > Size_Mask || need > capacity)
+            return -1;
+
+        uint64_t pos = d_control->reserved.load();
+        uint64_t pad;
+
+        for(;;)
+        {
+            uint64_t index = pos & d_mask;
+            pad = (index + need > capacity) ? capacity - index : 0;
+
+            uint64_t released = d_control->released.load();
+            if (released > pos)
+            {
+                // Our reserved position is older than the released position.
+                pos = d_control->reserved.load();
+                continue;
+            }
+
+            if (pos + pad + need - released > capacity)
+                return -1;
+
+            if (d_control->reserved.compare_exchange_weak(pos, pos + pad + need))
+                break;
+        }
+
+        if (pad)
+        {
+            header(pos & d_mask).store(((pad - 1) * 8) | Padding | Committed, std::memory_order_release);
+        }
+
+        uint64_t first = (pos + pad) & d_mask;
+
+        for (uint64_t i = 0; i < count; ++i)
+            header(first + i * record).store(size, std::memory_order_relaxed);
+
+        return first;
+    }
+
+    // Publishes the record with header at 'index'.
+    void commit(uint64_t index)
+    {
+        auto h = header(index);
+        uint64_t size = h.load(std::memory_order_relaxed) & Size_Mask;
+        h.store(size | Committed, std::memory_order_release);
+    }
+
+    // Returns index of the first committed record's header, or -1 if there is none.
+    // If 'skip' is larger than 0, returns the record following 'skip' committed records.
+    // Padding is released as it is encountered (only when 'skip' is 0).
+    int64_t front(uint64_t skip = 0)
+    {
+        uint64_t pos = d_control->released.load(std::memory_order_relaxed);
+        uint64_t end = pos + capacity_words();
+
+        for(; pos < end;)
+        {
+            uint64_t index = pos & d_mask;
+            uint64_t h = header(index).load(std::memory_order_acquire);
+
+            if (!(h & Committed))
+                return -1;
+
+            if (h & Padding)
+            {
+                uint64_t words = record_words(h & Size_Mask);
+                if (skip == 0)
+                    release(index, words);
+                pos += words;
+                continue;
+            }
+
+            if (skip == 0)
+                return index;
+
+            --skip;
+            pos += record_words(h & Size_Mask);
+        }
+
+        return -1;
+    }
+
+    uint64_t size_at(uint64_t index)
+    {
+        return header(index).load(std::memory_order_relaxed) & Size_Mask;
+    }
+
+    void * payload(uint64_t index)
+    {
+        return d_data + index + 1;
+    }
+
+    // Releases the first record, which must be at 'index' as returned by 'front()'.
+    void pop(uint64_t index)
+    {
+        release(index, record_words(size_at(index)));
+    }
+
+private:
+    std::atomic_ref<uint64_t> header(uint64_t index)
+    {
+        return std::atomic_ref<uint64_t>(d_data[index]);
+    }
+
+    void release(uint64_t index, uint64_t words)
+    {
+        std::memset(d_data + index + 1, 0, (words - 1) * 8);
+        header(index).store(0, std::memory_order_relaxed);
+        d_control->released.store(d_control->released.load(std::memory_order_relaxed) + words,
+                                  std::memory_order_release);
+    }
+
+    Message_Ring_Control * d_control = nullptr;
+    uint64_t * d_data = nullptr;
+    uint64_t d_mask = 0;
+};
+
+}
+
+/*!
+\brief Lock-free multi-producer-single-consumer queue of variable-length messages.
+
+Messages are stored contiguously in a ring of bytes, each prefixed by its length.
+A message can be written in place using \ref reserve and \ref commit,
+and read in place using \ref front and \ref pop.
+
+The typed methods \ref push(const T &) and \ref pop(T &) copy
+objects of a trivially copyable type T into and out of messages without serialization.
+Together with the bulk methods, they allow using this class as the queue
+of a \ref Stream_Producer and \ref Stream_Consumer. For example:
+
+    Stream_Producer<Data, Lockfree_MPSC_Message_Queue> producer;
+    Stream_Consumer<Data, Lockfree_MPSC_Message_Queue> consumer(1024);
+
+The queue can also be used by a single producer, in which case
+reservation never needs to retry.
+
+Progress guarantees use the following parameters:
+- P = Number of producers concurrently reserving space.
+*/
+
+class Lockfree_MPSC_Message_Queue
+{
+public:
+    /*!
+    \brief Constructs a queue with at least `capacity` bytes of space.
+
+    Each message occupies 8 bytes for the length prefix,
+    plus the message size rounded up to a multiple of 8 bytes.
+    */
+    Lockfree_MPSC_Message_Queue(int capacity):
+        d_data(Detail::Message_Ring::words_for_capacity(capacity), 0)
+    {
+        d_control.capacity = d_data.size();
+        d_ring = Detail::Message_Ring(&d_control, d_data.data());
+    }
+
+    /*!
+    \brief Constructs a queue in externally allocated memory.
+
+    The memory consists of the `control` block and `control->capacity` words at `data`.
+    The capacity must be a power of two and all the words must initially be zero.
+    The memory must remain valid for the lifetime of the queue.
+
+    The memory contains no pointers, so it can be shared between processes,
+    each using its own instance of this class to access it.
+    See \ref Shared_Stream_Producer and \ref Shared_Stream_Consumer.
+    */
+    Lockfree_MPSC_Message_Queue(Detail::Message_Ring_Control * control, uint64_t * data):
+        d_ring(control, data)
+    {}
+
+    Lockfree_MPSC_Message_Queue(const Lockfree_MPSC_Message_Queue &) = delete;
+    Lockfree_MPSC_Message_Queue & operator=(const Lockfree_MPSC_Message_Queue &) = delete;
+
+    static bool is_lockfree()
+    {
+        return std::atomic_ref<uint64_t>::is_always_lock_free && ATOMIC_LLONG_LOCK_FREE == 2;
+    }
+
+    /*!
+    \brief Capacity in bytes, including length prefixes.
+
+    - Progress: Wait-free
+    - Time complexity: O(1)
+    */
+    int capacity() const
+    {
+        return d_ring.capacity_words() * 8;
+    }
+
+    /*!
+    \brief Reserves space for a message of `size` bytes.
+
+    Returns a pointer to the space, or nullptr if there is not enough space in the queue.
+    The returned space is aligned to 8 bytes.
+    The message becomes available to the consumer when the pointer is passed to \ref commit.
+
+    Space that precedes the message in the queue is blocked for the consumer
+    until the message is committed.
+
+    - Progress: Lock-free
+    - Time complexity: O(P)
+    */
+    void * reserve(int size)
+    {
+        int64_t index = d_ring.reserve(size);
+        if (index < 0)
+            return nullptr;
+        return d_ring.payload(index);
+    }
+
+    /*!
+    \brief Makes a message reserved using \ref reserve available to the consumer.
+
+    - Progress: Wait-free
+    - Time complexity: O(1)
+    */
+    void commit(void * message)
+    {
+        d_ring.commit(index_of(message));
+    }
+
+    /*!
+    \brief Adds a message with a copy of `size` bytes at `data`.
+
+    \return True on success, false if there is not enough space.
+
+    - Progress: Lock-free
+    - Time complexity: O(P + size)
+    */
+    bool push(const void * data, int size)
+    {
+        void * message = reserve(size);
+        if (!message)
+            return false;
+        std::memcpy(message, data, size);
+        commit(message);
+        return true;
+    }
+
+    /*!
+    \brief Adds a message with a copy of `value`.
+
+    Type T must be trivially copyable.
+
+    \return True on success, false if there is not enough space.
+
+    - Progress: Lock-free
+    - Time complexity: O(P)
+    */
+    template <typename T>
+    bool push(const T & value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Type must be trivially copyable.");
+        return push(&value, sizeof(T));
+    }
+
+    /*!
+    \brief Adds `count` messages, each with a copy of one of
+    `count` consecutive objects starting at the `input_start` iterator.
+
+    The value type of the iterator must be trivially copyable.
+    Either all or none of the messages are added.
+
+    \return True on success, false if there is not enough space.
+
+    - Progress: Lock-free
+    - Time complexity: O(P + count)
+    */
+    template <typename I>
+    bool push(int count, I input_start)
+    {
+        using T = typename std::iterator_traits<I>::value_type;
+        static_assert(std::is_trivially_copyable<T>::value, "Type must be trivially copyable.");
+
+        int64_t first = d_ring.reserve(sizeof(T), count);
+        if (first < 0)
+            return false;
+
+        uint64_t words = Detail::Message_Ring::record_words(sizeof(T));
+
+        I input = input_start;
+        for (int i = 0; i < count; ++i, ++input)
+        {
+            const T & value = *input;
+            std::memcpy(d_ring.payload(first + i * words), &value, sizeof(T));
+        }
+
+        for (int i = 0; i < count; ++i)
+            d_ring.commit(first + i * words);
+
+        return true;
+    }
+
+    /*!
+    \brief Whether there are no committed messages.
+
+    May only be called by the consumer.
+
+    - Progress: Wait-free
+    - Time complexity: O(1)
+    */
+    bool empty()
+    {
+        return d_ring.front() < 0;
+    }
+
+    /*!
+    \brief Returns the first message in the queue without removing it.
+
+    Returns a pointer to the message data and stores its size in `size`,
+    or returns nullptr if the queue is empty.
+    The pointer is valid until \ref pop is called.
+
+    - Progress: Wait-free
+    - Time complexity: O(1)
+    */
+    const void * front(int & size)
+    {
+        int64_t index = d_ring.front();
+        if (index < 0)
+            return nullptr;
+        size = d_ring.size_at(index);
+        return d_ring.payload(index);
+    }
+
+    /*!
+    \brief Removes the first message.
+
+    \return True on success, false if the queue is empty.
+
+    - Progress: Wait-free
+    - Time complexity: O(size of message)
+    */
+    bool pop()
+    {
+        int64_t index = d_ring.front();
+        if (index < 0)
+            return false;
+        d_ring.pop(index);
+        return true;
+    }
+
+    /*!
+    \brief Removes the first message and copies its data into `value`.
+
+    Type T must be trivially copyable.
+    If the message size differs from the size of T,
+    only the smaller of the two sizes is copied.
+
+    \return True on success, false if the queue is empty.
+
+    - Progress: Wait-free
+    - Time complexity: O(size of message)
+    */
+    template <typename T>
+    bool pop(T & value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Type must be trivially copyable.");
+
+        int64_t index = d_ring.front();
+        if (index < 0)
+            return false;
+
+        std::memcpy(&value, d_ring.payload(index), std::min<uint64_t>(sizeof(T), d_ring.size_at(index)));
+        d_ring.pop(index);
+        return true;
+    }
+
+    /*!
+    \brief Removes `count` messages and copies them into consecutive objects
+    starting at the `output_start` iterator.
+
+    The value type of the iterator must be trivially copyable.
+    Either all or none of the messages are removed.
+
+    \return True on success, false if there are less than `count` messages.
+
+    - Progress: Wait-free
+    - Time complexity: O(count)
+    */
+    template <typename O>
+    bool pop(int count, O output_start)
+    {
+        if (count < 1)
+            return true;
+
+        if (d_ring.front(count - 1) < 0)
+            return false;
+
+        O output = output_start;
+        for (int i = 0; i < count; ++i, ++output)
+        {
+            pop(*output);
+        }
+
+        return true;
+    }
+
+private:
+    uint64_t index_of(void * message)
+    {
+        return (uint64_t*)message - (uint64_t*)d_ring.payload(0);
+    }
+
+    Detail::Message_Ring_Control d_control;
+    vector<uint64_t> d_data;
+    Detail::Message_Ring d_ring;
+};
+
+}
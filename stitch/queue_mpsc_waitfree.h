@@ -3,6 +3,7 @@
 #include <vector>
 #include <thread>
 #include <stdexcept>
+#include <algorithm>
 
 namespace Stitch {
 
@@ -50,6 +51,21 @@ public:
         return d_journal[d_tail] == false;
     }
 
+    /*!
+    \brief Number of items pushed and not yet popped.
+
+    This includes items which are still being pushed,
+    and may temporarily include items for which push fails.
+    Unlike \ref empty, this can be used by producers.
+
+    - Progess: Wait-free
+    - Time complexity: O(1)
+    */
+    int size() const
+    {
+        return std::max(0, capacity() - d_writable.load());
+    }
+
     /*!
     \brief Adds an item to the queue.
 
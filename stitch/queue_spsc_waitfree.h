@@ -6,12 +6,15 @@ namespace Stitch {
 using std::vector;
 using std::atomic;
 
-// FIXME: Relax memory ordering constraints
-
 /*!
 \brief Single-producer-single-consumer queue.
 
 All methods have wait-free progress guarantee.
+
+Each position is only written by one side of the queue, so no
+read-modify-write operations are used: the producer and the consumer
+each publish their own position with a release store and read
+the other's position with an acquire load.
 */
 
 template <typename T>
@@ -93,7 +96,7 @@ public:
         if (!writable_size())
             return false;
 
-        d_data[d_write_pos] = value;
+        d_data[d_write_pos.load(std::memory_order_relaxed)] = value;
         advance_write(1);
         return true;
     }
@@ -118,7 +121,7 @@ public:
         if (writable_size() < count)
             return false;
 
-        int w = d_write_pos;
+        int w = d_write_pos.load(std::memory_order_relaxed);
         int s = d_data.size();
         I input = input_start;
 
@@ -143,7 +146,7 @@ public:
             }
         }
 
-        d_write_pos = w;
+        d_write_pos.store(w % s, std::memory_order_release);
         return true;
     }
 
@@ -166,7 +169,7 @@ public:
         if (!readable_size())
             return false;
 
-        value = d_data[d_read_pos];
+        value = d_data[d_read_pos.load(std::memory_order_relaxed)];
         advance_read(1);
         return true;
     }
@@ -192,7 +195,7 @@ public:
         if (readable_size() < count)
             return false;
 
-        int r = d_read_pos;
+        int r = d_read_pos.load(std::memory_order_relaxed);
         int s = d_data.size();
         O output = output_start;
 
@@ -217,7 +220,7 @@ public:
             }
         }
 
-        d_read_pos = r;
+        d_read_pos.store(r % s, std::memory_order_release);
         return true;
     }
 
@@ -229,8 +232,8 @@ private:
         if (!s)
             return 0;
 
-        int r = d_read_pos;
-        int w = d_write_pos;
+        int r = d_read_pos.load(std::memory_order_acquire);
+        int w = d_write_pos.load(std::memory_order_acquire);
         int count = (s + w - r) % s;
         return count;
     }
@@ -242,21 +245,23 @@ private:
         if (!s)
             return 0;
 
-        int r = d_read_pos;
-        int w = d_write_pos;
+        int r = d_read_pos.load(std::memory_order_acquire);
+        int w = d_write_pos.load(std::memory_order_acquire);
         int count = (s + r - w - 1) % s;
         return count;
     }
 
     void advance_write(int count)
     {
-        d_write_pos = (d_write_pos + count) % d_data.size();
+        int w = d_write_pos.load(std::memory_order_relaxed);
+        d_write_pos.store((w + count) % d_data.size(), std::memory_order_release);
     }
 
 
     void advance_read(int count)
     {
-        d_read_pos = (d_read_pos + count) % d_data.size();
+        int r = d_read_pos.load(std::memory_order_relaxed);
+        d_read_pos.store((r + count) % d_data.size(), std::memory_order_release);
     }
 
     atomic<int> d_write_pos { 0 };
@@ -0,0 +1 @@
+#include "linux/shared_memory.h"
@@ -0,0 +1,491 @@
+#pragma once
+
+#include "atom_mpmc.h"
+#include "shared_memory.h"
+#include "signal.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <stdexcept>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+namespace Stitch {
+
+using std::string;
+
+namespace Detail {
+
+// Layout of a shared state's memory.
+template <typename T>
+struct Shared_State_Memory
+{
+    static constexpr uint64_t Magic = 0x5354495443485354; // "STITCHST"
+    static constexpr int Max_Observers = 64;
+
+    Shared_State_Memory(const T & value): atom(value) {}
+
+    uint64_t magic = Magic;
+    uint64_t value_size = sizeof(T);
+    // Per observer: Whether a notification was sent and not yet consumed.
+    std::atomic<uint32_t> pending[Max_Observers] {};
+
+    MPMC_Atom<T> atom;
+};
+
+// Sent to an observer together with file descriptors of memory and signal.
+struct Shared_State_Handshake
+{
+    uint64_t memory_size;
+    uint64_t slot;
+};
+
+}
+
+/*!
+\brief Stores a value read by \ref Shared_State_Observer "Shared_State_Observers" in other processes.
+
+This class mirrors \ref State, but the value is placed in memory
+shared with other processes (see \ref Shared_Memory), in a \ref MPMC_Atom,
+so type T must be trivially copyable.
+Loading the value by an observer is a sequence lock read,
+which involves no system calls and does not write to shared memory.
+
+Each observer is notified of changes via its own eventfd.
+As with \ref State, an observer which has not yet handled its
+notification is not notified again, so storing costs a system call
+only for observers waiting for a change.
+
+The state listens for observers on a Unix domain socket at a given path.
+An observer connects using \ref Shared_State_Observer::connect, and
+the state admits it using \ref accept, which hands over the file descriptors
+of the shared memory and the observer's eventfd.
+At most \ref Max_Observers observers can be connected at the same time.
+
+Unless otherwise noted, the methods of this class should only be called from a single thread.
+
+Progress guarantees use the following parameters:
+- C = Number of connected observers.
+*/
+
+template <typename T>
+class Shared_State
+{
+    using Memory = Detail::Shared_State_Memory<T>;
+
+public:
+    //! Maximum number of observers connected at the same time.
+    static constexpr int Max_Observers = Memory::Max_Observers;
+
+    /*!
+    \brief Creates the shared memory, stores `value`,
+    and listens for observers on a Unix domain socket at `path`.
+
+    Throws std::runtime_error on failure.
+
+    - Progress: Blocking
+    */
+    Shared_State(const string & path, const T & value = T()):
+        d_listener(path),
+        d_value(value)
+    {
+        d_memory.create(sizeof(Memory));
+
+        d_shared = new (d_memory.data()) Memory(value);
+    }
+
+    ~Shared_State()
+    {
+        for (auto & observer : d_observers)
+            close(observer.connection);
+    }
+
+    Shared_State(const Shared_State &) = delete;
+    Shared_State & operator=(const Shared_State &) = delete;
+
+    /*!
+    \brief Admits all observers currently waiting to connect,
+    and releases observers which have disconnected.
+
+    Observers beyond \ref Max_Observers are refused.
+
+    Does not wait for observers to connect.
+
+    - Progress: Blocking
+    - Time complexity: O(C)
+    */
+    void accept()
+    {
+        release_disconnected();
+
+        int connection;
+
+        while ((connection = d_listener.accept()) != -1)
+        {
+            int slot = free_slot();
+            if (slot < 0)
+            {
+                close(connection);
+                continue;
+            }
+
+            Observer observer;
+            observer.connection = connection;
+            observer.slot = slot;
+            observer.signal = std::make_unique<Detail::SignalChannel>();
+
+            d_shared->pending[slot] = 0;
+
+            Detail::Shared_State_Handshake handshake { d_memory.size(), uint64_t(slot) };
+            int fds[2] = { d_memory.fd(), observer.signal->fd };
+
+            try {
+                send_file_descriptors(connection, &handshake, sizeof(handshake), fds, 2);
+            } catch (...) {
+                // The observer went away.
+                close(connection);
+                continue;
+            }
+
+            d_observers.push_back(std::move(observer));
+        }
+    }
+
+    /*!
+    \brief A conditional event active while observers are waiting to be admitted using \ref accept.
+    */
+    Event connection_event()
+    {
+        return d_listener.event();
+    }
+
+    /*!
+    \brief Returns the number of admitted observers.
+
+    Observers which have disconnected are counted until the next \ref accept.
+    */
+    int observer_count() const
+    {
+        return d_observers.size();
+    }
+
+    /*! \brief Returns a reference to the value to be written.
+
+        This value is made available to observers by calling \ref store.
+
+       - Progress: Wait-free
+       - Time complexity: O(1)
+    */
+    T & value() { return d_value; }
+
+    /*! \brief Makes \ref value available to observers and notifies them.
+
+     - Progress: Lock-free.
+     - Time complexity: O(C + size of T).
+     */
+    void store()
+    {
+        d_shared->atom.store(d_value);
+
+        // Order after storing the value, so that an observer which consumes
+        // its notification after the check below will load the value.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        for (auto & observer : d_observers)
+        {
+            auto & pending = d_shared->pending[observer.slot];
+            if (!pending.load(std::memory_order_relaxed) && !pending.exchange(1))
+                observer.signal->notify();
+        }
+    }
+
+    /*! \brief Copies given value to \ref value and makes it available to observers.
+
+     - Progress: Lock-free.
+     - Time complexity: O(C + size of T).
+     */
+    void store(const T & value)
+    {
+        d_value = value;
+        store();
+    }
+
+private:
+    struct Observer
+    {
+        int connection;
+        int slot;
+        std::unique_ptr<Detail::SignalChannel> signal;
+    };
+
+    // An observer disconnects by closing its end of the connection.
+    void release_disconnected()
+    {
+        for (size_t i = 0; i < d_observers.size();)
+        {
+            char data;
+            if (recv(d_observers[i].connection, &data, 1, MSG_DONTWAIT | MSG_PEEK) == 0)
+            {
+                close(d_observers[i].connection);
+                d_observers[i] = std::move(d_observers.back());
+                d_observers.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+    int free_slot() const
+    {
+        for (int slot = 0; slot < Max_Observers; ++slot)
+        {
+            bool used = false;
+            for (auto & observer : d_observers)
+                used |= observer.slot == slot;
+            if (!used)
+                return slot;
+        }
+
+        return -1;
+    }
+
+    Shared_Memory d_memory;
+    Unix_Socket_Listener d_listener;
+    Memory * d_shared = nullptr;
+    std::vector<Observer> d_observers;
+    T d_value;
+};
+
+/*!
+\brief Reads the last value stored by a \ref Shared_State in another process.
+
+This class mirrors \ref State_Observer, except that it connects
+to a state identified by the path of its Unix domain socket.
+
+After connecting, loading the value involves no communication
+over the socket and no system calls.
+
+Unless otherwise noted, the methods of this class should only be called from a single thread.
+*/
+
+template <typename T>
+class Shared_State_Observer
+{
+    using Memory = Detail::Shared_State_Memory<T>;
+
+public:
+    /*! \brief Constructs an unconnected observer with a default value.
+
+      The default value is returned by \ref load and \ref value
+      when the observer is not connected.
+    */
+    Shared_State_Observer(const T & default_value = T()):
+        d_default_value(default_value),
+        d_value(default_value)
+    {}
+
+    ~Shared_State_Observer()
+    {
+        disconnect();
+    }
+
+    Shared_State_Observer(const Shared_State_Observer &) = delete;
+    Shared_State_Observer & operator=(const Shared_State_Observer &) = delete;
+
+    /*!
+    \brief Connects to the state listening at `path`.
+
+    Waits until the state admits this observer using \ref Shared_State::accept.
+    Any existing connection is closed first.
+
+    Throws std::runtime_error if the connection fails, the state refuses
+    the observer, or the state's value type has a different size.
+
+    - Progress: Blocking
+    */
+    void connect(const string & path)
+    {
+        disconnect();
+
+        int connection = connect_unix_socket(path);
+
+        Detail::Shared_State_Handshake handshake;
+        int fds[2] = { -1, -1 };
+        int count;
+
+        try {
+            count = receive_file_descriptors(connection, &handshake, sizeof(handshake), fds, 2);
+        } catch (...) {
+            close(connection);
+            throw;
+        }
+
+        if (count != 2)
+        {
+            close(connection);
+            for (int i = 0; i < count; ++i)
+                close(fds[i]);
+            throw std::runtime_error("Shared state: Did not receive file descriptors.");
+        }
+
+        // Keep the connection open while connected,
+        // so the state knows when this observer goes away.
+        d_connection = connection;
+        d_signal.emplace(fds[1]);
+        d_memory.map(fds[0]);
+
+        auto shared = (Memory*) d_memory.data();
+
+        if (d_memory.size() < sizeof(Memory) ||
+                shared->magic != Memory::Magic ||
+                shared->value_size != sizeof(T) ||
+                handshake.slot >= Memory::Max_Observers)
+        {
+            disconnect();
+            throw std::runtime_error("Shared state: Invalid shared memory.");
+        }
+
+        d_shared = shared;
+        d_slot = handshake.slot;
+        d_version = ~uint64_t(0);
+    }
+
+    /*! \brief Closes the connection, if any.
+
+      Restores the default value as the current value.
+    */
+    void disconnect()
+    {
+        d_shared = nullptr;
+        d_memory.release();
+        d_signal.reset();
+
+        if (d_connection != -1)
+        {
+            close(d_connection);
+            d_connection = -1;
+        }
+
+        d_value = d_default_value;
+    }
+
+    bool is_connected() const
+    {
+        return d_shared != nullptr;
+    }
+
+    /*! \brief Loads the latest value stored by the connected \ref Shared_State.
+
+      Returns the default value when not connected.
+
+      - Progress: Lock-free (with respect to the state).
+      - Time complexity: O(size of T).
+     */
+    const T & load()
+    {
+        if (d_shared)
+        {
+            // Read version before the value, so that the value
+            // is at least as new as the version.
+            d_version = d_shared->atom.version();
+            d_value = d_shared->atom.load();
+        }
+
+        return d_value;
+    }
+
+    /*! \brief Loads the latest value if it changed since the last \ref load.
+
+      \return Whether the value was loaded.
+
+      - Progress: Lock-free (with respect to the state).
+      - Time complexity: O(1) if not changed, otherwise O(size of T).
+     */
+    bool load_if_changed()
+    {
+        if (!has_changed())
+            return false;
+
+        load();
+        return true;
+    }
+
+    /*! \brief Whether a value was stored since the last \ref load.
+
+      Returns false when not connected.
+
+      - Progress: Wait-free.
+      - Time complexity: O(1).
+     */
+    bool has_changed() const
+    {
+        return d_shared && d_shared->atom.version() != d_version;
+    }
+
+    /*! \brief Returns the number of values stored by the connected state so far,
+      or 0 when not connected.
+
+      - Progress: Wait-free.
+      - Time complexity: O(1).
+     */
+    uint64_t version() const
+    {
+        return d_shared ? d_shared->atom.version() : 0;
+    }
+
+    /*! \brief Returns a reference to the last loaded value.
+
+      - Progress: Wait-free.
+      - Time complexity: O(1).
+     */
+    const T & value() const
+    {
+        return d_value;
+    }
+
+    /*! \brief An \ref Event activated whenever a new value is stored by the connected state.
+
+      Multiple values stored before the event is handled activate it only once.
+
+      Throws std::runtime_error when not connected.
+     */
+    Event changed()
+    {
+        if (!d_shared)
+            throw std::runtime_error("Shared state: Not connected.");
+
+        Event e;
+        e.fd = d_signal->fd;
+        e.epoll_events = EPOLLIN;
+        e.poll_events = POLLIN;
+        e.clear = [signal = &*d_signal, pending = &d_shared->pending[d_slot]]()
+        {
+            signal->clear();
+            pending->store(0);
+            // Order before loading the value, so a value stored after
+            // the flag was observed as set is not missed.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        };
+        return e;
+    }
+
+private:
+    T d_default_value;
+    T d_value;
+    Shared_Memory d_memory;
+    std::optional<Detail::SignalChannel> d_signal;
+    int d_connection = -1;
+    Memory * d_shared = nullptr;
+    uint64_t d_slot = 0;
+    uint64_t d_version = ~uint64_t(0);
+};
+
+}
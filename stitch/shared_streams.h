@@ -0,0 +1,399 @@
+#pragma once
+
+#include "queue_mpsc_message.h"
+#include "shared_memory.h"
+#include "signal.h"
+
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <string>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+namespace Stitch {
+
+using std::string;
+
+namespace Detail {
+
+// Layout of the beginning of a shared stream's memory.
+// It is followed by the queue data, starting at offset 'data_offset'.
+struct Shared_Stream_Header
+{
+    static constexpr uint64_t Magic = 0x5354495443485353; // "STITCHSS"
+
+    uint64_t magic;
+    uint64_t item_size;
+    uint64_t data_offset;
+    Message_Ring_Control queue;
+};
+
+// Sent to a producer together with file descriptors of memory and signal.
+struct Shared_Stream_Handshake
+{
+    uint64_t memory_size;
+};
+
+}
+
+/*!
+\brief Receives a stream of items from \ref Shared_Stream_Producer "Shared_Stream_Producers" in other processes.
+
+This class mirrors \ref Stream_Consumer, but the queue is placed in memory
+shared with other processes (see \ref Shared_Memory), and producers are notified
+via an eventfd shared with producers.
+
+The queue is a \ref Lockfree_MPSC_Message_Queue, so items of type T must be
+trivially copyable. Variable-length messages can also be used via
+\ref front(int&) and \ref pop().
+
+The consumer listens for producers on a Unix domain socket at a given path.
+A producer connects using \ref Shared_Stream_Producer::connect, and
+the consumer admits it using \ref accept, which hands over the file descriptors
+of the shared memory and the eventfd.
+
+Progress guarantees and time complexity of queue operations
+are equal to those of \ref Stream_Consumer.
+*/
+
+template <typename T>
+class Shared_Stream_Consumer
+{
+public:
+    /*!
+    \brief Creates the shared queue with a capacity of `capacity` bytes
+    and listens for producers on a Unix domain socket at `path`.
+
+    See \ref Lockfree_MPSC_Message_Queue::Lockfree_MPSC_Message_Queue(int)
+    for the meaning of capacity.
+
+    - Progress: Blocking
+    */
+    Shared_Stream_Consumer(const string & path, int capacity):
+        d_listener(path)
+    {
+        using Header = Detail::Shared_Stream_Header;
+
+        uint64_t data_offset = (sizeof(Header) + 63) / 64 * 64;
+        uint64_t words = Detail::Message_Ring::words_for_capacity(capacity);
+
+        d_memory.create(data_offset + words * 8);
+
+        auto header = new (d_memory.data()) Header;
+        header->magic = Header::Magic;
+        header->item_size = sizeof(T);
+        header->data_offset = data_offset;
+        header->queue.capacity = words;
+
+        d_queue.emplace(&header->queue, (uint64_t*)((char*) d_memory.data() + data_offset));
+    }
+
+    Shared_Stream_Consumer(const Shared_Stream_Consumer &) = delete;
+    Shared_Stream_Consumer & operator=(const Shared_Stream_Consumer &) = delete;
+
+    /*!
+    \brief Admits all producers currently waiting to connect.
+
+    Does not wait for producers to connect.
+
+    - Progress: Blocking
+    */
+    void accept()
+    {
+        int connection;
+
+        while ((connection = d_listener.accept()) != -1)
+        {
+            Detail::Shared_Stream_Handshake handshake { d_memory.size() };
+            int fds[2] = { d_memory.fd(), d_signal.fd };
+
+            try {
+                send_file_descriptors(connection, &handshake, sizeof(handshake), fds, 2);
+            } catch (...) {
+                // The producer went away.
+            }
+
+            close(connection);
+        }
+    }
+
+    /*!
+    \brief A conditional event active while producers are waiting to be admitted using \ref accept.
+    */
+    Event connection_event()
+    {
+        return d_listener.event();
+    }
+
+    /*!
+    \brief Whether the queue is empty.
+
+    - Progress: Wait-free
+    - Time complexity: O(1)
+    */
+    bool empty()
+    {
+        return d_queue->empty();
+    }
+
+    /*!
+    \brief Removes an item from the queue.
+
+    See: \ref Lockfree_MPSC_Message_Queue::pop(T&).
+
+    - Progress: Wait-free
+    - Time complexity: O(1)
+    */
+    bool pop(T & v)
+    {
+        return d_queue->pop(v);
+    }
+
+    /*!
+    \brief Removes items in bulk from the queue.
+
+    See: \ref Lockfree_MPSC_Message_Queue::pop(int, O).
+
+    - Progress: Wait-free
+    - Time complexity: O(count)
+    */
+    template <typename O>
+    bool pop(int count, O output)
+    {
+        return d_queue->pop(count, output);
+    }
+
+    /*!
+    \brief Returns the first variable-length message without removing it.
+
+    See: \ref Lockfree_MPSC_Message_Queue::front(int&).
+
+    - Progress: Wait-free
+    - Time complexity: O(1)
+    */
+    const void * front(int & size)
+    {
+        return d_queue->front(size);
+    }
+
+    /*!
+    \brief Removes the first variable-length message.
+
+    See: \ref Lockfree_MPSC_Message_Queue::pop().
+
+    - Progress: Wait-free
+    - Time complexity: O(size of message)
+    */
+    bool pop()
+    {
+        return d_queue->pop();
+    }
+
+    /*!
+    \brief Returns an event activated when items are pushed by producers.
+    */
+    Event receive_event()
+    {
+        Event e;
+        e.fd = d_signal.fd;
+        e.epoll_events = EPOLLIN;
+        e.poll_events = POLLIN;
+        e.clear = std::bind(&Detail::SignalChannel::clear, &d_signal);
+        return e;
+    }
+
+private:
+    Shared_Memory d_memory;
+    Detail::SignalChannel d_signal;
+    Unix_Socket_Listener d_listener;
+    std::optional<Lockfree_MPSC_Message_Queue> d_queue;
+};
+
+/*!
+\brief Sends a stream of items to a \ref Shared_Stream_Consumer in another process.
+
+This class mirrors \ref Stream_Producer, except that it connects
+to a single consumer identified by the path of its Unix domain socket.
+
+Items are written directly into memory shared with the consumer,
+and the consumer is notified via an eventfd.
+After connecting, pushing items involves no communication over the socket.
+
+Progress guarantees and time complexity of queue operations
+are equal to those of \ref Stream_Producer.
+*/
+
+template <typename T>
+class Shared_Stream_Producer
+{
+public:
+    /*! \brief Constructs an unconnected producer. */
+    Shared_Stream_Producer() {}
+
+    /*! \brief Constructs a producer and connects it to the consumer at `path`.
+
+      See \ref connect.
+    */
+    Shared_Stream_Producer(const string & path)
+    {
+        connect(path);
+    }
+
+    Shared_Stream_Producer(const Shared_Stream_Producer &) = delete;
+    Shared_Stream_Producer & operator=(const Shared_Stream_Producer &) = delete;
+
+    /*!
+    \brief Connects to the consumer listening at `path`.
+
+    Waits until the consumer admits this producer using \ref Shared_Stream_Consumer::accept.
+    Any existing connection is closed first.
+
+    Throws std::runtime_error if the connection fails or the consumer's
+    item type has a different size.
+
+    - Progress: Blocking
+    */
+    void connect(const string & path)
+    {
+        using Header = Detail::Shared_Stream_Header;
+
+        disconnect();
+
+        int connection = connect_unix_socket(path);
+
+        Detail::Shared_Stream_Handshake handshake;
+        int fds[2] = { -1, -1 };
+        int count;
+
+        try {
+            count = receive_file_descriptors(connection, &handshake, sizeof(handshake), fds, 2);
+        } catch (...) {
+            close(connection);
+            throw;
+        }
+
+        close(connection);
+
+        if (count != 2)
+        {
+            for (int i = 0; i < count; ++i)
+                close(fds[i]);
+            throw std::runtime_error("Shared stream: Did not receive file descriptors.");
+        }
+
+        d_signal.emplace(fds[1]);
+        d_memory.map(fds[0]);
+
+        auto header = (Header*) d_memory.data();
+
+        // The header is read once, since other processes may change it.
+        uint64_t data_offset = 0;
+        uint64_t capacity = 0;
+
+        bool valid = d_memory.size() >= sizeof(Header);
+
+        if (valid)
+        {
+            data_offset = header->data_offset;
+            capacity = header->queue.capacity;
+
+            valid = header->magic == Header::Magic &&
+                    header->item_size == sizeof(T) &&
+                    fits(data_offset, capacity, d_memory.size());
+        }
+
+        if (valid)
+        {
+            d_queue.emplace(&header->queue, (uint64_t*)((char*) d_memory.data() + data_offset));
+
+            // The queue reads the capacity again, and only uses the value it read.
+            valid = d_queue->capacity() == (int64_t) capacity * 8;
+        }
+
+        if (!valid)
+        {
+            disconnect();
+            throw std::runtime_error("Shared stream: Invalid shared memory.");
+        }
+    }
+
+    /*! \brief Closes the connection, if any. */
+    void disconnect()
+    {
+        d_queue.reset();
+        d_memory.release();
+        d_signal.reset();
+    }
+
+    bool is_connected() const
+    {
+        return d_queue.has_value();
+    }
+
+    /*!
+    \brief Adds an item to the consumer's queue.
+
+    If the queue is full, the item is dropped.
+
+    - Progress: Lock-free
+    - Time complexity: O(1)
+    */
+    void push(const T & val)
+    {
+        if (d_queue && d_queue->push(val))
+            d_signal->notify();
+    }
+
+    /*!
+    \brief Adds items in bulk to the consumer's queue.
+
+    If the queue does not have space for all items, none are added.
+
+    - Progress: Lock-free
+    - Time complexity: O(count)
+    */
+    template <typename I>
+    void push(int count, I input)
+    {
+        if (d_queue && d_queue->push(count, input))
+            d_signal->notify();
+    }
+
+    /*!
+    \brief Adds a variable-length message to the consumer's queue.
+
+    - Progress: Lock-free
+    - Time complexity: O(size)
+    */
+    void push(const void * data, int size)
+    {
+        if (d_queue && d_queue->push(data, size))
+            d_signal->notify();
+    }
+
+private:
+    // Returns whether a queue with 'capacity' words at 'data_offset'
+    // is a valid ring within memory of the given size.
+    static bool fits(uint64_t data_offset, uint64_t capacity, uint64_t size)
+    {
+        using Header = Detail::Shared_Stream_Header;
+
+        // Positions are wrapped by masking with (capacity - 1).
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+            return false;
+
+        if (data_offset < sizeof(Header) || data_offset % 8 != 0 || data_offset > size)
+            return false;
+
+        return capacity <= (size - data_offset) / 8;
+    }
+
+    Shared_Memory d_memory;
+    std::optional<Detail::SignalChannel> d_signal;
+    std::optional<Lockfree_MPSC_Message_Queue> d_queue;
+};
+
+}
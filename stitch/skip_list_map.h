@@ -0,0 +1,671 @@
+#pragma once
+
+#include "hazard_pointers.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+namespace Stitch {
+
+using std::atomic;
+
+/*! \brief Lock-free ordered map.
+ *
+ * Keys are ordered by `Compare`, which must be a strict weak ordering.
+ * Keys are equal if neither is ordered before the other.
+ *
+ * Like with \ref Hash_Map, values are immutable once inserted:
+ * \ref find returns a copy of the value.
+ *
+ * Iteration visits elements in key order, starting either at the first
+ * element (\ref begin) or at a given key (\ref lower_bound, \ref upper_bound).
+ *
+ * Progress guarantees in method descriptions use the following parameters:
+ * - N = Number of elements currently in the map.
+ * - L = Maximum number of levels (Max_Level).
+ * - K = Number of hazard pointers in use.
+ * - H = Maximum allowable number of hazard pointers.
+ */
+
+// This is a lock-free skip list as described by K.Fraser (2004) and
+// M.Herlihy and N.Shavit (The Art of Multiprocessor Programming, 2008):
+// Each node is linked in the list at level 0 and, with decreasing probability,
+// in the lists at higher levels, which are used to skip over many nodes at a time.
+// A node is removed by marking its links at all levels (logical removal), and
+// then unlinking it at each level (physical removal), as in the lockfree_set.h.
+// Level 0 determines whether a node is in the map: the thread which
+// marks the link at level 0 is the one which removed the node.
+//
+// A node can be reclaimed only when it is unlinked at all levels.
+// However, the thread which inserted the node may still be linking
+// it at higher levels after it was removed. Therefore, both the inserting
+// and the removing thread search for the key after they are done,
+// which unlinks the node at all levels, and the last of the two
+// to finish reclaims the node using hazard pointers.
+//
+// Searching keeps hazard pointers on the predecessor and current node
+// at the current level. Insertion additionally keeps hazard pointers
+// on the predecessor and successor at each level of the new node.
+
+template <typename K, typename V, typename Compare = std::less<K>>
+class Skip_List_Map
+{
+public:
+    using Entry = std::pair<const K, V>;
+
+    static constexpr int Max_Level = 16;
+
+private:
+    struct Node
+    {
+        Node(int level): level(level) {}
+
+        // Least significant bit marks this node as removed at that level.
+        atomic<Node*> next[Max_Level] = {};
+        const int level;
+    };
+
+    struct Data_Node : Node
+    {
+        Data_Node(int level, const K & key, const V & value):
+            Node(level), entry(key, value) {}
+
+        Entry entry;
+        // Number of threads (inserting and removing) which still use the node.
+        atomic<int> users { 2 };
+    };
+
+    using Hazard_Pointer = Detail::Hazard_Pointer<Node>;
+
+    // Hazard pointers used by a search, acquired as needed.
+    // Slots 0 and 1 protect the predecessor and current node.
+    // Slots 2 + 2 * level and 3 + 2 * level protect the predecessor
+    // and successor kept at that level.
+    struct Guard
+    {
+        ~Guard()
+        {
+            for (auto * hp : slots)
+            {
+                if (hp)
+                    hp->release();
+            }
+        }
+
+        Hazard_Pointer & slot(int i)
+        {
+            if (!slots[i])
+                slots[i] = &Detail::Hazard_Pointers::acquire<Node>();
+            return *slots[i];
+        }
+
+        Hazard_Pointer * slots[2 * Max_Level + 2] = {};
+    };
+
+    static bool is_marked(Node * n) { return uintptr_t(n) & 1; }
+    static Node * marked(Node * n) { return (Node*)(uintptr_t(n) | 1); }
+    static Node * unmarked(Node * n) { return (Node*)(uintptr_t(n) & ~uintptr_t(1)); }
+
+    static const K & key_of(Node * n) { return static_cast<Data_Node*>(n)->entry.first; }
+
+public:
+
+    /*!
+     * \brief Constructs an empty map.
+     *
+     * - Progress: Wait-free
+     * - Time complexity: O(1)
+     */
+
+    Skip_List_Map() {}
+
+    /*!
+     * \brief Destroys the map and all its elements.
+     *
+     * - Progress: Blocking
+     * - Time complexity: O(N)
+     */
+
+    ~Skip_List_Map()
+    {
+        Node * n = unmarked(d_head.next[0].load());
+        while(n)
+        {
+            Node * next = unmarked(n->next[0].load());
+            delete static_cast<Data_Node*>(n);
+            n = next;
+        }
+    }
+
+    Skip_List_Map(const Skip_List_Map &) = delete;
+    Skip_List_Map & operator=(const Skip_List_Map &) = delete;
+
+    /*!
+     * \brief Returns the number of elements.
+     *
+     * Elements inserted or erased concurrently may or may not be counted.
+     *
+     * - Progress: Wait-free
+     * - Time complexity: O(1)
+     */
+
+    int size() const
+    {
+        return (int) d_size.load();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /*!
+     * \brief Inserts the key with the given value, if the key is not already in the map.
+     *
+     * Returns whether the key was inserted.
+     *
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: Expected O(log N). Worst-case O(N + H).
+     */
+
+    bool insert(const K & key, const V & value)
+    {
+        int level = random_level();
+
+        int top = d_levels.load();
+        while (top < level && !d_levels.compare_exchange_weak(top, level)) {}
+
+        Guard guard;
+        Node * preds[Max_Level];
+        Node * succs[Max_Level];
+        Data_Node * node = nullptr;
+
+        for(;;)
+        {
+            if (find(key, false, false, level, preds, succs, guard))
+            {
+                delete node;
+                return false;
+            }
+
+            if (!node)
+                node = new Data_Node(level, key, value);
+
+            for (int i = 0; i < level; ++i)
+                node->next[i].store(succs[i], std::memory_order_relaxed);
+
+            if (preds[0]->next[0].compare_exchange_strong(succs[0], node))
+                break;
+        }
+
+        d_size.fetch_add(1);
+
+        link_upper_levels(node, preds, succs, guard);
+
+        // If the node was removed while linking, make sure it is unlinked.
+        if (is_marked(node->next[0]))
+            find(key, false, false, 0, nullptr, nullptr, guard);
+
+        release(node);
+
+        return true;
+    }
+
+    /*!
+     * \brief Removes the key, if it is in the map.
+     *
+     * Returns whether the key was in the map.
+     *
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: Expected O(log N). Worst-case O(N + H).
+     */
+
+    bool erase(const K & key)
+    {
+        Guard guard;
+        Node * preds[Max_Level];
+        Node * succs[Max_Level];
+
+        Node * found = find(key, false, false, 1, preds, succs, guard);
+        if (!found)
+            return false;
+
+        auto node = static_cast<Data_Node*>(found);
+
+        for (int i = node->level - 1; i >= 1; --i)
+            mark(node->next[i]);
+
+        if (!mark(node->next[0]))
+            return false; // Removed by another thread
+
+        d_size.fetch_sub(1);
+
+        // Unlinks the node at all levels
+        find(key, false, false, 0, nullptr, nullptr, guard);
+
+        release(node);
+
+        return true;
+    }
+
+    /*!
+     * \brief Copies the value of the key into `value`, if the key is in the map.
+     *
+     * Returns whether the key is in the map.
+     *
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: Expected O(log N). Worst-case O(N + H).
+     */
+
+    bool find(const K & key, V & value)
+    {
+        Guard guard;
+
+        Node * found = find(key, false, false, 0, nullptr, nullptr, guard);
+        if (!found)
+            return false;
+
+        value = static_cast<Data_Node*>(found)->entry.second;
+        return true;
+    }
+
+    /*!
+     * \brief Returns whether the key is in the map.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: Expected O(log N). Worst-case O(N + H).
+     */
+
+    bool contains(const K & key)
+    {
+        Guard guard;
+        return find(key, false, false, 0, nullptr, nullptr, guard) != nullptr;
+    }
+
+    /*!
+     * \brief Marks the end of iteration.
+     */
+    struct Sentinel {};
+
+    /*!
+     * \brief Iterates over elements in key order.
+     *
+     * If the current element is removed, iteration continues
+     * with the next greater key in the map. Elements inserted or erased
+     * during iteration may or may not be visited.
+     *
+     * Dereferencing the iterator gives an \ref Entry, a pair of key and value.
+     *
+     * Hazard pointers are only acquired once the iterator
+     * reaches an element.
+     */
+    struct Iterator
+    {
+        // End iterator
+        Iterator() {}
+
+        /*!
+         * Throws std::runtime_error if hazard pointers can not be allocated.
+         *
+         * - Progress: Wait-free.
+         * - Time complexity: O(1) if hazard pointers are cached by this thread, otherwise O(H).
+         */
+        Iterator(const Iterator & other)
+        {
+            *this = other;
+        }
+
+        /*!
+         * Throws std::runtime_error if hazard pointers can not be allocated.
+         *
+         * - Progress: Wait-free.
+         * - Time complexity: O(1) if hazard pointers are cached by this thread, otherwise O(H).
+         */
+        Iterator & operator=(const Iterator & other)
+        {
+            if (this == &other)
+                return *this;
+
+            map = other.map;
+
+            // The node is still protected by 'other'.
+            set_current(other.current);
+
+            return *this;
+        }
+
+        ~Iterator()
+        {
+            if (hp0)
+            {
+                hp0->release();
+                hp1->release();
+            }
+        }
+
+        bool operator==(const Iterator & other) const
+        {
+            return current == other.current;
+        }
+
+        bool operator!=(const Iterator & other) const
+        {
+            return !(*this == other);
+        }
+
+        bool operator==(const Sentinel &) const
+        {
+            return current == nullptr;
+        }
+
+        bool operator!=(const Sentinel &) const
+        {
+            return current != nullptr;
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        Entry & operator*()
+        {
+            return static_cast<Data_Node*>(current)->entry;
+        }
+
+        Entry * operator->()
+        {
+            return &static_cast<Data_Node*>(current)->entry;
+        }
+
+        /*!
+         * Throws std::runtime_error if hazard pointers can not be allocated.
+         *
+         * - Progress: Lock-free.
+         * - Time complexity: O(1) if the current element was not removed,
+         *   otherwise expected O(log N).
+         */
+        Iterator & operator++()
+        {
+            for(;;)
+            {
+                Node * next = current->next[0];
+
+                if (is_marked(next))
+                {
+                    // The current element was removed.
+                    // Find the next greater key from the top.
+                    Guard guard;
+                    set_current(map->find(key_of(current), true, true, 0, nullptr, nullptr, guard));
+                    break;
+                }
+
+                if (!next)
+                {
+                    current = nullptr;
+                    break;
+                }
+
+                if (!hp0)
+                    acquire();
+
+                hp1->pointer = next;
+
+                if (current->next[0] == next)
+                {
+                    current = next;
+                    std::swap(hp0, hp1);
+                    break;
+                }
+            }
+
+            return *this;
+        }
+
+    private:
+        friend class Skip_List_Map;
+
+        Iterator(Skip_List_Map * map, Node * current): map(map)
+        {
+            set_current(current);
+        }
+
+        void acquire()
+        {
+            hp0 = &Detail::Hazard_Pointers::acquire<Node>();
+            try { hp1 = &Detail::Hazard_Pointers::acquire<Node>(); }
+            catch (...) { hp0->release(); hp0 = nullptr; throw; }
+        }
+
+        // The node must be protected by the caller.
+        void set_current(Node * node)
+        {
+            current = node;
+
+            if (current && current != &map->d_head)
+            {
+                if (!hp0)
+                    acquire();
+                hp0->pointer = current;
+            }
+        }
+
+        Skip_List_Map * map = nullptr;
+        // The head, an element protected by hp0, or null at the end.
+        Node * current = nullptr;
+        Hazard_Pointer * hp0 = nullptr;
+        Hazard_Pointer * hp1 = nullptr;
+    };
+
+    /*!
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free.
+     * - Time complexity: O(1).
+     */
+    Iterator begin()
+    {
+        Iterator it(this, &d_head);
+        ++it;
+        return it;
+    }
+
+    /*!
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    Sentinel end()
+    {
+        return Sentinel();
+    }
+
+    /*!
+     * \brief Returns an iterator at the first element with key not less than `key`.
+     *
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free.
+     * - Time complexity: Expected O(log N). Worst-case O(N + H).
+     */
+    Iterator lower_bound(const K & key)
+    {
+        Guard guard;
+        return Iterator(this, find(key, true, false, 0, nullptr, nullptr, guard));
+    }
+
+    /*!
+     * \brief Returns an iterator at the first element with key greater than `key`.
+     *
+     * Throws std::runtime_error if hazard pointers can not be allocated.
+     *
+     * - Progress: Lock-free.
+     * - Time complexity: Expected O(log N). Worst-case O(N + H).
+     */
+    Iterator upper_bound(const K & key)
+    {
+        Guard guard;
+        return Iterator(this, find(key, true, true, 0, nullptr, nullptr, guard));
+    }
+
+private:
+    // Searches for the position of 'key' at all levels.
+    // If 'after' is false, the position is before the first node with key not less than 'key',
+    // otherwise before the first node with key greater than 'key'.
+    // If 'any' is true, returns the node after the position, otherwise
+    // returns it only if its key equals 'key'. The node is protected by the guard.
+    // At levels below 'keep', the nodes before and after the position are stored in
+    // 'preds' and 'succs' and protected by the guard.
+    // Marked nodes encountered on the way are unlinked.
+    Node * find(const K & key, bool any, bool after, int keep,
+                Node ** preds, Node ** succs, Guard & guard)
+    {
+        Hazard_Pointer * hp_pred = &guard.slot(0);
+        Hazard_Pointer * hp_curr = &guard.slot(1);
+
+        restart:
+
+        Node * pred = &d_head;
+        Node * curr = nullptr;
+
+        for (int level = d_levels.load() - 1; level >= 0; --level)
+        {
+            curr = pred->next[level];
+
+            for(;;)
+            {
+                // The predecessor was removed.
+                if (is_marked(curr))
+                    goto restart;
+
+                if (!curr)
+                    break;
+
+                hp_curr->pointer = curr;
+
+                // Make sure curr was not removed before it was protected.
+                if (pred->next[level] != curr)
+                    goto restart;
+
+                Node * succ = curr->next[level];
+
+                if (is_marked(succ))
+                {
+                    succ = unmarked(succ);
+
+                    Node * expected = curr;
+                    if (!pred->next[level].compare_exchange_strong(expected, succ))
+                        goto restart;
+
+                    // The node is reclaimed by its inserting or removing thread.
+                    curr = succ;
+                    continue;
+                }
+
+                bool before = after ? !d_less(key, key_of(curr)) : d_less(key_of(curr), key);
+                if (!before)
+                    break;
+
+                pred = curr;
+                std::swap(hp_pred, hp_curr);
+                curr = succ;
+            }
+
+            if (level < keep)
+            {
+                guard.slot(2 + 2 * level).pointer = pred;
+                guard.slot(3 + 2 * level).pointer = curr;
+                preds[level] = pred;
+                succs[level] = curr;
+            }
+        }
+
+        if (!curr || any)
+            return curr;
+
+        if (d_less(key, key_of(curr)))
+            return nullptr;
+
+        return curr;
+    }
+
+    // Links the node at levels above 0, unless it is removed in the meantime.
+    void link_upper_levels(Data_Node * node, Node ** preds, Node ** succs, Guard & guard)
+    {
+        const K & key = node->entry.first;
+
+        for (int i = 1; i < node->level; ++i)
+        {
+            for(;;)
+            {
+                Node * succ = node->next[i];
+
+                if (is_marked(succ))
+                    return;
+
+                if (succ != succs[i] && !node->next[i].compare_exchange_strong(succ, succs[i]))
+                    return; // Marked in the meantime
+
+                if (preds[i]->next[i].compare_exchange_strong(succs[i], node))
+                    break;
+
+                find(key, false, false, node->level, preds, succs, guard);
+
+                if (is_marked(node->next[0]))
+                    return;
+            }
+        }
+    }
+
+    // Marks the link as removed. Returns false if it was already marked.
+    static bool mark(atomic<Node*> & link)
+    {
+        Node * next = link;
+
+        while (!is_marked(next))
+        {
+            if (link.compare_exchange_weak(next, marked(next)))
+                return true;
+        }
+
+        return false;
+    }
+
+    // Called by the inserting and removing thread when they are done with the node.
+    static void release(Data_Node * node)
+    {
+        if (node->users.fetch_sub(1) == 1)
+            Detail::Hazard_Pointers::reclaim(node);
+    }
+
+    static int random_level()
+    {
+        thread_local uint64_t state = uint64_t(uintptr_t(&state)) | 1;
+
+        // xorshift64
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        // Each level with probability 1/2 of the previous one.
+        int level = 1 + __builtin_ctzll(state | (uint64_t(1) << (Max_Level - 1)));
+        return level;
+    }
+
+    Compare d_less;
+
+    Node d_head { Max_Level };
+
+    // Number of levels in use
+    atomic<int> d_levels { 1 };
+
+    atomic<int64_t> d_size { 0 };
+};
+
+}
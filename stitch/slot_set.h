@@ -0,0 +1,961 @@
+#pragma once
+
+#include "hazard_pointers.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace Stitch {
+
+using std::atomic;
+using std::vector;
+
+/*! \brief Identifies an element inserted into a \ref Slot_Set.
+
+  A default-constructed handle identifies no element.
+ */
+struct Slot_Handle
+{
+    void * slot = nullptr;
+    uint64_t generation = 0;
+};
+
+/*! \brief Unordered set of items stored in preallocated slots.
+ *
+ * Insertion returns a \ref Slot_Handle which removes the element
+ * in constant time, without searching for it.
+ *
+ * Elements are stored in blocks of slots which are never moved
+ * or deallocated before the set is destroyed. Inserting takes a free slot
+ * and only allocates a new block if there is none, so after reserving
+ * enough slots using \ref reserve, insertion does not allocate memory.
+ *
+ * Changes are published in versions: Each slot records the versions
+ * in which its element was inserted and removed, and an iterator
+ * visits the elements present in the version published when iteration started.
+ * Any number of insertions and removals can be made using an \ref Update,
+ * and they are published at once as a single version,
+ * so an iterator either observes all of them or none.
+ * Concurrent updates are published one after another by a compare-and-swap
+ * of the current version, so both modifying and iterating the set are lock-free.
+ * A removed element is destroyed and its slot reused once no iterator
+ * uses an earlier version, which is tracked using hazard pointers.
+ *
+ * Unlike \ref Set, inserting does not check whether an equal element
+ * is already in the set.
+ *
+ * Iteration visits all slots, so it takes time proportional to
+ * the number of slots ever allocated, rather than to the number of elements.
+ *
+ * Progress guarantees in method descriptions use the following parameters:
+ * - N = Number of elements currently in the set.
+ * - S = Number of slots (used and free).
+ * - R = Number of removed elements still used by iterators.
+ * - E = Number of version records, at most the largest number
+ *   of concurrent updates and iterators, plus 2.
+ * - H = Maximum allowable number of hazard pointers.
+ */
+
+template <typename T>
+class Slot_Set
+{
+private:
+    // A slot's state consists of a generation, incremented on every insertion,
+    // and a status in the lowest two bits.
+    enum Status : uint64_t
+    {
+        Free = 0,
+        Used = 1,
+        Removed = 2
+    };
+
+    static constexpr uint64_t Status_Mask = 3;
+    static constexpr uint64_t Never = std::numeric_limits<uint64_t>::max();
+    // Set in the version of an epoch until it is known to be published.
+    static constexpr uint64_t Pending = uint64_t(1) << 63;
+
+    struct Epoch;
+
+    struct Slot
+    {
+        atomic<uint64_t> state { Free };
+        // Versions in which the element was inserted and removed.
+        // Until the update making the change is complete,
+        // the slot refers to the update's epoch instead.
+        atomic<uint64_t> added { Never };
+        atomic<uint64_t> removed { Never };
+        atomic<Epoch*> added_by { nullptr };
+        atomic<Epoch*> removed_by { nullptr };
+        // Next slot in the free list or the list of removed slots
+        atomic<Slot*> next { nullptr };
+        // Next slot inserted or removed by the same update
+        Slot * next_added = nullptr;
+        Slot * next_removed = nullptr;
+        std::optional<T> value;
+    };
+
+    struct Block
+    {
+        Block(int size): slots(size) {}
+        vector<Slot> slots;
+        Block * next = nullptr;
+    };
+
+    // A version, published by an update. Iterators protect the epoch they use.
+    // Once an epoch is not current, not protected, and no slot refers to it,
+    // it is reused by another update.
+    struct Epoch
+    {
+        atomic<uint64_t> version { 0 };
+        // Whether an update uses the epoch
+        atomic<bool> owned { false };
+        // Epochs are only added, following the two embedded in the set.
+        atomic<Epoch*> next { nullptr };
+    };
+
+    // The current epoch and its version, replaced together,
+    // so a writer can not replace a reused epoch by mistake.
+    struct Current
+    {
+        Epoch * epoch = nullptr;
+        uint64_t version = 0;
+
+        bool operator==(const Current &) const = default;
+    };
+
+    struct Head
+    {
+        uintptr_t version = 0;
+        Slot * first = nullptr;
+    };
+
+    using Hazard_Pointer = Detail::Hazard_Pointer<Epoch>;
+
+    static constexpr int Min_Block_Size = 4;
+
+public:
+    /*!
+     * \brief Collects insertions and removals, to be published as a single version.
+     *
+     * The changes are not visible to iterators until \ref publish is called,
+     * or the update is destroyed.
+     *
+     * Different threads may update the same set concurrently,
+     * but an Update can only be used safely from one thread.
+     */
+    class Update
+    {
+        friend class Slot_Set;
+
+    public:
+        /*!
+         * \brief Starts an update of the given set.
+         *
+         * - Progress: Lock-free
+         * - Time complexity: O(E * H)
+         */
+
+        Update(Slot_Set & set):
+            d_set(set),
+            d_epoch(set.claim_epoch())
+        {}
+
+        /*!
+         * \brief Publishes the changes, unless already published.
+         *
+         * - Progress: Lock-free
+         * - Time complexity: Same as \ref publish.
+         */
+
+        ~Update()
+        {
+            publish();
+        }
+
+        Update(const Update &) = delete;
+        Update & operator=(const Update &) = delete;
+
+        /*!
+         * \brief Inserts the given value and returns its handle.
+         *
+         * Allocates a block of slots if no slot is free.
+         *
+         * - Progress: Lock-free if a slot is free. Blocking otherwise.
+         * - Time complexity: O(1) if a slot is free.
+         */
+
+        Slot_Handle insert(const T & value)
+        {
+            Slot * slot = d_set.allocate();
+            slot->value.emplace(value);
+            return add(slot);
+        }
+
+        /*!
+         * \brief Inserts the given value by moving it and returns its handle.
+         *
+         * - Progress: Lock-free if a slot is free. Blocking otherwise.
+         * - Time complexity: O(1) if a slot is free.
+         */
+
+        Slot_Handle insert(T && value)
+        {
+            Slot * slot = d_set.allocate();
+            slot->value.emplace(std::move(value));
+            return add(slot);
+        }
+
+        /*!
+         * \brief Removes the element identified by the handle.
+         *
+         * Returns false if the element was already removed, by this or another update.
+         * Otherwise, the element can still be accessed using \ref Slot_Set::get
+         * until the update is published.
+         *
+         * - Progress: Wait-free
+         * - Time complexity: O(1)
+         */
+
+        bool remove(const Slot_Handle & handle)
+        {
+            auto slot = (Slot*) handle.slot;
+            if (!slot)
+                return false;
+
+            uint64_t expected = handle.generation << 2 | Used;
+            if (!slot->state.compare_exchange_strong(expected, handle.generation << 2 | Removed))
+                return false;
+
+            slot->removed_by.store(d_epoch);
+
+            slot->next_removed = d_removed;
+            d_removed = slot;
+
+            --d_size_change;
+
+            return true;
+        }
+
+        /*!
+         * \brief Publishes all changes made so far as a single version.
+         *
+         * The update can not be used afterwards.
+         *
+         * - Progress: Lock-free
+         * - Time complexity: O(C + R + E * H) where C is the number of changes.
+         */
+
+        void publish()
+        {
+            if (!d_epoch)
+                return;
+
+            if (d_added || d_removed)
+                d_set.commit(*this);
+            else
+                d_epoch->owned.store(false);
+
+            d_epoch = nullptr;
+        }
+
+    private:
+        Slot_Handle add(Slot * slot)
+        {
+            uint64_t generation = (slot->state.load(std::memory_order_relaxed) >> 2) + 1;
+
+            slot->added.store(Never, std::memory_order_relaxed);
+            slot->removed.store(Never, std::memory_order_relaxed);
+            slot->added_by.store(d_epoch, std::memory_order_relaxed);
+            slot->removed_by.store(nullptr, std::memory_order_relaxed);
+            slot->state.store(generation << 2 | Used, std::memory_order_release);
+
+            slot->next_added = d_added;
+            d_added = slot;
+
+            ++d_size_change;
+
+            return { slot, generation };
+        }
+
+        Slot_Set & d_set;
+        Epoch * d_epoch;
+        Slot * d_added = nullptr;
+        Slot * d_removed = nullptr;
+        int d_size_change = 0;
+    };
+
+    /*!
+     * \brief Default constructor. Does not allocate any slots.
+     *
+     * - Progress: Wait-free
+     * - Time complexity: O(1)
+     */
+
+    Slot_Set()
+    {
+        d_epochs[0].next = &d_epochs[1];
+    }
+
+    /*!
+     * \brief Destructor.
+     *
+     * - Progress: Blocking
+     * - Time complexity: O(S)
+     */
+
+    ~Slot_Set()
+    {
+        Block * block = d_blocks.load();
+        while (block)
+        {
+            Block * next = block->next;
+            delete block;
+            block = next;
+        }
+
+        Epoch * epoch = d_epochs[1].next.load();
+        while (epoch)
+        {
+            Epoch * next = epoch->next.load();
+            delete epoch;
+            epoch = next;
+        }
+    }
+
+    Slot_Set(const Slot_Set &) = delete;
+    Slot_Set & operator=(const Slot_Set &) = delete;
+
+    /*!
+     * \brief Allocates slots so that at least `count` elements can be stored without further allocation.
+     *
+     * - Progress: Blocking
+     * - Time complexity: O(count)
+     */
+
+    void reserve(int count)
+    {
+        int missing = count - d_capacity.load();
+        if (missing > 0)
+            add_block(missing);
+    }
+
+    /*!
+     * \brief Returns the number of allocated slots.
+     *
+     * - Progress: Wait-free
+     * - Time complexity: O(1)
+     */
+
+    int capacity() const
+    {
+        return d_capacity.load();
+    }
+
+    /*!
+     * \brief Returns the number of elements in the last published version.
+     *
+     * - Progress: Wait-free
+     * - Time complexity: O(1)
+     */
+
+    int size() const
+    {
+        return d_size.load();
+    }
+
+    /*!
+     * \brief Returns whether the set contains no elements.
+     *
+     * - Progress: Wait-free
+     * - Time complexity: O(1)
+     */
+
+    bool empty() const
+    {
+        return d_size.load() == 0;
+    }
+
+    /*!
+     * \brief Calls `fn` with an \ref Update, and publishes all changes made using it as a single version.
+     *
+     * Iterators never observe only some of the changes.
+     *
+     * If `fn` throws, the changes made so far are published before the exception is propagated.
+     *
+     * - Progress: Lock-free if `fn` is.
+     * - Time complexity: O(time of fn + R + E * H).
+     */
+
+    template <typename F>
+    void update(F && fn)
+    {
+        Update update(*this);
+        fn(update);
+        update.publish();
+    }
+
+    /*!
+     * \brief Inserts the given value and returns its handle.
+     *
+     * The element is published as a new version.
+     *
+     * - Progress: Lock-free if a slot is free. Blocking otherwise.
+     * - Time complexity: Asymptotic O(1). Worst-case O(R + E * H) if a slot is free.
+     */
+
+    Slot_Handle insert(const T & value)
+    {
+        Update update(*this);
+        return update.insert(value);
+    }
+
+    /*!
+     * \brief Inserts the given value by moving it and returns its handle.
+     *
+     * - Progress: Lock-free if a slot is free. Blocking otherwise.
+     * - Time complexity: Asymptotic O(1). Worst-case O(R + E * H) if a slot is free.
+     */
+
+    Slot_Handle insert(T && value)
+    {
+        Update update(*this);
+        return update.insert(std::move(value));
+    }
+
+    /*!
+     * \brief Removes the element identified by the handle.
+     *
+     * Returns false if the element was already removed.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: O(R + E * H)
+     */
+
+    bool remove(const Slot_Handle & handle)
+    {
+        Update update(*this);
+        return update.remove(handle);
+    }
+
+    /*!
+     * \brief Removes an element equal to the given value, if any.
+     *
+     * Element type T must support equality comparison (operator '==').
+     *
+     * Returns whether an element was removed.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: O(S + R + E * H)
+     */
+
+    bool remove(const T & value)
+    {
+        Update update(*this);
+
+        for (auto it = begin(); it != end(); ++it)
+        {
+            if (*it == value && update.remove(it.handle()))
+                return true;
+        }
+
+        return false;
+    }
+
+    /*!
+     * \brief Removes all elements, as a single version.
+     *
+     * Elements inserted concurrently may remain.
+     *
+     * - Progress: Lock-free
+     * - Time complexity: O(S + R + E * H)
+     */
+
+    void clear()
+    {
+        Update update(*this);
+
+        for (auto it = begin(); it != end(); ++it)
+            update.remove(it.handle());
+    }
+
+    /*!
+     * \brief Returns the element identified by the handle.
+     *
+     * The element must not be removed concurrently.
+     *
+     * - Progress: Wait-free
+     * - Time complexity: O(1)
+     */
+
+    T & get(const Slot_Handle & handle)
+    {
+        return *((Slot*) handle.slot)->value;
+    }
+
+    /*!
+     * \brief Marks the end of iteration.
+     */
+    struct Sentinel {};
+
+    /*!
+     * \brief Iterates over elements in the order of slots.
+     *
+     * Visits the elements of the version published when iteration started,
+     * regardless of changes published during iteration.
+     *
+     * The iterator uses a hazard pointer only until it reaches the end,
+     * and iterating an empty set uses none.
+     */
+    struct Iterator
+    {
+        Iterator() {}
+
+        /*!
+         * Throws std::runtime_error if a hazard pointer can not be allocated.
+         *
+         * - Progress: Wait-free.
+         * - Time complexity: O(1) if hazard pointers are cached by this thread, otherwise O(H).
+         */
+        Iterator(const Iterator & other)
+        {
+            *this = other;
+        }
+
+        /*!
+         * Takes over the hazard pointer of `other`.
+         *
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        Iterator(Iterator && other):
+            block(other.block),
+            index(other.index),
+            current(other.current),
+            generation(other.generation),
+            version(other.version),
+            hp(other.hp)
+        {
+            other.current = nullptr;
+            other.hp = nullptr;
+        }
+
+        /*!
+         * Throws std::runtime_error if a hazard pointer can not be allocated.
+         *
+         * - Progress: Wait-free.
+         * - Time complexity: O(1) if hazard pointers are cached by this thread, otherwise O(H).
+         */
+        Iterator & operator=(const Iterator & other)
+        {
+            if (this == &other)
+                return *this;
+
+            block = other.block;
+            index = other.index;
+            current = other.current;
+            generation = other.generation;
+            version = other.version;
+
+            // The epoch is still protected by 'other'.
+            if (current)
+            {
+                if (!hp)
+                    hp = &Detail::Hazard_Pointers::acquire<Epoch>();
+                hp->pointer = other.hp->pointer.load();
+            }
+
+            return *this;
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        ~Iterator()
+        {
+            if (hp)
+                hp->release();
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        bool operator==(const Sentinel &) const
+        {
+            return current == nullptr;
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        bool operator!=(const Sentinel &) const
+        {
+            return current != nullptr;
+        }
+
+        /*!
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        T & operator*()
+        {
+            return *current->value;
+        }
+
+        /*!
+         * \brief Returns the handle of the current element.
+         *
+         * - Progress: Wait-free.
+         * - Time complexity: O(1).
+         */
+        Slot_Handle handle() const
+        {
+            return { current, generation };
+        }
+
+        /*!
+         * - Progress: Lock-free.
+         * - Time complexity: O(S).
+         */
+        Iterator & operator++()
+        {
+            current = nullptr;
+
+            while (block)
+            {
+                while (index < (int) block->slots.size())
+                {
+                    Slot * slot = &block->slots[index];
+
+                    uint64_t state = slot->state.load();
+                    if ((state & Status_Mask) == Free)
+                    {
+                        ++index;
+                        continue;
+                    }
+
+                    uint64_t added = resolve(slot->added_by, slot->added);
+                    uint64_t removed = resolve(slot->removed_by, slot->removed);
+
+                    // The versions belong to another element if the slot was reused meanwhile.
+                    if (slot->state.load() != state)
+                        continue;
+
+                    ++index;
+
+                    // An element which is present in our version
+                    // is not destroyed while our epoch is protected.
+                    if (added <= version && version < removed)
+                    {
+                        current = slot;
+                        generation = state >> 2;
+                        return *this;
+                    }
+                }
+
+                block = block->next;
+                index = 0;
+            }
+
+            if (hp)
+                hp->pointer = nullptr;
+
+            return *this;
+        }
+
+    private:
+        friend class Slot_Set;
+
+        Block * block = nullptr;
+        int index = 0;
+        Slot * current = nullptr;
+        uint64_t generation = 0;
+        uint64_t version = 0;
+        Hazard_Pointer * hp = nullptr;
+    };
+
+    /*!
+     * Throws std::runtime_error if a hazard pointer can not be allocated.
+     *
+     * - Progress: Lock-free.
+     * - Time complexity: O(S).
+     */
+    Iterator begin()
+    {
+        Iterator it;
+
+        if (d_size.load() == 0)
+            return it;
+
+        it.hp = &Detail::Hazard_Pointers::acquire<Epoch>();
+
+        Current current = d_current.load();
+        for(;;)
+        {
+            it.hp->pointer = current.epoch;
+            Current again = d_current.load();
+            if (again == current)
+                break;
+            current = again;
+        }
+
+        confirm(current);
+
+        it.version = current.version;
+        it.block = d_blocks.load();
+
+        ++it;
+        return it;
+    }
+
+    /*!
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    Sentinel end()
+    {
+        return Sentinel();
+    }
+
+private:
+    // Marks an epoch which was published with the given version as such.
+    // This is done before the version of a current epoch is used,
+    // so a pending epoch is newer than any version in use.
+    // Has no effect if the epoch was already marked, or reused since,
+    // because a reused epoch is pending with a newer version.
+    static void confirm(const Current & current)
+    {
+        uint64_t version = current.version | Pending;
+        current.epoch->version.compare_exchange_strong(version, current.version);
+    }
+
+    // Returns the version in which a slot's element was inserted or removed,
+    // or Never if that is not published yet.
+    static uint64_t resolve(const atomic<Epoch*> & by, const atomic<uint64_t> & number)
+    {
+        for(;;)
+        {
+            Epoch * epoch = by.load();
+            if (!epoch)
+                return number.load();
+
+            uint64_t version = epoch->version.load();
+
+            // The update may have completed and its epoch been reused meanwhile.
+            if (by.load() != epoch)
+                continue;
+
+            return (version & Pending) ? Never : version;
+        }
+    }
+
+    // Returns an unused epoch for a new update, marked as pending.
+    Epoch * claim_epoch()
+    {
+        for (Epoch * epoch = &d_epochs[0]; epoch; epoch = epoch->next.load())
+        {
+            if (epoch->owned.load() || epoch->owned.exchange(true))
+                continue;
+
+            // Once owned, the epoch does not become current again
+            // until published by the owner, so iterators which protect it
+            // from now on do not use it.
+            if (epoch != d_current.load().epoch && !Detail::Hazard_Pointers::is_protected(epoch))
+            {
+                epoch->version.store(Pending);
+                return epoch;
+            }
+
+            epoch->owned.store(false);
+        }
+
+        auto epoch = new Epoch;
+        epoch->version = Pending;
+        epoch->owned = true;
+
+        Epoch * first = d_epochs[1].next.load();
+        do { epoch->next = first; }
+        while (!d_epochs[1].next.compare_exchange_weak(first, epoch));
+
+        return epoch;
+    }
+
+    // Makes the changes of the update visible to iterators as a new version.
+    void commit(Update & update)
+    {
+        Epoch * epoch = update.d_epoch;
+
+        Current current = d_current.load();
+        Current next;
+
+        // The epoch is stamped with the version following
+        // the current one, and then replaces it.
+        for(;;)
+        {
+            confirm(current);
+
+            next = { epoch, current.version + 1 };
+            epoch->version.store(next.version | Pending);
+
+            if (d_current.compare_exchange_weak(current, next))
+                break;
+        }
+
+        confirm(next);
+
+        uint64_t version = next.version;
+
+        // Let the slots refer to the version instead of the epoch,
+        // so the epoch can be reused.
+
+        for (Slot * slot = update.d_added; slot; slot = slot->next_added)
+        {
+            slot->added.store(version);
+            slot->added_by.store(nullptr);
+        }
+
+        for (Slot * slot = update.d_removed; slot; )
+        {
+            Slot * next = slot->next_removed;
+
+            slot->removed.store(version);
+            slot->removed_by.store(nullptr);
+            push(d_removed, slot);
+
+            slot = next;
+        }
+
+        d_size += update.d_size_change;
+
+        epoch->owned.store(false);
+
+        release_removed();
+    }
+
+    Slot * allocate()
+    {
+        for(;;)
+        {
+            Slot * slot = pop(d_free);
+            if (slot)
+                return slot;
+
+            // Slots of removed elements may have become free.
+            release_removed();
+
+            slot = pop(d_free);
+            if (slot)
+                return slot;
+
+            add_block(std::max(Min_Block_Size, d_capacity.load()));
+        }
+    }
+
+    void add_block(int size)
+    {
+        auto block = new Block(size);
+
+        // Blocks are only added, so pushing does not suffer from the ABA problem.
+        Block * first = d_blocks.load();
+        do { block->next = first; }
+        while (!d_blocks.compare_exchange_weak(first, block));
+
+        d_capacity += size;
+
+        for (auto & slot : block->slots)
+            push(d_free, &slot);
+    }
+
+    // Destroys removed elements which are not present in a version used by any iterator,
+    // and makes their slots free.
+    void release_removed()
+    {
+        // Removed slots are only taken all at once, so pushing
+        // to this list does not suffer from the ABA problem.
+        Slot * slot = d_removed.exchange(nullptr);
+        if (!slot)
+            return;
+
+        // The taken slots were removed in the current version or earlier,
+        // so iterators using the current version do not visit them.
+        Epoch * current = d_current.load().epoch;
+
+        // The oldest version used by iterators, other than the current one.
+        uint64_t oldest = Never;
+
+        for (Epoch * epoch = &d_epochs[0]; epoch; epoch = epoch->next.load())
+        {
+            if (epoch != current && Detail::Hazard_Pointers::is_protected(epoch))
+                oldest = std::min(oldest, epoch->version.load() & ~Pending);
+        }
+
+        while (slot)
+        {
+            Slot * next = slot->next.load(std::memory_order_relaxed);
+
+            // An element removed before the update inserting it was complete
+            // is kept until that update refers to its version.
+            if (slot->removed.load() > oldest || slot->added_by.load())
+            {
+                push(d_removed, slot);
+            }
+            else
+            {
+                slot->value.reset();
+                slot->state.store(slot->state.load(std::memory_order_relaxed) & ~Status_Mask);
+                push(d_free, slot);
+            }
+
+            slot = next;
+        }
+    }
+
+    static void push(atomic<Slot*> & list, Slot * slot)
+    {
+        Slot * first = list.load();
+        do { slot->next.store(first, std::memory_order_relaxed); }
+        while (!list.compare_exchange_weak(first, slot));
+    }
+
+    static void push(atomic<Head> & list, Slot * slot)
+    {
+        for(;;)
+        {
+            auto head = list.load();
+            slot->next.store(head.first, std::memory_order_relaxed);
+            Head new_head { head.version + 1, slot };
+            if(list.compare_exchange_weak(head, new_head))
+                break;
+        }
+    }
+
+    static Slot * pop(atomic<Head> & list)
+    {
+        for (;;)
+        {
+            auto head = list.load();
+            if (!head.first)
+                return nullptr;
+            Head new_head { head.version + 1, head.first->next.load(std::memory_order_relaxed) };
+            if(list.compare_exchange_weak(head, new_head))
+                return head.first;
+        }
+    }
+
+    atomic<Block*> d_blocks { nullptr };
+    Epoch d_epochs[2];
+    atomic<Current> d_current { Current { &d_epochs[0], 0 } };
+    atomic<Head> d_free;
+    atomic<Slot*> d_removed { nullptr };
+    atomic<int> d_capacity { 0 };
+    atomic<int> d_size { 0 };
+};
+
+}
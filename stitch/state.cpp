@@ -0,0 +1,142 @@
+#include "state.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace Stitch {
+namespace Detail {
+
+static int64_t steady_time()
+{
+    auto t = chrono::steady_clock::now().time_since_epoch();
+    return chrono::duration_cast<chrono::nanoseconds>(t).count();
+}
+
+void State_Notification::notify_throttled()
+{
+    if (scheduled_time.load() != 0)
+        return;
+
+    int64_t now = steady_time();
+    int64_t time = max(now + delay.load(), last_notified.load() + min_interval.load());
+
+    if (time <= now)
+    {
+        fire();
+        return;
+    }
+
+    // The scheduler was started when this was throttled.
+    int64_t expected = 0;
+    if (scheduled_time.compare_exchange_strong(expected, time))
+        State_Notification_Scheduler::instance().wake();
+}
+
+void State_Notification::throttle(int64_t min_interval, int64_t delay)
+{
+    bool enabled = min_interval > 0 || delay > 0;
+
+    if (enabled && !registered.exchange(true))
+        State_Notification_Scheduler::instance().add(weak_from_this());
+
+    this->min_interval = min_interval;
+    this->delay = delay;
+    throttled = enabled;
+}
+
+void State_Notification::fire()
+{
+    last_notified = steady_time();
+    scheduled_time = 0;
+
+    // Order before checking the flag, so a value stored
+    // while the notification was scheduled is not missed.
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (!pending.exchange(true))
+        signal.notify();
+}
+
+State_Notification_Scheduler & State_Notification_Scheduler::instance()
+{
+    static State_Notification_Scheduler scheduler;
+    return scheduler;
+}
+
+State_Notification_Scheduler::State_Notification_Scheduler():
+    d_thread(&State_Notification_Scheduler::run, this)
+{}
+
+State_Notification_Scheduler::~State_Notification_Scheduler()
+{
+    {
+        lock_guard<mutex> lock(d_mutex);
+        d_quit = true;
+    }
+
+    d_wake.notify();
+    d_thread.join();
+}
+
+void State_Notification_Scheduler::add(weak_ptr<State_Notification> target)
+{
+    lock_guard<mutex> lock(d_mutex);
+    d_targets.push_back(std::move(target));
+}
+
+void State_Notification_Scheduler::run()
+{
+    vector<shared_ptr<State_Notification>> due;
+
+    for(;;)
+    {
+        {
+            lock_guard<mutex> lock(d_mutex);
+
+            if (d_quit)
+                return;
+
+            // Forget destroyed targets.
+            std::erase_if(d_targets, [](auto & target){ return target.expired(); });
+
+            int64_t now = steady_time();
+            int64_t earliest = 0;
+
+            for (auto & weak_target : d_targets)
+            {
+                auto target = weak_target.lock();
+                if (!target)
+                    continue;
+
+                int64_t time = target->scheduled_time.load();
+                if (time == 0)
+                    continue;
+
+                if (time <= now)
+                    due.push_back(std::move(target));
+                else if (earliest == 0 || time < earliest)
+                    earliest = time;
+            }
+
+            if (earliest == 0)
+                d_timer.stop();
+            else
+                d_timer.start(chrono::nanoseconds(earliest - now));
+        }
+
+        for (auto & target : due)
+            target->fire();
+
+        if (!due.empty())
+        {
+            due.clear();
+            continue;
+        }
+
+        wait({ d_timer.event(), d_wake.event() });
+    }
+}
+
+}
+}
@@ -2,14 +2,46 @@
 
 #include "../stitch/atom.h"
 #include "../stitch/signal.h"
+#include "../stitch/timer.h"
+#include "../stitch/lockfree_set.h"
+#include "../stitch/array_set.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 namespace Stitch {
 
+using std::atomic;
 using std::weak_ptr;
 using std::shared_ptr;
 
+/*!
+ * \brief Selects the set type used by a \ref State of type T to store its observers.
+ *
+ * By default, observers are stored in a \ref Set.
+ * Since observers are iterated on every \ref State::store, but rarely change,
+ * the \ref Array_Set can be selected by specializing this template:
+ *
+ *     template <>
+ *     struct Stitch::State_Traits<My_Value>
+ *     {
+ *         template <typename E> using Observer_Set = Stitch::Array_Set<E>;
+ *     };
+ *
+ * The specialization must be visible wherever States or State_Observers of type T are used.
+ */
+template <typename T>
+struct State_Traits
+{
+    template <typename E> using Observer_Set = Stitch::Set<E>;
+};
+
 namespace Detail {
 
 template <typename T> struct State_Data;
@@ -20,14 +52,98 @@ struct State_Data
 {
     State_Data() {}
     State_Data(T value): atom(value) {}
+    State_Data(T value, int history): atom(value) { atom.keep_history(history); }
 
     Atom<T> atom;
-    Set<shared_ptr<State_Observer_Data<T>>> observers;
+    typename State_Traits<T>::template Observer_Set<shared_ptr<State_Observer_Data<T>>> observers;
 };
 
-template <typename T> struct State_Observer_Data
+// Notification of an observer, independent of the value type.
+struct State_Notification : std::enable_shared_from_this<State_Notification>
 {
+    // Notifies the observer, unless a previous notification was not consumed yet.
+    // If throttled, the notification may be scheduled for later.
+    void notify()
+    {
+        if (pending.load(std::memory_order_relaxed))
+            return;
+
+        if (!throttled.load(std::memory_order_relaxed))
+        {
+            if (!pending.exchange(true))
+                signal.notify();
+            return;
+        }
+
+        notify_throttled();
+    }
+
+    void notify_throttled();
+
+    // Sets throttling parameters, and registers with the scheduler when first throttled.
+    void throttle(int64_t min_interval, int64_t delay);
+
+    // Notifies the observer now. Called by the scheduler at the scheduled time.
+    void fire();
+
+    // Called when the observer consumes the notification.
+    void consume()
+    {
+        pending.store(false);
+        // Order before loading the value, so a value stored after
+        // the flag was observed as set is not missed.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
     Signal signal;
+    atomic<bool> pending { false };
+
+    // Throttling parameters in nanoseconds
+    atomic<bool> throttled { false };
+    atomic<int64_t> min_interval { 0 };
+    atomic<int64_t> delay { 0 };
+
+    // Whether this is registered with the scheduler
+    atomic<bool> registered { false };
+    // Time of the scheduled notification, in nanoseconds of std::chrono::steady_clock,
+    // or zero if none is scheduled
+    atomic<int64_t> scheduled_time { 0 };
+    // Time of last notification, in nanoseconds of std::chrono::steady_clock
+    atomic<int64_t> last_notified { INT64_MIN / 2 };
+};
+
+// Activates scheduled notifications of throttled observers.
+// A single background thread and timer serves all observers.
+// Writers only set the scheduled time of a notification and wake the thread,
+// so scheduling does not block, allocate or start the thread.
+class State_Notification_Scheduler
+{
+public:
+    static State_Notification_Scheduler & instance();
+
+    State_Notification_Scheduler();
+    ~State_Notification_Scheduler();
+
+    // Lets the scheduler fire the target at its scheduled time,
+    // until the target is destroyed.
+    void add(std::weak_ptr<State_Notification> target);
+
+    // Lets the thread find newly scheduled notifications.
+    void wake() { d_wake.notify(); }
+
+private:
+    void run();
+
+    std::mutex d_mutex;
+    std::vector<std::weak_ptr<State_Notification>> d_targets;
+    bool d_quit = false;
+    Timer d_timer;
+    Signal d_wake;
+    std::thread d_thread;
+};
+
+template <typename T> struct State_Observer_Data : State_Notification
+{
 };
 
 }
@@ -35,6 +151,16 @@ template <typename T> struct State_Observer_Data
 template <typename T> class State;
 template <typename T> class State_Observer;
 
+/*! \brief How a \ref State_Observer learns about new values. */
+enum class State_Observer_Mode
+{
+    //! The observer's \ref State_Observer::changed "changed" event is activated on every store.
+    Notify,
+    //! The observer is not notified and only polls using \ref State_Observer::load and similar.
+    //! It uses no file descriptors, and storing does no work for it.
+    Poll
+};
+
 /*! \brief Stores a value read by connected \ref State_Observer "State_Observers".
 
   One or more observers can be connected using \ref State_Observer::connect.
@@ -80,6 +206,22 @@ public:
         d_writer(d_shared->atom)
     {}
 
+    /*!
+     * \brief Constructs the State, stores the given value, and keeps
+     * the last `history` stored values.
+     *
+     * Observers can replay the kept values using \ref State_Observer::load_since.
+     * See \ref Atom::keep_history.
+     *
+     * - Progress: Blocking
+     * - Time complexity: O(history)
+     */
+
+    State(const T & value, int history):
+        d_shared(std::make_shared<Detail::State_Data<T>>(value, history)),
+        d_writer(d_shared->atom)
+    {}
+
     /*!
      * - Progress: Blocking
      * - Time complexity: O(1)
@@ -107,6 +249,9 @@ public:
     /*! \brief Makes \ref value available to observers and notifies them.
      *
      * Observers are notified via their \ref State_Observer::changed "changed" event.
+     * An observer which has not yet handled its event since the last notification
+     * is not notified again, so only observers which are waiting for a change
+     * cost a system call.
      *
      * - Progress: Lock-free.
      * - Time complexity: O(C + K).
@@ -115,9 +260,13 @@ public:
     {
         d_writer.store();
 
+        // Order after storing the value, so that an observer which consumes
+        // its notification after the check below will load the value.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
         for(auto & observer : d_shared->observers)
         {
-            observer->signal.notify();
+            observer->notify();
         }
     }
 
@@ -151,7 +300,8 @@ private:
   and \ref value returns a reference to the last loaded value.
 
   Whenever a new value is stored, the event returned by \ref changed is
-  activated.
+  activated, unless the observer was constructed in the
+  \ref State_Observer_Mode::Poll "Poll" mode.
 
   Unless otherwise noted, the methods of this class should only be called from a single thread.
 
@@ -169,13 +319,28 @@ public:
       The default value is returned by \ref load and \ref value
       when the observer is not connected.
 
+      In the \ref State_Observer_Mode::Poll "Poll" mode, the observer
+      has no \ref changed event.
+
       - Progress: Blocking.
       - Time complexity: O(1).
     */
-    State_Observer(const T & default_value = T()):
+    State_Observer(const T & default_value = T(),
+                   State_Observer_Mode mode = State_Observer_Mode::Notify):
         d_default_value(default_value),
-        d_shared(std::make_shared<Detail::State_Observer_Data<T>>()),
         d_current_value(&d_default_value)
+    {
+        if (mode == State_Observer_Mode::Notify)
+            d_shared = std::make_shared<Detail::State_Observer_Data<T>>();
+    }
+
+    /*! Constructs the observer with a default-constructed default value and the given mode.
+
+      - Progress: Blocking.
+      - Time complexity: O(1).
+    */
+    State_Observer(State_Observer_Mode mode):
+        State_Observer(T(), mode)
     {}
 
     /*!
@@ -203,7 +368,8 @@ public:
 
         d_state = state.d_shared;
         d_reader = std::make_shared<AtomReader<T>>(d_state->atom, d_default_value);
-        d_state->observers.insert(d_shared);
+        if (d_shared)
+            d_state->observers.insert(d_shared);
 
         d_current_value = &d_reader->value();
     }
@@ -219,7 +385,8 @@ public:
             return;
 
         // Break connection
-        d_state->observers.remove(d_shared);
+        if (d_shared)
+            d_state->observers.remove(d_shared);
 
         // Delete reader and possibly state data
         d_reader.reset();
@@ -252,6 +419,88 @@ public:
         return *d_current_value;
     }
 
+    /*! \brief Loads the latest value stored by a connected \ref State, if it changed.
+     *
+     * If a value was stored since the last call to \ref load
+     * (or this method), this is equal to calling \ref load.
+     * Otherwise, this does nothing.
+     *
+     * Checking for change is a single atomic load,
+     * so this is suitable for frequent polling.
+     *
+     * \return Whether the value was loaded.
+     *
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    bool load_if_changed()
+    {
+        if (!d_reader || !d_reader->load_if_changed())
+            return false;
+
+        d_current_value = &d_reader->value();
+        return true;
+    }
+
+    /*! \brief Whether a value was stored by a connected \ref State since the last \ref load.
+     *
+     * Returns false when not connected.
+     *
+     * This does not load the value, and is cheaper than \ref load.
+     * The \ref changed event can be used instead to wait for changes.
+     *
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    bool has_changed() const
+    {
+        return d_reader && d_reader->changed();
+    }
+
+    /*! \brief Returns the number of values stored by a connected \ref State so far.
+     *
+     * Returns 0 when not connected.
+     *
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    uint64_t version() const
+    {
+        return d_reader ? d_reader->version() : 0;
+    }
+
+    /*! \brief Passes each value stored by a connected \ref State after `version` to `fn`.
+     *
+     * `fn` is called as `fn(const T & value, uint64_t version)`, for each
+     * stored value in order, without copying the values.
+     *
+     * The values are replayed from the State's history (see \ref State::State(const T&, int)).
+     * If the observer lags behind by more values than the history keeps,
+     * or the State keeps no history, `fn` is called once with the latest value instead.
+     *
+     * Does not change \ref value.
+     *
+     * A typical use, after handling the \ref changed event:
+     *
+     *     last_version = observer.load_since(last_version, [](const T & value, uint64_t) { process(value); });
+     *
+     * \return The version of the last value passed to `fn`, or `version`
+     * if no value was stored since. Returns `version` when not connected.
+     *
+     * Throws std::runtime_error if a hazard pointer can not be allocated.
+     *
+     * - Progress: Lock-free.
+     * - Time complexity: O(number of values passed).
+     */
+    template <typename F>
+    uint64_t load_since(uint64_t version, F && fn)
+    {
+        if (!d_reader)
+            return version;
+
+        return d_reader->load_since(version, fn);
+    }
+
     /*! \brief Returns a reference to the last loaded value.
      *
      * The returned reference is only valid until the next call to \ref load.
@@ -264,14 +513,65 @@ public:
         return *d_current_value;
     }
 
+    /*! \brief Limits how often the \ref changed event is activated.
+     *
+     * After a value is stored, the event is activated when both:
+     * - `delay` has passed since the store, and
+     * - `min_interval` has passed since the event was last activated.
+     *
+     * Values stored in the meantime are coalesced into a single activation,
+     * and the latest of them is loaded by \ref load. So the event is activated
+     * at most once per `min_interval`, while a change is never delayed by more
+     * than `delay` plus `min_interval`.
+     *
+     * Delayed activations are scheduled by a single thread shared
+     * by all observers, so throttling uses no additional file descriptors per observer.
+     * The thread is started when an observer is first throttled,
+     * and storing values never waits for it.
+     *
+     * Zero values disable throttling, which is the default.
+     *
+     * This method can be called while connected, from any thread.
+     *
+     * Throws std::runtime_error in the \ref State_Observer_Mode::Poll "Poll" mode.
+     *
+     * - Progress: Blocking.
+     * - Time complexity: O(number of throttled observers).
+     */
+    void throttle(std::chrono::nanoseconds min_interval,
+                  std::chrono::nanoseconds delay = std::chrono::nanoseconds(0))
+    {
+        if (!d_shared)
+            throw std::runtime_error("State_Observer: No change event in poll mode.");
+
+        d_shared->throttle(min_interval.count(), delay.count());
+    }
+
     /*! \brief An \ref Event activated whenever a new value is stored by a connected \ref State.
+     *
+     * Multiple values stored before the event is handled activate it only once.
+     * See also \ref throttle.
+     *
+     * Throws std::runtime_error in the \ref State_Observer_Mode::Poll "Poll" mode.
      *
      * - Progress: Wait-free.
      * - Time complexity: O(1).
      */
     Event changed()
     {
-        return d_shared->signal.event();
+        if (!d_shared)
+            throw std::runtime_error("State_Observer: No change event in poll mode.");
+
+        Event event = d_shared->signal.event();
+
+        auto data = d_shared.get();
+        event.clear = [clear = std::move(event.clear), data]()
+        {
+            clear();
+            data->consume();
+        };
+
+        return event;
     }
 
 private:
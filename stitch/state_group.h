@@ -0,0 +1,349 @@
+#pragma once
+
+#include "state.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <utility>
+
+namespace Stitch {
+
+using std::shared_ptr;
+
+/*! \brief A consistent set of values of several members of a \ref State_Group.
+
+  Each member value is immutable and shared between all snapshots
+  in which it did not change, so copying a snapshot does not copy the values.
+
+  - Progress: All methods are wait-free.
+  - Time complexity: All methods are O(1).
+ */
+template <typename... Ts>
+class State_Group_Snapshot
+{
+    template <typename...> friend class State_Group;
+
+public:
+    static constexpr size_t Size = sizeof...(Ts);
+
+    template <size_t I>
+    using Member_Type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+    /*! \brief Constructs a snapshot with default-constructed member values. */
+    State_Group_Snapshot(): State_Group_Snapshot(Ts()...) {}
+
+    /*! \brief Constructs a snapshot with the given member values. */
+    State_Group_Snapshot(const Ts & ... values):
+        d_values(std::make_shared<const Ts>(values)...)
+    {}
+
+    /*! \brief Returns the value of member I. */
+    template <size_t I>
+    const Member_Type<I> & get() const
+    {
+        return *std::get<I>(d_values);
+    }
+
+    /*! \brief Returns the version of the group in which member I was last changed.
+
+      Comparing this to the version of the member in a previously loaded
+      snapshot tells whether the member changed in between.
+     */
+    template <size_t I>
+    uint64_t version() const
+    {
+        return d_versions[I];
+    }
+
+private:
+    std::tuple<shared_ptr<const Ts>...> d_values;
+    uint64_t d_versions[Size] {};
+};
+
+/*! \brief Stores values of several members which are read together by connected \ref State_Group_Observer "State_Group_Observers".
+
+  This is like a \ref State with a value composed of several members,
+  for example the position and velocity of an object:
+  All members changed before a \ref store become visible to observers at once,
+  under a single version, so observers never see a torn combination of members.
+  However, only the members that were changed are copied, and only
+  on their first access by \ref value since the last \ref store.
+
+  Snapshots of the values are published by an internal \ref State,
+  and so all its properties apply, including notification of observers.
+
+  Example:
+
+      State_Group<Position, Velocity> group;
+      group.value<0>() = position;
+      group.value<1>() = velocity;
+      group.store();
+
+  Unless otherwise noted, the methods of this class should only be called from a single thread.
+
+  Progress guarantees use the following parameters:
+  - C = Number of connected observers.
+  - K = Number of hazard pointers in use.
+  - M = Number of members.
+ */
+template <typename... Ts>
+class State_Group
+{
+    template <typename...> friend class State_Group_Observer;
+
+public:
+    using Snapshot = State_Group_Snapshot<Ts...>;
+
+    template <size_t I>
+    using Member_Type = typename Snapshot::template Member_Type<I>;
+
+    /*!
+     * \brief Constructs the group and stores default-constructed members.
+     *
+     * - Progress: Blocking
+     * - Time complexity: O(M)
+     */
+
+    State_Group(): State_Group(Ts()...) {}
+
+    /*!
+     * \brief Constructs the group and stores the given member values.
+     *
+     * - Progress: Blocking
+     * - Time complexity: O(M)
+     */
+
+    State_Group(const Ts & ... values):
+        d_current(values...),
+        d_state(d_current)
+    {}
+
+    // State_Group is not copyable.
+    State_Group(const State_Group &) = delete;
+    State_Group & operator=(const State_Group &) = delete;
+
+    /*! \brief Returns a reference to the value of member I to be written.
+
+        On the first call since the last \ref store, the last stored value
+        of the member is copied, and the member is marked as changed.
+
+        The changed members are made available to observers by calling \ref store.
+        The returned reference is only valid until the next call to \ref store.
+
+       - Progress: Blocking on first call since the last store. Wait-free otherwise.
+       - Time complexity: O(1)
+    */
+
+    template <size_t I>
+    Member_Type<I> & value()
+    {
+        auto & changed = std::get<I>(d_changed);
+        if (!changed)
+            changed = std::make_shared<Member_Type<I>>(d_current.template get<I>());
+        return *changed;
+    }
+
+    /*! \brief Sets the value of member I to be written.
+
+        This is equivalent to `value<I>() = value`, except that
+        the last stored value is not copied first.
+
+       - Progress: Blocking
+       - Time complexity: O(1)
+    */
+
+    template <size_t I>
+    void set(const Member_Type<I> & value)
+    {
+        auto & changed = std::get<I>(d_changed);
+        if (changed)
+            *changed = value;
+        else
+            changed = std::make_shared<Member_Type<I>>(value);
+    }
+
+    /*! \brief Makes all changed members available to observers at once and notifies them.
+     *
+     * If no member was changed since the last store, this does nothing.
+     *
+     * See \ref State::store.
+     *
+     * - Progress: Lock-free.
+     * - Time complexity: O(M + C + K).
+     */
+    void store()
+    {
+        bool changed = false;
+
+        [&]<size_t... I>(std::index_sequence<I...>)
+        {
+            (take_changed<I>(changed), ...);
+        }(std::index_sequence_for<Ts...>());
+
+        if (!changed)
+            return;
+
+        d_state.store(d_current);
+    }
+
+    /*! \brief Returns the number of stores so far that changed any member.
+     *
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    uint64_t version() const { return d_version; }
+
+private:
+    // Moves member I into the current snapshot if it was changed.
+    template <size_t I>
+    void take_changed(bool & changed)
+    {
+        auto & value = std::get<I>(d_changed);
+        if (!value)
+            return;
+
+        if (!changed)
+        {
+            changed = true;
+            ++d_version;
+        }
+
+        std::get<I>(d_current.d_values) = std::move(value);
+        d_current.d_versions[I] = d_version;
+    }
+
+    // The last stored snapshot
+    Snapshot d_current;
+    State<Snapshot> d_state;
+    // Changed members not yet stored, or null
+    std::tuple<shared_ptr<Ts>...> d_changed;
+    uint64_t d_version = 0;
+};
+
+/*! \brief Reads consistent snapshots of members of a connected \ref State_Group.
+
+  This is like a \ref State_Observer of a \ref State_Group_Snapshot,
+  and has all its properties.
+
+  Progress guarantees use the following parameters:
+  - C = Number of connected observers.
+  - H = Maximum allowable number of hazard pointers.
+*/
+template <typename... Ts>
+class State_Group_Observer
+{
+public:
+    using Snapshot = State_Group_Snapshot<Ts...>;
+
+    template <size_t I>
+    using Member_Type = typename Snapshot::template Member_Type<I>;
+
+    /*! Constructs the observer with default-constructed default member values.
+
+      See \ref State_Observer::State_Observer.
+
+      - Progress: Blocking.
+      - Time complexity: O(M).
+    */
+    State_Group_Observer(State_Observer_Mode mode = State_Observer_Mode::Notify):
+        d_observer(Snapshot(), mode)
+    {}
+
+    /*! Constructs the observer with the given default snapshot.
+
+      - Progress: Blocking.
+      - Time complexity: O(1).
+    */
+    State_Group_Observer(const Snapshot & default_value,
+                         State_Observer_Mode mode = State_Observer_Mode::Notify):
+        d_observer(default_value, mode)
+    {}
+
+    /*! \brief Connects to a \ref State_Group.
+     *
+     * - Progress: Blocking.
+     * - Time complexity: O(C).
+     */
+    void connect(State_Group<Ts...> & group) { d_observer.connect(group.d_state); }
+
+    /*! \brief See \ref State_Observer::disconnect.
+     *
+     * - Progress: Blocking.
+     * - Time complexity: Asymptotic O(C). Worst-case O(C + H).
+     */
+    void disconnect() { d_observer.disconnect(); }
+
+    /*! \brief Loads the latest snapshot stored by a connected \ref State_Group.
+     *
+     * See \ref State_Observer::load.
+     *
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    const Snapshot & load() { return d_observer.load(); }
+
+    /*! \brief See \ref State_Observer::load_if_changed.
+     *
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    bool load_if_changed() { return d_observer.load_if_changed(); }
+
+    /*! \brief See \ref State_Observer::has_changed.
+     *
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    bool has_changed() const { return d_observer.has_changed(); }
+
+    /*! \brief Returns the version of the group stored last, or 0 when not connected.
+     *
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    uint64_t version() const { return d_observer.version(); }
+
+    /*! \brief Returns a reference to the last loaded snapshot.
+     *
+     * The returned reference is only valid until the next call to \ref load.
+     *
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    const Snapshot & value() { return d_observer.value(); }
+
+    /*! \brief Returns the value of member I in the last loaded snapshot.
+     *
+     * The returned reference is only valid until the next call to \ref load.
+     *
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    template <size_t I>
+    const Member_Type<I> & get() { return d_observer.value().template get<I>(); }
+
+    /*! \brief See \ref State_Observer::throttle.
+     *
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    void throttle(std::chrono::nanoseconds min_interval,
+                  std::chrono::nanoseconds delay = std::chrono::nanoseconds(0))
+    {
+        d_observer.throttle(min_interval, delay);
+    }
+
+    /*! \brief See \ref State_Observer::changed.
+     *
+     * - Progress: Wait-free.
+     * - Time complexity: O(1).
+     */
+    Event changed() { return d_observer.changed(); }
+
+private:
+    State_Observer<Snapshot> d_observer;
+};
+
+}
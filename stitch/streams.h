@@ -2,17 +2,295 @@
 
 #include "connections.h"
 #include "queue_mpsc_waitfree.h"
+#include "queue_spsc_waitfree.h"
 #include "signal.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <type_traits>
 
 namespace Stitch {
 
+/*!
+\brief Determines when a \ref Stream_Consumer's \ref Stream_Consumer::receive_event "receive event" is activated.
+
+By default (both members zero), the event is activated on every push.
+
+Otherwise, the event is activated when either of the following happens first:
+
+- The number of items in the queue reaches `high_watermark`
+  (if `high_watermark` is larger than 0).
+- `max_latency` passes since an item was pushed into an empty queue
+  (if `max_latency` is larger than 0).
+
+This allows a consumer to process items in batches and
+be woken up once per batch instead of once per item.
+The deadline is implemented using a \ref Timer owned by the consumer.
+
+When a wake policy is used, the consumer is expected to pop all the
+items in the queue after each activation of the event.
+Otherwise, remaining items might not activate the event again until
+more items are pushed.
+*/
+struct Stream_Wake_Policy
+{
+    int high_watermark = 0;
+    std::chrono::nanoseconds max_latency { 0 };
+
+    bool is_default() const { return high_watermark <= 0 && max_latency.count() <= 0; }
+};
+
+namespace Detail {
+
+struct No_Stream_Lane
+{
+    No_Stream_Lane(int) {}
+};
+
+}
+
+/*
+When the queue is a Waitfree_MPSC_Queue, the buffer also contains
+a Waitfree_SPSC_Queue (the "lane") which is used instead of the queue
+while only one producer is connected. This avoids the read-modify-write
+operations of the MPSC queue in the common case of a 1:1 connection.
+
+The lane is owned by at most one producer at a time.
+A producer claims the lane only when it is the only connected producer
+and both the lane and the queue are empty.
+An owner keeps using the lane when more producers connect, until it finds
+the lane empty, and only then releases it and switches to the queue.
+The consumer pops from the lane before the queue.
+Together, this preserves the order of items pushed by each producer.
+*/
 template <typename T, typename Queue = Waitfree_MPSC_Queue<T>>
 struct Stream_Buffer
 {
-    Stream_Buffer(int capacity): queue(capacity) {}
+    static constexpr bool has_lane = std::is_same_v<Queue, Waitfree_MPSC_Queue<T>>;
+
+    using Lane = std::conditional_t<has_lane, Waitfree_SPSC_Queue<T>, Detail::No_Stream_Lane>;
+
+    Stream_Buffer(int capacity, const Stream_Wake_Policy & policy = Stream_Wake_Policy()):
+        queue(capacity),
+        lane(queue.capacity()),
+        policy(policy)
+    {
+        if (!policy.is_default())
+            wake_timer.emplace();
+    }
+
+    // Called by connections when a producer connects.
+    void client_connected(const void *)
+    {
+        producers.fetch_add(1);
+    }
+
+    // Called by connections when a producer disconnects.
+    void client_disconnected(const void * producer)
+    {
+        const void * expected = producer;
+        lane_owner.compare_exchange_strong(expected, nullptr);
+        producers.fetch_sub(1);
+    }
+
+    // Called by producers. Returns whether the lane should be used.
+    bool use_lane(const void * producer)
+    {
+        if constexpr (has_lane)
+        {
+            const void * owner = lane_owner.load(std::memory_order_relaxed);
+
+            if (owner == producer)
+            {
+                if (producers.load(std::memory_order_relaxed) == 1 || !lane.empty())
+                    return true;
+
+                lane_owner.store(nullptr, std::memory_order_relaxed);
+                return false;
+            }
+
+            if (owner == nullptr && producers.load(std::memory_order_relaxed) == 1 &&
+                    lane.empty() && queue.size() == 0)
+            {
+                return lane_owner.compare_exchange_strong(owner, producer);
+            }
+        }
+
+        return false;
+    }
+
+    bool push(const T & val, const void * producer)
+    {
+        bool ok;
+
+        if constexpr (has_lane)
+            ok = use_lane(producer) ? lane.push(val) : queue.push(val);
+        else
+            ok = queue.push(val);
+
+        if (ok)
+            pushed(1);
+
+        return ok;
+    }
+
+    template <typename I>
+    bool push(int count, I input, const void * producer)
+    {
+        bool ok;
+
+        if constexpr (has_lane)
+            ok = use_lane(producer) ? lane.push(count, input) : queue.push(count, input);
+        else
+            ok = queue.push(count, input);
+
+        if (ok)
+            pushed(count);
+
+        return ok;
+    }
+
+    bool empty()
+    {
+        if constexpr (has_lane)
+            return lane.empty() && queue.empty();
+        else
+            return queue.empty();
+    }
+
+    // Number of items in the buffer. Can be used by producers.
+    int occupancy()
+    {
+        if constexpr (has_lane)
+            return lane.size() + queue.size();
+        else
+            return queue.size();
+    }
+
+    bool pop(T & val)
+    {
+        bool ok;
+
+        if constexpr (has_lane)
+            ok = lane.pop(val) || queue.pop(val);
+        else
+            ok = queue.pop(val);
+
+        if (ok)
+            popped(1);
+
+        return ok;
+    }
+
+    // Items are taken either all from the lane or all from the queue.
+    template <typename O>
+    bool pop(int count, O output)
+    {
+        bool ok;
+
+        if constexpr (has_lane)
+            ok = lane.empty() ? queue.pop(count, output) : lane.pop(count, output);
+        else
+            ok = queue.pop(count, output);
+
+        if (ok)
+            popped(count);
+
+        return ok;
+    }
+
+    // Called by a producer after successfully pushing 'count' items.
+    void pushed(int count)
+    {
+        if (!wake_timer)
+        {
+            signal.notify();
+            return;
+        }
+
+        int before = size.fetch_add(count);
+        int after = before + count;
+
+        if (policy.high_watermark > 0 && before < policy.high_watermark && after >= policy.high_watermark)
+        {
+            // Expire as soon as possible.
+            arm_wake_timer(std::chrono::nanoseconds(1));
+        }
+        else if (before <= 0 && policy.max_latency.count() > 0)
+        {
+            arm_wake_timer(policy.max_latency);
+        }
+    }
+
+    // Arms the wake timer to expire after 'delay',
+    // unless it is already armed to expire earlier.
+    void arm_wake_timer(std::chrono::nanoseconds delay)
+    {
+        int64_t now = steady_time();
+        int64_t deadline = now + delay.count();
+
+        int64_t armed = wake_deadline.load();
+        do
+        {
+            // A deadline in the past has already expired.
+            if (armed > now && armed <= deadline)
+                return;
+        }
+        while (!wake_deadline.compare_exchange_weak(armed, deadline));
+
+        // Another producer may set an earlier deadline and start the timer
+        // before we start it, so the last to start it restarts it
+        // with the earliest deadline.
+        for(;;)
+        {
+            wake_timer->start(std::chrono::nanoseconds(std::max<int64_t>(deadline - steady_time(), 1)));
+
+            int64_t earliest = wake_deadline.load();
+            if (earliest >= deadline)
+                return;
+
+            deadline = earliest;
+        }
+    }
+
+    static int64_t steady_time()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Called by the consumer after successfully popping 'count' items.
+    void popped(int count)
+    {
+        if (wake_timer)
+            size.fetch_sub(count);
+    }
+
+    Event event()
+    {
+        return wake_timer ? wake_timer->event() : signal.event();
+    }
 
     Queue queue;
+    Lane lane;
     Signal signal;
+
+    std::atomic<int> producers { 0 };
+    std::atomic<const void*> lane_owner { nullptr };
+
+    Stream_Wake_Policy policy;
+    std::optional<Timer> wake_timer;
+    // Number of items in queue. Only maintained when using a wake policy.
+    // It is incremented after pushing and decremented after popping,
+    // so it may temporarily be negative.
+    std::atomic<int> size { 0 };
+    // Time when the wake timer was last armed to expire (nanoseconds of std::chrono::steady_clock).
+    std::atomic<int64_t> wake_deadline { 0 };
 };
 
 template <typename T, typename Q = Waitfree_MPSC_Queue<T>>
@@ -31,7 +309,7 @@ public:
 
     void push(const T & val)
     {
-        for (Buffer & buf : *this) { buf.queue.push(val); buf.signal.notify(); }
+        for (Buffer & buf : *this) { buf.push(val, this->id()); }
     }
 
     /*!
@@ -51,20 +329,215 @@ public:
     template <typename I>
     void push(int count, I input)
     {
-        for (Buffer & buf : *this) { buf.queue.push(count, input); buf.signal.notify(); }
+        for (Buffer & buf : *this) { buf.push(count, input, this->id()); }
+    }
+
+    /*!
+    \brief Adds a variable-length message to the queues of all connected consumers.
+
+    Calls `push(data, size)` on each consumer's queue.
+    This is only available with queues of variable-length messages.
+    See: \ref Lockfree_MPSC_Message_Queue::push(const void*, int).
+
+    - Progress: Lock-free
+    - Time complexity: O(size * C) where C is the number of connected consumers.
+    */
+    void push(const void * data, int size)
+    {
+        for (Buffer & buf : *this) { if (buf.queue.push(data, size)) buf.pushed(1); }
     }
 };
 
+/*!
+\brief Selects the consumer which receives an item from a \ref Stream_Distributor.
+*/
+enum class Stream_Distribution
+{
+    /*! Consumers receive items in turns. */
+    Round_Robin,
+    /*! The consumer with the least items in its queue receives the item. */
+    Least_Occupied
+};
+
+/*!
+\brief Distributes items among connected \ref Stream_Consumer "Stream_Consumers".
+
+Unlike a \ref Stream_Producer, which gives every item to all consumers,
+a Stream_Distributor gives each item to exactly one consumer.
+This is useful for distributing work among a pool of workers.
+
+The consumer is chosen according to the \ref Stream_Distribution mode
+passed to the constructor, or according to a key (see \ref push(const K &, const T &)).
+
+Only the queue of the chosen consumer is accessed when pushing an item.
+*/
+template <typename T, typename Q = Waitfree_MPSC_Queue<T>>
+class Stream_Distributor : public Client<Stream_Buffer<T,Q>>
+{
+public:
+    using Buffer = Stitch::Stream_Buffer<T,Q>;
+
+    Stream_Distributor(Stream_Distribution mode = Stream_Distribution::Round_Robin):
+        d_mode(mode)
+    {}
+
+    Stream_Distribution mode() const { return d_mode; }
+
+    /*!
+    \brief Adds an item to the queue of one connected consumer, chosen according to \ref mode.
+
+    \return True on success.
+    False if there are no consumers or the chosen consumer's queue is full.
+
+    - Progress: Lock-free
+    - Time complexity: O(C) where C is the number of connected consumers.
+    */
+    bool push(const T & val)
+    {
+        Buffer * target = nullptr;
+
+        switch(d_mode)
+        {
+        case Stream_Distribution::Round_Robin:
+            target = next_buffer();
+            break;
+        case Stream_Distribution::Least_Occupied:
+            target = least_occupied_buffer();
+            break;
+        }
+
+        if (!target)
+            return false;
+
+        return target->push(val, this->id());
+    }
+
+    /*!
+    \brief Adds an item to the queue of the connected consumer selected by `key`.
+
+    Items with equal keys are given to the same consumer, and
+    so their order is preserved, as long as the set of connected consumers does not change.
+    When a consumer connects or disconnects, only the keys assigned to that consumer change their assignment.
+
+    The key type K must be supported by `std::hash`.
+
+    \return True on success.
+    False if there are no consumers or the chosen consumer's queue is full.
+
+    - Progress: Lock-free
+    - Time complexity: O(C) where C is the number of connected consumers.
+    */
+    template <typename K>
+    bool push(const K & key, const T & val)
+    {
+        Buffer * target = keyed_buffer(std::hash<K>()(key));
+
+        if (!target)
+            return false;
+
+        return target->push(val, this->id());
+    }
+
+private:
+    Buffer * next_buffer()
+    {
+        Buffer * first = nullptr;
+        int index = 0;
+
+        for (Buffer & buf : *this)
+        {
+            if (!first)
+                first = &buf;
+
+            if (index == d_next)
+            {
+                ++d_next;
+                return &buf;
+            }
+
+            ++index;
+        }
+
+        d_next = 1;
+        return first;
+    }
+
+    Buffer * least_occupied_buffer()
+    {
+        Buffer * target = nullptr;
+        int target_occupancy = 0;
+
+        for (Buffer & buf : *this)
+        {
+            int occupancy = buf.occupancy();
+            if (!target || occupancy < target_occupancy)
+            {
+                target = &buf;
+                target_occupancy = occupancy;
+            }
+        }
+
+        return target;
+    }
+
+    // Rendezvous hashing: choose the buffer with the highest score for the key.
+    Buffer * keyed_buffer(uint64_t key)
+    {
+        Buffer * target = nullptr;
+        uint64_t target_score = 0;
+
+        for (Buffer & buf : *this)
+        {
+            uint64_t score = mix(key ^ mix((uint64_t)(uintptr_t)&buf));
+            if (!target || score > target_score)
+            {
+                target = &buf;
+                target_score = score;
+            }
+        }
+
+        return target;
+    }
+
+    // The finalizer of MurmurHash3
+    static uint64_t mix(uint64_t x)
+    {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    Stream_Distribution d_mode;
+    int d_next = 0;
+};
+
 template <typename T, typename Q = Waitfree_MPSC_Queue<T>>
 class Stream_Consumer : public Server<Stream_Buffer<T,Q>>
 {
 public:
     using Buffer = Stitch::Stream_Buffer<T,Q>;
 
-    Stream_Consumer(int capacity):
-        Server<Buffer>(std::make_shared<Buffer>(capacity))
+    /*!
+        \brief Constructs the consumer with a queue of the given capacity.
+
+        The optional `policy` determines when \ref receive_event is activated.
+        See \ref Stream_Wake_Policy.
+     */
+    Stream_Consumer(int capacity, const Stream_Wake_Policy & policy = Stream_Wake_Policy()):
+        Server<Buffer>(std::make_shared<Buffer>(capacity, policy))
     {}
 
+protected:
+    // Constructs the consumer with a buffer also shared with others, e.g. a \ref Topic_Bus.
+    Stream_Consumer(const shared_ptr<Buffer> & buffer):
+        Server<Buffer>(buffer)
+    {}
+
+public:
+
     // Wait-free
 
     /*!
@@ -75,7 +548,7 @@ public:
      */
     bool empty()
     {
-        return this->data().queue.empty();
+        return this->data().empty();
     }
 
     // Wait-free
@@ -91,7 +564,7 @@ public:
     */
     bool pop(T & v)
     {
-        return this->data().queue.pop(v);
+        return this->data().pop(v);
     }
 
     /*!
@@ -113,16 +586,110 @@ public:
     template <typename O>
     bool pop(int count, O output)
     {
-        return this->data().queue.pop(count, output);
+        return this->data().pop(count, output);
+    }
+
+    /*!
+    \brief Returns the first variable-length message in the consumer's queue without removing it.
+
+    Calls `front(size)` on the queue and forwards the return value.
+    This is only available with queues of variable-length messages.
+    See: \ref Lockfree_MPSC_Message_Queue::front(int&).
+
+    - Progress: Wait-free
+    - Time complexity: O(1)
+    */
+    const void * front(int & size)
+    {
+        return this->data().queue.front(size);
+    }
+
+    /*!
+    \brief Removes the first variable-length message from the consumer's queue.
+
+    Calls `pop()` on the queue and forwards the return value.
+    This is only available with queues of variable-length messages.
+    See: \ref Lockfree_MPSC_Message_Queue::pop().
+
+    - Progress: Wait-free
+    - Time complexity: O(size of message)
+    */
+    bool pop()
+    {
+        Buffer & buf = this->data();
+        if (!buf.queue.pop())
+            return false;
+        buf.popped(1);
+        return true;
     }
 
+    /*!
+    \brief Returns an event activated when items are pushed into the consumer's queue.
+
+    Unless a \ref Stream_Wake_Policy was passed to the constructor,
+    the event is activated on every push.
+    */
     Event receive_event()
     {
-        return this->data().signal.event();
+        return this->data().event();
     }
 };
 
+/*!
+\brief Connects a \ref Stream_Producer to a \ref Stream_Consumer.
+
+While a consumer has a single producer connected, items are passed
+through a \ref Waitfree_SPSC_Queue instead of the consumer's \ref Waitfree_MPSC_Queue.
+When more producers connect, they switch to the MPSC queue.
+The order of items pushed by each producer is preserved.
+*/
+template <typename T, typename Q>
+void connect(Stream_Producer<T,Q> & producer, Stream_Consumer<T,Q> & consumer)
+{
+    using Buffer = Stream_Buffer<T,Q>;
+    connect<Buffer>(producer, consumer);
+}
+
+/*!
+\brief Disconnects a \ref Stream_Producer from a \ref Stream_Consumer.
+*/
+template <typename T, typename Q>
+void disconnect(Stream_Producer<T,Q> & producer, Stream_Consumer<T,Q> & consumer)
+{
+    using Buffer = Stream_Buffer<T,Q>;
+    disconnect<Buffer>(producer, consumer);
+}
+
+/*!
+\brief Connects a \ref Stream_Distributor to a \ref Stream_Consumer.
+*/
+template <typename T, typename Q>
+void connect(Stream_Distributor<T,Q> & distributor, Stream_Consumer<T,Q> & consumer)
+{
+    using Buffer = Stream_Buffer<T,Q>;
+    connect<Buffer>(distributor, consumer);
+}
+
+/*!
+\brief Disconnects a \ref Stream_Distributor from a \ref Stream_Consumer.
+*/
+template <typename T, typename Q>
+void disconnect(Stream_Distributor<T,Q> & distributor, Stream_Consumer<T,Q> & consumer)
+{
+    using Buffer = Stream_Buffer<T,Q>;
+    disconnect<Buffer>(distributor, consumer);
+}
+
 template <typename T, typename Q>
 void connect(Stream_Producer<T,Q> &, Stream_Producer<T,Q> &) = delete;
 
+template <typename T, typename Q>
+void connect(Stream_Distributor<T,Q> &, Stream_Distributor<T,Q> &) = delete;
+
+template <typename T, typename Q>
+void connect(Stream_Producer<T,Q> &, Stream_Distributor<T,Q> &) = delete;
+
+template <typename T, typename Q>
+void connect(Stream_Distributor<T,Q> &, Stream_Producer<T,Q> &) = delete;
+
 }
@@ -0,0 +1,375 @@
+#pragma once
+
+#include "array_set.h"
+#include "streams.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Stitch {
+
+using std::string;
+using std::shared_ptr;
+
+/*!
+\brief Selects how a \ref Topic_Subscriber's pattern is matched against topic names.
+*/
+enum class Topic_Match
+{
+    /*! The topic name equals the pattern. */
+    Exact,
+    /*! The topic name starts with the pattern. */
+    Prefix
+};
+
+template <typename T, typename Q> class Topic_Bus;
+template <typename T, typename Q> class Topic_Subscriber;
+
+namespace Detail {
+
+template <typename T, typename Q>
+struct Topic_Record
+{
+    using Buffer = Stream_Buffer<T,Q>;
+
+    Topic_Record(const string & name): name(name) {}
+
+    const string name;
+    // Buffers of all subscribers with a pattern matching the name
+    Array_Set<shared_ptr<Buffer>> subscribers;
+};
+
+// State of a bus shared with its topics and subscribers,
+// so they can outlive the bus.
+template <typename T, typename Q>
+struct Topic_Registry
+{
+    using Buffer = Stream_Buffer<T,Q>;
+    using Record = Topic_Record<T,Q>;
+
+    struct Subscription
+    {
+        shared_ptr<Buffer> buffer;
+        string pattern;
+        Topic_Match match;
+    };
+
+    static bool matches(const string & name, const string & pattern, Topic_Match match)
+    {
+        if (match == Topic_Match::Exact)
+            return name == pattern;
+        else
+            return name.starts_with(pattern);
+    }
+
+    // Calls 'fn' for each topic matching the pattern.
+    template <typename F>
+    void for_each_topic(const string & pattern, Topic_Match match, F fn)
+    {
+        if (match == Topic_Match::Exact)
+        {
+            auto it = topics.find(pattern);
+            if (it != topics.end())
+                fn(*it->second);
+            return;
+        }
+
+        for (auto it = topics.lower_bound(pattern); it != topics.end() && it->first.starts_with(pattern); ++it)
+            fn(*it->second);
+    }
+
+    bool is_subscribed(const shared_ptr<Buffer> & buffer, const string & name)
+    {
+        for (auto & subscription : subscriptions)
+        {
+            if (subscription.buffer == buffer && matches(name, subscription.pattern, subscription.match))
+                return true;
+        }
+
+        return false;
+    }
+
+    shared_ptr<Record> topic(const string & name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto & record = topics[name];
+
+        if (!record)
+        {
+            record = std::make_shared<Record>(name);
+
+            for (auto & subscription : subscriptions)
+            {
+                if (matches(name, subscription.pattern, subscription.match))
+                    record->subscribers.insert(subscription.buffer);
+            }
+        }
+
+        return record;
+    }
+
+    void subscribe(const shared_ptr<Buffer> & buffer, const string & pattern, Topic_Match match)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        subscriptions.push_back({ buffer, pattern, match });
+
+        // Array_Set ignores a buffer already subscribed by another pattern.
+        for_each_topic(pattern, match, [&](Record & record)
+        {
+            record.subscribers.insert(buffer);
+        });
+    }
+
+    void unsubscribe(const shared_ptr<Buffer> & buffer, const string & pattern, Topic_Match match)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        bool found = false;
+
+        for (auto it = subscriptions.begin(); it != subscriptions.end(); ++it)
+        {
+            if (it->buffer == buffer && it->pattern == pattern && it->match == match)
+            {
+                subscriptions.erase(it);
+                found = true;
+                break;
+            }
+        }
+
+        if (!found)
+            return;
+
+        // Keep topics still matched by another pattern of the same subscriber.
+        for_each_topic(pattern, match, [&](Record & record)
+        {
+            if (!is_subscribed(buffer, record.name))
+                record.subscribers.remove(buffer);
+        });
+    }
+
+    void unsubscribe_all(const shared_ptr<Buffer> & buffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::erase_if(subscriptions, [&](const Subscription & s){ return s.buffer == buffer; });
+
+        for (auto & [name, record] : topics)
+            record->subscribers.remove(buffer);
+    }
+
+    std::mutex mutex;
+    std::map<string, shared_ptr<Record>> topics;
+    std::vector<Subscription> subscriptions;
+};
+
+}
+
+/*!
+\brief A handle used to publish items to all subscribers of a topic of a \ref Topic_Bus.
+
+The subscribers of the topic are resolved when subscriptions change,
+so publishing only iterates an array of subscribers' queues,
+without looking up the topic name or matching patterns.
+
+Handles are obtained using \ref Topic_Bus::topic, and can be copied.
+A default-constructed handle refers to no topic, and must not be used to publish.
+
+Items are pushed to the subscribers' queues concurrently with other publishers,
+so the queue type Q must support multiple producers.
+*/
+template <typename T, typename Q = Waitfree_MPSC_Queue<T>>
+class Topic
+{
+    friend class Topic_Bus<T,Q>;
+
+public:
+    Topic() {}
+
+    /*! \brief Returns the name of the topic. */
+    const string & name() const { return d_record->name; }
+
+    /*!
+    \brief Adds an item to the queues of all subscribers of the topic.
+
+    Calls `push(val)` on each subscriber's queue.
+    See: \ref Waitfree_MPSC_Queue::push(const T &).
+
+    Throws std::runtime_error if a hazard pointer can not be allocated.
+
+    - Progress: Wait-free if hazard pointers are cached by this thread and the queue is wait-free.
+    - Time complexity: O(S) where S is the number of subscribers of the topic.
+    */
+    void publish(const T & val) const
+    {
+        for (auto & buffer : d_record->subscribers)
+        {
+            if (buffer->queue.push(val))
+                buffer->pushed(1);
+        }
+    }
+
+    /*!
+    \brief Adds items in bulk to the queues of all subscribers of the topic.
+
+    Calls `push(count, input)` on each subscriber's queue.
+    See: \ref Waitfree_MPSC_Queue::push(int, I).
+
+    - Progress: Wait-free if hazard pointers are cached by this thread and the queue is wait-free.
+    - Time complexity: O(count * S) where S is the number of subscribers of the topic.
+    */
+    template <typename I>
+    void publish(int count, I input) const
+    {
+        for (auto & buffer : d_record->subscribers)
+        {
+            if (buffer->queue.push(count, input))
+                buffer->pushed(count);
+        }
+    }
+
+    /*!
+    \brief Returns whether the topic has any subscribers.
+
+    - Progress: Wait-free
+    - Time complexity: O(1)
+    */
+    bool has_subscribers() const
+    {
+        return !d_record->subscribers.empty();
+    }
+
+private:
+    Topic(const shared_ptr<Detail::Topic_Record<T,Q>> & record): d_record(record) {}
+
+    shared_ptr<Detail::Topic_Record<T,Q>> d_record;
+};
+
+/*!
+\brief Routes items published to named topics to \ref Topic_Subscriber "Topic_Subscribers".
+
+Subscribers subscribe to topics using patterns which either match
+a topic name exactly, or match all topic names starting with a prefix
+(see \ref Topic_Match).
+Producers publish items to topics using \ref Topic handles obtained from \ref topic.
+
+Each topic keeps the queues of subscribers with matching patterns in an \ref Array_Set.
+The set is updated when a topic is created and when subscriptions change,
+so the cost of matching names is paid only then, and publishing is
+a direct fan-out to the subscribers' queues.
+A subscriber which matches a topic by several patterns receives each item once.
+
+Creating topics and changing subscriptions is serialized by a mutex,
+and should not be done by threads with real-time requirements.
+
+The bus may be destroyed before its topics and subscribers.
+*/
+template <typename T, typename Q = Waitfree_MPSC_Queue<T>>
+class Topic_Bus
+{
+    friend class Topic_Subscriber<T,Q>;
+
+public:
+    Topic_Bus(): d_registry(std::make_shared<Detail::Topic_Registry<T,Q>>()) {}
+
+    Topic_Bus(const Topic_Bus &) = delete;
+    Topic_Bus & operator=(const Topic_Bus &) = delete;
+
+    /*!
+    \brief Returns a handle to the topic with the given name, creating the topic if it doesn't exist.
+
+    - Progress: Blocking
+    - Time complexity: O(log(number of topics)) if the topic exists,
+      otherwise O(number of subscriptions).
+    */
+    Topic<T,Q> topic(const string & name)
+    {
+        return Topic<T,Q>(d_registry->topic(name));
+    }
+
+private:
+    shared_ptr<Detail::Topic_Registry<T,Q>> d_registry;
+};
+
+/*!
+\brief Receives items published to topics of a \ref Topic_Bus matching its subscriptions.
+
+This is a \ref Stream_Consumer, so items are received in the same way,
+and it can also be connected to \ref Stream_Producer "Stream_Producers".
+
+Items published to the same topic by the same thread are received in order.
+
+The subscriber is unsubscribed from all topics when destroyed.
+*/
+template <typename T, typename Q = Waitfree_MPSC_Queue<T>>
+class Topic_Subscriber : public Stream_Consumer<T,Q>
+{
+public:
+    using Buffer = Stitch::Stream_Buffer<T,Q>;
+
+    /*!
+    \brief Constructs a subscriber of topics of `bus`, with a queue of the given capacity.
+
+    The optional `policy` determines when \ref Stream_Consumer::receive_event is activated.
+    See \ref Stream_Wake_Policy.
+    */
+    Topic_Subscriber(Topic_Bus<T,Q> & bus, int capacity, const Stream_Wake_Policy & policy = Stream_Wake_Policy()):
+        Topic_Subscriber(bus, std::make_shared<Buffer>(capacity, policy))
+    {}
+
+    ~Topic_Subscriber()
+    {
+        unsubscribe_all();
+    }
+
+    /*!
+    \brief Subscribes to topics with names matching `pattern`, including topics created later.
+
+    - Progress: Blocking
+    - Time complexity: O(number of subscribers of each matching topic)
+    */
+    void subscribe(const string & pattern, Topic_Match match = Topic_Match::Exact)
+    {
+        d_registry->subscribe(d_buffer, pattern, match);
+    }
+
+    /*!
+    \brief Cancels a subscription made using \ref subscribe with the same arguments.
+
+    Topics matched by other subscriptions of this subscriber are still received.
+
+    - Progress: Blocking
+    - Time complexity: O(number of subscribers of each matching topic * number of subscriptions)
+    */
+    void unsubscribe(const string & pattern, Topic_Match match = Topic_Match::Exact)
+    {
+        d_registry->unsubscribe(d_buffer, pattern, match);
+    }
+
+    /*!
+    \brief Cancels all subscriptions.
+
+    - Progress: Blocking
+    - Time complexity: O(number of topics * number of their subscribers)
+    */
+    void unsubscribe_all()
+    {
+        d_registry->unsubscribe_all(d_buffer);
+    }
+
+private:
+    Topic_Subscriber(Topic_Bus<T,Q> & bus, const shared_ptr<Buffer> & buffer):
+        Stream_Consumer<T,Q>(buffer),
+        d_registry(bus.d_registry),
+        d_buffer(buffer)
+    {}
+
+    shared_ptr<Detail::Topic_Registry<T,Q>> d_registry;
+    shared_ptr<Buffer> d_buffer;
+};
+
+}
@@ -7,11 +7,22 @@ Test_Set waitfree_spsc_queue_tests();
 Test_Set waitfree_mpsc_queue_tests();
 Test_Set waitfree_mpmc_queue_tests();
 Test_Set lockfree_mpmc_queue_tests();
+Test_Set lockfree_mpsc_message_queue_tests();
 Test_Set lockfree_set_tests();
+Test_Set array_set_tests();
+Test_Set slot_set_tests();
+Test_Set hash_map_tests();
+Test_Set skip_list_map_tests();
 Test_Set spmc_atom_tests();
+Test_Set waitfree_spmc_atom_tests();
+Test_Set mpmc_atom_tests();
 Test_Set atom_tests();
 Test_Set stream_tests();
+Test_Set shared_stream_tests();
+Test_Set shared_state_tests();
 Test_Set state_tests();
+Test_Set state_group_tests();
+Test_Set topic_bus_tests();
 Test_Set connection_tests();
 Test_Set signal_tests();
 Test_Set timer_tests();
@@ -26,12 +37,23 @@ int main(int argc, char * argv[])
         { "waitfree-mpsc-queue", waitfree_mpsc_queue_tests() },
         { "waitfree-mpmc-queue", waitfree_mpmc_queue_tests() },
         { "lockfree-mpmc-queue", lockfree_mpmc_queue_tests() },
+        { "lockfree-mpsc-message-queue", lockfree_mpsc_message_queue_tests() },
         { "lockfree-set", lockfree_set_tests() },
+        { "array-set", array_set_tests() },
+        { "slot-set", slot_set_tests() },
+        { "hash-map", hash_map_tests() },
+        { "skip-list-map", skip_list_map_tests() },
         { "spmc-atom", spmc_atom_tests() },
+        { "waitfree-spmc-atom", waitfree_spmc_atom_tests() },
+        { "mpmc-atom", mpmc_atom_tests() },
         { "atom", atom_tests() },
         { "connections", connection_tests() },
         { "stream", stream_tests() },
+        { "shared-stream", shared_stream_tests() },
+        { "shared-state", shared_state_tests() },
         { "state", state_tests() },
+        { "state-group", state_group_tests() },
+        { "topic-bus", topic_bus_tests() },
         { "signal", signal_tests() },
         { "timer", timer_tests() },
         { "file", file_tests() },
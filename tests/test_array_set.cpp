@@ -0,0 +1,283 @@
+#include "../stitch/array_set.h"
+#include "../stitch/connections.h"
+#include "../stitch/state.h"
+#include "../testing/testing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace Testing;
+using namespace Stitch;
+using namespace std;
+
+namespace {
+
+struct Array_Set_Object
+{
+    int x = 0;
+};
+
+struct Array_Set_Value
+{
+    int x = 0;
+};
+
+}
+
+template <>
+struct Stitch::Connection_Traits<Array_Set_Object>
+{
+    template <typename E> using Set = Stitch::Array_Set<E>;
+};
+
+template <>
+struct Stitch::State_Traits<Array_Set_Value>
+{
+    template <typename E> using Observer_Set = Stitch::Array_Set<E>;
+};
+
+template <typename T>
+static vector<T> elements(Array_Set<T> & set)
+{
+    vector<T> result;
+    for (const T & v : set)
+        result.push_back(v);
+    sort(result.begin(), result.end());
+    return result;
+}
+
+static bool test_basic()
+{
+    Test test;
+
+    Array_Set<int> set;
+
+    test.assert("Set empty.", set.empty());
+    test.assert("Begin equals end.", !(set.begin() != set.end()));
+
+    for (int i = 0; i < 10; ++i)
+        set.insert(i);
+
+    // Repeat, to make sure set does not insert duplicates
+    for (int i = 0; i < 10; ++i)
+        set.insert(i);
+
+    test.assert("Set not empty.", !set.empty());
+    test.assert("Set has 10 elements.", elements(set) == vector<int>({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }));
+
+    for (int i : { 0, 4, 5, 3, 7 })
+        test.assert("Element " + to_string(i) + " removed.", set.remove(i));
+
+    test.assert("Element not removed twice.", !set.remove(4));
+
+    test.assert("Set has 5 elements.", elements(set) == vector<int>({ 1, 2, 6, 8, 9 }));
+    test.assert("Set contains 6.", set.contains(6));
+    test.assert("Set does not contain 7.", !set.contains(7));
+
+    set.clear();
+
+    test.assert("Set empty after clear.", set.empty());
+    test.assert("No elements after clear.", elements(set).empty());
+
+    return test.success();
+}
+
+static bool test_snapshot_iteration()
+{
+    Test test;
+
+    Array_Set<int> set;
+
+    for (int i = 0; i < 10; ++i)
+        set.insert(i);
+
+    vector<int> visited;
+
+    for (int i : set)
+    {
+        visited.push_back(i);
+
+        // Modifications do not affect ongoing iteration.
+        set.remove(i);
+        set.insert(i + 100);
+    }
+
+    test.assert("Visited all original elements.",
+                visited == vector<int>({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }));
+
+    test.assert("Set contains new elements.",
+                elements(set) == vector<int>({ 100, 101, 102, 103, 104, 105, 106, 107, 108, 109 }));
+
+    return test.success();
+}
+
+static bool test_reclamation()
+{
+    Test test;
+
+    static atomic<int> elem_count { 0 };
+
+    struct Element
+    {
+        int x;
+
+        Element(int x): x(x) { elem_count.fetch_add(1); }
+        Element(const Element & other): Element(other.x) {}
+        ~Element() { elem_count.fetch_sub(1); }
+        Element & operator=(const Element & other){ x = other.x; return *this; }
+        bool operator==(const Element & other) const { return x == other.x; }
+    };
+
+    {
+        Array_Set<Element> set;
+
+        for (int i = 0; i < 10; ++i)
+            set.insert(Element(i));
+
+        for (int i = 0; i < 5; ++i)
+            set.remove(Element(i));
+
+        Detail::Hazard_Pointers::clear();
+
+        test.assert("Element count 5: " + to_string(elem_count), elem_count == 5);
+    }
+
+    test.assert("Element count 0: " + to_string(elem_count), elem_count == 0);
+
+    return test.success();
+}
+
+static bool test_concurrent_modification()
+{
+    Test test;
+
+    Array_Set<int> set;
+
+    int thread_count = 4;
+    int range = 100;
+    atomic<bool> done { false };
+
+    thread reader([&]()
+    {
+        bool ok = true;
+        while(!done)
+        {
+            int count = 0;
+            for (int i : set)
+            {
+                if (i < 0 || i >= thread_count * range)
+                    ok = false;
+                ++count;
+            }
+            if (count > thread_count * range)
+                ok = false;
+        }
+        test.assert("Iteration sees valid elements.", ok);
+    });
+
+    auto modify = [&](int t)
+    {
+        for (int rep = 0; rep < 10; ++rep)
+        {
+            for (int i = 0; i < range; ++i)
+                set.insert(t * range + i);
+            for (int i = 1; i < range; i += 2)
+                set.remove(t * range + i);
+        }
+    };
+
+    vector<thread> threads;
+    for (int t = 0; t < thread_count; ++t)
+        threads.emplace_back(modify, t);
+    for (auto & t : threads)
+        t.join();
+
+    done = true;
+    reader.join();
+
+    vector<int> expected;
+    for (int i = 0; i < thread_count * range; i += 2)
+        expected.push_back(i);
+
+    test.assert("Set contains even values.", elements(set) == expected);
+
+    return test.success();
+}
+
+static bool test_connections()
+{
+    Test test;
+
+    Server<Array_Set_Object> server;
+    server->x = 5;
+
+    {
+        Client<Array_Set_Object> client1;
+        Client<Array_Set_Object> client2;
+
+        connect(client1, server);
+        connect(client2, server);
+
+        test.assert("Client 1 connected.", are_connected(client1, server));
+        test.assert("Client 2 connected.", are_connected(client2, server));
+
+        int count = 0;
+        for (auto & object : client1)
+        {
+            test.assert("Client sees shared object.", object.x == 5);
+            ++count;
+        }
+        test.assert("Client 1 has one connection.", count == 1);
+
+        disconnect(client1, server);
+
+        test.assert("Client 1 disconnected.", !are_connected(client1, server));
+        test.assert("Client 1 has no connections.", !client1.has_connections());
+        test.assert("Server has connections.", server.has_connections());
+    }
+
+    test.assert("Server has no connections.", !server.has_connections());
+
+    return test.success();
+}
+
+static bool test_state_observers()
+{
+    Test test;
+
+    State<Array_Set_Value> state;
+    State_Observer<Array_Set_Value> observer1;
+    State_Observer<Array_Set_Value> observer2;
+
+    observer1.connect(state);
+    observer2.connect(state);
+
+    state.store({ 3 });
+
+    test.assert("Observer 1 loads value.", observer1.load().x == 3);
+    test.assert("Observer 2 loads value.", observer2.load().x == 3);
+
+    observer1.disconnect();
+
+    state.store({ 4 });
+
+    test.assert("Observer 1 keeps default value.", observer1.load().x == 0);
+    test.assert("Observer 2 loads value.", observer2.load().x == 4);
+
+    return test.success();
+}
+
+Test_Set array_set_tests()
+{
+    return
+    {
+        { "basic", test_basic },
+        { "snapshot-iteration", test_snapshot_iteration },
+        { "reclamation", test_reclamation },
+        { "concurrent-modification", test_concurrent_modification },
+        { "connections", test_connections },
+        { "state-observers", test_state_observers },
+    };
+}
@@ -3,6 +3,7 @@
 
 #include <thread>
 #include <chrono>
+#include <memory>
 
 using namespace Stitch;
 using namespace Testing;
@@ -156,6 +157,39 @@ static bool test_multi_writer_multi_reader()
     return test.success();
 }
 
+static bool test_change_detection()
+{
+    Test test;
+
+    Atom<int> atom(1);
+    AtomWriter<int> writer(atom);
+    AtomReader<int> reader(atom);
+
+    test.assert("Changed before first load.", reader.changed());
+    test.assert("Version 0.", reader.version() == 0);
+
+    test.assert("Loaded if changed.", reader.load_if_changed());
+    test.assert("Loaded value.", reader.value() == 1);
+    test.assert("Not changed after load.", !reader.changed());
+    test.assert("Not loaded if not changed.", !reader.load_if_changed());
+
+    writer.store(2);
+
+    test.assert("Version 1.", reader.version() == 1);
+    test.assert("Changed after store.", reader.changed());
+    test.assert("Loaded if changed.", reader.load_if_changed());
+    test.assert("Loaded value.", reader.value() == 2);
+    test.assert("Not changed after load.", !reader.changed());
+
+    writer.update([](int & v){ v *= 10; });
+
+    test.assert("Changed after update.", reader.changed());
+    test.assert("Loaded value.", reader.load() == 20);
+    test.assert("Not changed after load.", !reader.changed());
+
+    return test.success();
+}
+
 static bool test_node_reclamation()
 {
     Test test;
@@ -201,7 +235,208 @@ static bool test_node_reclamation()
     return test.success();
 }
 
-static bool test_stress()
+static bool test_node_pool()
+{
+    Test test;
+
+    static atomic<int> value_count { 0 };
+
+    struct Value
+    {
+        Value() { value_count.fetch_add(1); }
+        Value(const Value &): Value() {}
+        Value & operator=(const Value &) = default;
+        ~Value() { value_count.fetch_sub(1); }
+    };
+
+    {
+        Atom<Value> atom(Value(), 2);
+
+        test.assert("Atom creates values for all nodes.", value_count == 3);
+
+        thread t([&]()
+        {
+            Value value;
+
+            {
+                AtomWriter<Value> writer(atom, value);
+                AtomReader<Value> reader(atom, value);
+                test.assert("Writer and reader use pooled nodes.", value_count == 4);
+
+                for (int i = 0; i < 5; ++i)
+                {
+                    writer.store();
+                    reader.load();
+                }
+
+                {
+                    AtomReader<Value> reader2(atom, value);
+                    test.assert("Reader beyond capacity allocates a node.", value_count == 5);
+                    reader2.load();
+                }
+
+                writer.store();
+                reader.load();
+            }
+
+            Detail::Hazard_Pointers::clear();
+
+            int count = value_count;
+
+            test.assert("Extra node is reclaimed or current.", count == 4 || count == 5);
+
+            {
+                AtomWriter<Value> writer(atom, value);
+                AtomReader<Value> reader(atom, value);
+                test.assert("Pooled nodes are reused.", value_count == count);
+            }
+        });
+
+        t.join();
+
+        test.assert("Value count after thread ends.", value_count == 3 || value_count == 4);
+    }
+
+    test.assert("Value count after atom destroyed.", value_count == 0);
+
+    return test.success();
+}
+
+static bool test_update()
+{
+    Test test;
+
+    struct Value
+    {
+        int a = 0;
+        int b = 0;
+    };
+
+    Atom<Value> atom;
+
+    int count = 10000;
+
+    auto update_a = [&]()
+    {
+        AtomWriter<Value> writer(atom);
+        for (int i = 0; i < count; ++i)
+            writer.update([](Value & v){ ++v.a; });
+    };
+
+    auto update_b = [&]()
+    {
+        AtomWriter<Value> writer(atom);
+        for (int i = 0; i < count; ++i)
+            writer.update([](Value & v){ ++v.b; });
+    };
+
+    thread writer1(update_a);
+    thread writer2(update_a);
+    thread writer3(update_b);
+
+    {
+        AtomReader<Value> reader(atom);
+        Value last;
+        bool ordered = true;
+        for (int i = 0; i < count; ++i)
+        {
+            const Value & v = reader.load();
+            if (v.a < last.a || v.b < last.b)
+                ordered = false;
+            last = v;
+        }
+        test.assert("Values never decrease.", ordered);
+    }
+
+    writer1.join();
+    writer2.join();
+    writer3.join();
+
+    AtomReader<Value> reader(atom);
+    const Value & v = reader.load();
+
+    test.assert("All updates of a applied: " + to_string(v.a), v.a == count * 2);
+    test.assert("All updates of b applied: " + to_string(v.b), v.b == count);
+
+    return test.success();
+}
+
+static bool test_history_multi_writer()
+{
+    Test test;
+
+    Atom<int> atom;
+    atom.keep_history(8);
+
+    int count = 10000;
+
+    // Each update increments the value, so values equal their versions.
+    auto increment = [&]()
+    {
+        AtomWriter<int> writer(atom);
+        for (int i = 0; i < count; ++i)
+        {
+            writer.update([](int & v){ ++v; });
+            if (i % 16 == 0)
+                this_thread::yield();
+        }
+    };
+
+    thread writer1(increment);
+    thread writer2(increment);
+
+    AtomReader<int> reader(atom);
+
+    uint64_t version = 0;
+    bool consistent = true;
+    bool ordered = true;
+
+    while (version < (uint64_t) count * 2)
+    {
+        uint64_t last = version;
+
+        version = reader.load_since(version, [&](const int & value, uint64_t v)
+        {
+            consistent &= uint64_t(value) == v;
+            ordered &= v > last;
+            last = v;
+        });
+
+        this_thread::yield();
+    }
+
+    writer1.join();
+    writer2.join();
+
+    test.assert("Values match their versions.", consistent);
+    test.assert("Versions increase.", ordered);
+
+    // Stores are also recorded in order of versions.
+    auto store = [&]()
+    {
+        AtomWriter<int> writer(atom);
+        for (int i = 0; i < count; ++i)
+            writer.store(-1);
+    };
+
+    thread writer3(store);
+    thread writer4(store);
+
+    writer3.join();
+    writer4.join();
+
+    test.assert("Version counts all stores: " + to_string(reader.version()),
+                reader.version() == (uint64_t) count * 4);
+
+    int replayed = 0;
+    reader.load_since(count * 4 - 8, [&](const int & value, uint64_t v){ ++replayed; });
+
+    test.assert("Replayed full history: " + to_string(replayed), replayed == 8);
+
+    return test.success();
+}
+
+static bool test_stress(int pool_capacity)
 {
     struct Value
     {
@@ -223,7 +458,8 @@ static bool test_stress()
 
     Test test;
 
-    Atom<Value> atom;
+    unique_ptr<Atom<Value>> atom_ptr(pool_capacity ? new Atom<Value>(Value(), pool_capacity) : new Atom<Value>());
+    Atom<Value> & atom = *atom_ptr;
 
     int transmitted_count = 0;
     int write_cycle_count = 0;
@@ -325,7 +561,12 @@ Test_Set atom_tests()
         { "basic-store-load", test_basic_store_load },
         { "single-writer-reader", test_single_writer_single_reader },
         { "multi-writer-reader", test_multi_writer_multi_reader },
+        { "change-detection", test_change_detection },
         { "node-reclamation", test_node_reclamation },
-        { "stress", test_stress },
+        { "node-pool", test_node_pool },
+        { "update", test_update },
+        { "history-multi-writer", test_history_multi_writer },
+        { "stress", []() { return test_stress(0); } },
+        { "stress-pooled", []() { return test_stress(3); } },
     };
 }
@@ -0,0 +1,203 @@
+#include "../stitch/atom_mpmc.h"
+#include "../testing/testing.h"
+
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+using namespace Stitch;
+using namespace Testing;
+using namespace std;
+
+namespace {
+
+struct Data
+{
+    int a = 1;
+    int b = 2;
+    int c = 3;
+};
+
+}
+
+static bool test_lockfree()
+{
+    Test test;
+    test.assert("Is lockfree.", MPMC_Atom<Data>::is_lockfree());
+    return test.success();
+}
+
+static bool test_basic()
+{
+    Test test;
+
+    {
+        MPMC_Atom<Data> atom;
+        auto data = atom.load();
+        test.assert("Correct default-constructed value.",
+                    data.a == 1 && data.b == 2 && data.c == 3);
+        test.assert("Version 0.", atom.version() == 0);
+    }
+
+    {
+        MPMC_Atom<Data> atom({ 3, 2, 1 });
+        auto data = atom.load();
+        test.assert("Correct initial value.",
+                    data.a == 3 && data.b == 2 && data.c == 1);
+    }
+
+    {
+        MPMC_Atom<Data> atom;
+        atom.store({ 4, 5, 6 });
+        auto data = atom.load();
+        test.assert("Correct stored and loaded value.",
+                    data.a == 4 && data.b == 5 && data.c == 6);
+        test.assert("Version 1.", atom.version() == 1);
+
+        atom.update([](Data & d){ d.a += 10; });
+        data = atom.load();
+        test.assert("Correct updated value.",
+                    data.a == 14 && data.b == 5 && data.c == 6);
+        test.assert("Version 2.", atom.version() == 2);
+    }
+
+    return test.success();
+}
+
+static bool test_update_throws()
+{
+    Test test;
+
+    MPMC_Atom<Data> atom({ 4, 5, 6 });
+
+    bool thrown = false;
+
+    try
+    {
+        atom.update([](Data & d)
+        {
+            d.a = 10;
+            throw std::runtime_error("update failed");
+        });
+    }
+    catch (std::runtime_error &)
+    {
+        thrown = true;
+    }
+
+    test.assert("Exception propagated.", thrown);
+
+    auto data = atom.load();
+    test.assert("Value unchanged.", data.a == 4 && data.b == 5 && data.c == 6);
+    test.assert("Version unchanged.", atom.version() == 0);
+
+    atom.store({ 7, 8, 9 });
+    data = atom.load();
+    test.assert("Value stored after exception.", data.a == 7 && data.b == 8 && data.c == 9);
+
+    atom.update([](Data & d){ d.a += 10; });
+    data = atom.load();
+    test.assert("Value updated after exception.", data.a == 17);
+
+    return test.success();
+}
+
+static bool test_concurrent_updates()
+{
+    Test test;
+
+    MPMC_Atom<Data> atom({ 0, 0, 0 });
+
+    int count = 20000;
+
+    auto update_a = [&]()
+    {
+        for (int i = 0; i < count; ++i)
+            atom.update([](Data & d){ ++d.a; });
+    };
+
+    auto update_b = [&]()
+    {
+        for (int i = 0; i < count; ++i)
+            atom.update([](Data & d){ ++d.b; });
+    };
+
+    thread w1(update_a);
+    thread w2(update_a);
+    thread w3(update_b);
+
+    w1.join();
+    w2.join();
+    w3.join();
+
+    auto data = atom.load();
+
+    test.assert("All updates of a applied: " + to_string(data.a), data.a == count * 2);
+    test.assert("All updates of b applied: " + to_string(data.b), data.b == count);
+
+    return test.success();
+}
+
+static bool test_stress()
+{
+    Test test;
+
+    MPMC_Atom<Data> atom({ 0, 0, 0 });
+
+    atomic<bool> work { true };
+
+    auto producer = [&](int start)
+    {
+        int i = start;
+        Data d;
+
+        while(work)
+        {
+            i += 2;
+            d.a = d.b = d.c = i;
+            atom.store(d);
+        }
+    };
+
+    auto consumer = [&]()
+    {
+        bool consistent = true;
+
+        while(work)
+        {
+            Data d = atom.load();
+            if (!(d.a == d.b && d.a == d.c))
+                consistent = false;
+        }
+
+        test.assert("a = b = c", consistent);
+    };
+
+    thread p1(producer, 0);
+    thread p2(producer, 1);
+    thread c1(consumer);
+    thread c2(consumer);
+
+    this_thread::sleep_for(chrono::milliseconds(500));
+
+    work = false;
+
+    p1.join();
+    p2.join();
+    c1.join();
+    c2.join();
+
+    return test.success();
+}
+
+Testing::Test_Set mpmc_atom_tests()
+{
+    return {
+        { "lockfree", test_lockfree },
+        { "basic", test_basic },
+        { "update-throws", test_update_throws },
+        { "concurrent-updates", test_concurrent_updates },
+        { "stress", test_stress },
+    };
+}
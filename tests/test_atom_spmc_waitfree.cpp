@@ -0,0 +1,152 @@
+#include "../stitch/atom_spmc_waitfree.h"
+#include "../testing/testing.h"
+
+#include <thread>
+#include <chrono>
+#include <vector>
+
+using namespace Stitch;
+using namespace Testing;
+using namespace std;
+
+namespace {
+
+struct Data
+{
+    int a = 1;
+    int b = 2;
+    int c = 3;
+};
+
+}
+
+static bool test_lockfree()
+{
+    Test test;
+    test.assert("Is lockfree.", Waitfree_SPMC_Atom<Data>::is_lockfree());
+    return test.success();
+}
+
+static bool test_basic()
+{
+    Test test;
+
+    {
+        Waitfree_SPMC_Atom<Data> atom;
+        auto data = atom.load();
+        test.assert("Correct default-constructed value.",
+                    data.a == 1 && data.b == 2 && data.c == 3);
+    }
+
+    {
+        Waitfree_SPMC_Atom<Data> atom({ 3, 2, 1 });
+        auto data = atom.load();
+        test.assert("Correct initial value.",
+                    data.a == 3 && data.b == 2 && data.c == 1);
+    }
+
+    {
+        Waitfree_SPMC_Atom<Data> atom;
+
+        for (int i = 0; i < 10; ++i)
+        {
+            bool ok = atom.store({ i, i + 1, i + 2 });
+            test.assert("Stored.", ok);
+            auto data = atom.load();
+            test.assert("Correct stored and loaded value.",
+                        data.a == i && data.b == i + 1 && data.c == i + 2);
+        }
+    }
+
+    return test.success();
+}
+
+static bool test_non_trivial_value()
+{
+    Test test;
+
+    Waitfree_SPMC_Atom<vector<int>> atom;
+
+    atom.store({ 1, 2, 3 });
+    atom.store({ 4, 5 });
+
+    auto value = atom.load();
+
+    test.assert("Correct value.", value == vector<int>({ 4, 5 }));
+
+    return test.success();
+}
+
+template <int R>
+static bool test_stress()
+{
+    Test test;
+
+    Waitfree_SPMC_Atom<Data, R> atom({ 0, 0, 0 });
+
+    atomic<bool> work { true };
+    atomic<int> failed_stores { 0 };
+
+    thread producer([&]()
+    {
+        int i = 0;
+        Data d;
+
+        while(work)
+        {
+            ++i;
+            d.a = d.b = d.c = i;
+            if (!atom.store(d))
+                ++failed_stores;
+        }
+    });
+
+    auto consumer = [&]()
+    {
+        Data d;
+        int last = 0;
+        bool consistent = true;
+        bool ordered = true;
+
+        while(work)
+        {
+            d = atom.load();
+            int v = d.a;
+            if (!(d.b == v && d.c == v))
+                consistent = false;
+            if (v < last)
+                ordered = false;
+            last = v;
+        }
+
+        test.assert("a = b = c", consistent);
+        test.assert("Values are ordered.", ordered);
+    };
+
+    vector<thread> consumers;
+    for (int i = 0; i < R; ++i)
+        consumers.emplace_back(consumer);
+
+    this_thread::sleep_for(chrono::milliseconds(500));
+
+    work = false;
+
+    producer.join();
+    for (auto & c : consumers)
+        c.join();
+
+    test.assert("No failed stores: " + to_string(failed_stores), failed_stores == 0);
+
+    return test.success();
+}
+
+Testing::Test_Set waitfree_spmc_atom_tests()
+{
+    return {
+        { "lockfree", test_lockfree },
+        { "basic", test_basic },
+        { "non-trivial-value", test_non_trivial_value },
+        { "stress-1-reader", test_stress<1> },
+        { "stress-3-readers", test_stress<3> },
+    };
+}
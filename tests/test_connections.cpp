@@ -2,6 +2,9 @@
 #include "../testing/testing.h"
 
 #include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
 
 using namespace Stitch;
 using namespace Testing;
@@ -148,6 +151,344 @@ static bool test_no_default_constructor()
     return true;
 }
 
+static bool test_disconnect()
+{
+    struct Data
+    {
+        int x = 0;
+    };
+
+    Test test;
+
+    Client<Data> client1;
+    Client<Data> client2;
+    Server<Data> server;
+
+    connect(client1, server);
+    connect(client1, client2);
+
+    test.assert("Client connected to server.", are_connected(client1, server));
+    test.assert("Clients connected.", are_connected(client1, client2) && are_connected(client2, client1));
+
+    disconnect(client1, server);
+
+    test.assert("Client disconnected from server.", !are_connected(client1, server));
+    test.assert("Server has no connections.", !server.has_connections());
+    test.assert("Clients still connected.", are_connected(client1, client2));
+
+    disconnect(client2, client1);
+
+    test.assert("Clients disconnected.", !are_connected(client1, client2) && !are_connected(client2, client1));
+    test.assert("Client 1 has no connections.", !client1.has_connections());
+    test.assert("Client 2 has no connections.", !client2.has_connections());
+
+    return test.success();
+}
+
+static bool test_destruction()
+{
+    struct Data
+    {
+        int x = 0;
+    };
+
+    Test test;
+
+    auto data = make_shared<Data>();
+
+    Server<Data> server;
+    Client<Data> client;
+
+    {
+        vector<unique_ptr<Client<Data>>> peers;
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            peers.push_back(make_unique<Client<Data>>());
+            connect(*peers.back(), server);
+            connect(*peers.back(), client, data);
+        }
+
+        test.assert("Server has connections.", server.has_connections());
+    }
+
+    test.assert("Server has no connections after peers destroyed.", !server.has_connections());
+    test.assert("Client has no connections after peers destroyed.", !client.has_connections());
+    test.assert("Shared object released: " + to_string(data.use_count()), data.use_count() == 1);
+
+    {
+        Server<Data> other_server;
+        connect(client, other_server);
+    }
+
+    test.assert("Client has no connections after server destroyed.", !client.has_connections());
+
+    return test.success();
+}
+
+static bool test_reserve()
+{
+    struct Data
+    {
+        int x = 0;
+    };
+
+    Test test;
+
+    Server<Data> server;
+    Client<Data> client;
+
+    server.reserve(10);
+    client.reserve(10);
+
+    // Replace all connections repeatedly, as when rewiring from a real-time thread.
+    for (int rep = 0; rep < 100; ++rep)
+    {
+        vector<unique_ptr<Server<Data>>> servers;
+        for (int i = 0; i < 5; ++i)
+        {
+            servers.push_back(make_unique<Server<Data>>());
+            connect(client, *servers.back());
+        }
+
+        connect(client, server);
+        disconnect(client, server);
+    }
+
+    test.assert("Client has no connections.", !client.has_connections());
+
+    return test.success();
+}
+
+static bool test_concurrent_rewiring()
+{
+    struct Data
+    {
+        atomic<int> x { 0 };
+    };
+
+    Test test;
+
+    Client<Data> client;
+    vector<unique_ptr<Server<Data>>> servers;
+    for (int i = 0; i < 8; ++i)
+        servers.push_back(make_unique<Server<Data>>());
+
+    atomic<bool> done { false };
+
+    // The client thread keeps using its connections...
+    thread user([&]()
+    {
+        while (!done)
+        {
+            for (auto & d : client)
+                ++d.x;
+            this_thread::yield();
+        }
+    });
+
+    // ...while another thread connects and disconnects servers.
+    for (int rep = 0; rep < 2000; ++rep)
+    {
+        auto & server = *servers[rep % servers.size()];
+        if (are_connected(client, server))
+            disconnect(client, server);
+        else
+            connect(client, server);
+    }
+
+    // Destroy servers while connected.
+    servers.clear();
+
+    done = true;
+    user.join();
+
+    test.assert("Client has no connections.", !client.has_connections());
+
+    return test.success();
+}
+
+static bool test_transaction()
+{
+    struct Data
+    {
+        int x = 0;
+    };
+
+    Test test;
+
+    Client<Data> client;
+    Client<Data> peer;
+    vector<unique_ptr<Server<Data>>> servers;
+    for (int i = 0; i < 10; ++i)
+        servers.push_back(make_unique<Server<Data>>());
+
+    auto count = [](Client<Data> & c)
+    {
+        int n = 0;
+        for (auto & d : c) { (void) d; ++n; }
+        return n;
+    };
+
+    Topology_Transaction<Data> transaction;
+
+    for (auto & server : servers)
+        transaction.connect(client, *server);
+    transaction.connect(client, peer);
+
+    test.assert("Nothing applied before commit.", !client.has_connections());
+
+    transaction.commit();
+
+    test.assert("Transaction empty after commit.", transaction.empty());
+    test.assert("Client connected.", count(client) == 11);
+    test.assert("Peer connected.", are_connected(peer, client) && count(peer) == 1);
+    test.assert("Server connected.", servers[0]->has_connections());
+
+    for (int i = 0; i < 5; ++i)
+        transaction.disconnect(client, *servers[i]);
+    transaction.disconnect(peer, client);
+    // Connecting and disconnecting in the same transaction cancels out.
+    transaction.connect(peer, *servers[0]);
+    transaction.disconnect(peer, *servers[0]);
+    transaction.commit();
+
+    test.assert("Client disconnected from some.", count(client) == 5);
+    test.assert("Disconnected servers.", !are_connected(client, *servers[0]) && !servers[0]->has_connections());
+    test.assert("Remaining servers.", are_connected(client, *servers[9]) && servers[9]->has_connections());
+    test.assert("Peer disconnected.", !are_connected(client, peer) && !peer.has_connections());
+
+    // Links created by a transaction are removed by their peers' destruction.
+    servers.clear();
+
+    test.assert("Client has no connections.", !client.has_connections());
+
+    return test.success();
+}
+
+static bool test_transaction_atomic()
+{
+    struct Data
+    {
+        int group = 0;
+    };
+
+    Test test;
+
+    int group_size = 8;
+
+    Client<Data> client;
+    vector<unique_ptr<Server<Data>>> groups[2];
+    for (int g = 0; g < 2; ++g)
+    {
+        for (int i = 0; i < group_size; ++i)
+        {
+            groups[g].push_back(make_unique<Server<Data>>());
+            (*groups[g].back())->group = g;
+        }
+    }
+
+    Topology_Transaction<Data> transaction;
+    for (auto & server : groups[0])
+        transaction.connect(client, *server);
+    transaction.commit();
+
+    atomic<bool> done { false };
+    atomic<int> torn { 0 };
+    atomic<int> iterations { 0 };
+
+    thread user([&]()
+    {
+        while (!done)
+        {
+            int counts[2] = { 0, 0 };
+            for (auto & d : client)
+                ++counts[d.group];
+
+            if (!((counts[0] == group_size && counts[1] == 0) ||
+                  (counts[0] == 0 && counts[1] == group_size)))
+                ++torn;
+
+            ++iterations;
+            this_thread::yield();
+        }
+    });
+
+    // Switch the client between the groups of servers.
+    for (int rep = 1; rep < 500 || iterations < 100; ++rep)
+    {
+        auto & from = groups[(rep + 1) % 2];
+        auto & to = groups[rep % 2];
+
+        for (int i = 0; i < group_size; ++i)
+        {
+            transaction.disconnect(client, *from[i]);
+            transaction.connect(client, *to[i]);
+        }
+
+        transaction.commit();
+    }
+
+    done = true;
+    user.join();
+
+    test.assert("No partial topology observed: " + to_string(torn), torn == 0);
+
+    return test.success();
+}
+
+static bool test_transaction_reserve()
+{
+    struct Data
+    {
+        int x = 0;
+    };
+
+    Test test;
+
+    Client<Data> client;
+    client.reserve(20);
+
+    vector<unique_ptr<Server<Data>>> servers;
+    for (int i = 0; i < 20; ++i)
+    {
+        servers.push_back(make_unique<Server<Data>>());
+        servers.back()->reserve(1);
+    }
+
+    auto count = [&]()
+    {
+        int n = 0;
+        for (auto & d : client) { (void) d; ++n; }
+        return n;
+    };
+
+    Topology_Transaction<Data> transaction;
+    transaction.reserve(10);
+
+    // Storage is reused by each commit, and grows if more changes are added than reserved.
+    for (int rep = 0; rep < 10; ++rep)
+    {
+        int size = rep < 5 ? 5 : 10;
+        int from = (rep % 2) * 10;
+        int to = ((rep + 1) % 2) * 10;
+
+        for (int i = 0; i < 10; ++i)
+        {
+            transaction.disconnect(client, *servers[from + i]);
+            if (i < size)
+                transaction.connect(client, *servers[to + i]);
+        }
+
+        transaction.commit();
+
+        test.assert("Connections replaced.", count() == size &&
+                    are_connected(client, *servers[to]) && !are_connected(client, *servers[from]));
+    }
+
+    return test.success();
+}
+
 Testing::Test_Set connection_tests()
 {
     return {
@@ -155,6 +496,13 @@ Testing::Test_Set connection_tests()
         { "single-server", test_single_server },
         { "multiple-servers", test_multiple_servers },
         { "no-default-constructor", test_no_default_constructor },
+        { "disconnect", test_disconnect },
+        { "destruction", test_destruction },
+        { "reserve", test_reserve },
+        { "concurrent-rewiring", test_concurrent_rewiring },
+        { "transaction", test_transaction },
+        { "transaction-atomic", test_transaction_atomic },
+        { "transaction-reserve", test_transaction_reserve },
     };
 }
 
@@ -1,13 +1,325 @@
 #include "../testing/testing.h"
+#include "../stitch/atom_spmc.h"
+#include "../stitch/atom_spmc_waitfree.h"
+#include "../stitch/atom_mpmc.h"
+#include "../stitch/atom.h"
+#include "../stitch/hash_map.h"
+#include "../stitch/skip_list_map.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 using namespace Testing;
+using namespace Stitch;
+using namespace std;
+
+namespace {
+
+struct Large_Value
+{
+    array<int, 256> data {};
+};
+
+// One writer stores continuously, while readers load for a fixed duration.
+// Reports load throughput and maximum load latency.
+template <typename Atom_Type>
+void benchmark_spmc_atom(const char * name, int reader_count)
+{
+    using clock = chrono::steady_clock;
+
+    Atom_Type atom;
+
+    atomic<bool> work { true };
+    atomic<long> load_count { 0 };
+    atomic<long> max_latency_ns { 0 };
+    long store_count = 0;
+
+    thread writer([&]()
+    {
+        Large_Value value;
+        while(work)
+        {
+            value.data.fill(++store_count);
+            atom.store(value);
+        }
+    });
+
+    vector<thread> readers;
+
+    for (int r = 0; r < reader_count; ++r)
+    {
+        readers.emplace_back([&]()
+        {
+            long count = 0;
+            long max_latency = 0;
+
+            while(work)
+            {
+                auto start = clock::now();
+                Large_Value value = atom.load();
+                auto end = clock::now();
+
+                if (value.data.front() != value.data.back())
+                    printf("Inconsistent value!\n");
+
+                long latency = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+                max_latency = std::max(max_latency, latency);
+                ++count;
+            }
+
+            load_count += count;
+
+            long current = max_latency_ns;
+            while (current < max_latency && !max_latency_ns.compare_exchange_weak(current, max_latency)) {}
+        });
+    }
+
+    this_thread::sleep_for(chrono::seconds(1));
+
+    work = false;
+
+    writer.join();
+    for (auto & reader : readers)
+        reader.join();
+
+    printf("%s, %d readers: %ld stores/s, %ld loads/s, max load latency %ld us\n",
+           name, reader_count, store_count, load_count.load(), max_latency_ns.load() / 1000);
+}
+
+bool benchmark_spmc_atoms()
+{
+    for (int readers : { 1, 3 })
+    {
+        benchmark_spmc_atom<SPMC_Atom<Large_Value>>("SPMC_Atom", readers);
+        if (readers == 1)
+            benchmark_spmc_atom<Waitfree_SPMC_Atom<Large_Value, 1>>("Waitfree_SPMC_Atom", readers);
+        else
+            benchmark_spmc_atom<Waitfree_SPMC_Atom<Large_Value, 3>>("Waitfree_SPMC_Atom", readers);
+    }
+
+    return true;
+}
+
+struct Small_Value
+{
+    array<int, 16> data {};
+};
+
+// Two writers store continuously, while two readers load for a fixed duration.
+// Reports load throughput.
+// 'Store' and 'Load' are called with the atom and create per-thread accessors.
+template <typename Atom_Type, typename Store, typename Load>
+void benchmark_mpmc_atom(const char * name, Store store, Load load)
+{
+    Atom_Type atom;
+
+    atomic<bool> work { true };
+    atomic<long> load_count { 0 };
+
+    vector<thread> threads;
+
+    for (int w = 0; w < 2; ++w)
+        threads.emplace_back([&]() { store(atom, work); });
+
+    for (int r = 0; r < 2; ++r)
+        threads.emplace_back([&]() { load_count += load(atom, work); });
+
+    this_thread::sleep_for(chrono::seconds(1));
+
+    work = false;
+
+    for (auto & t : threads)
+        t.join();
+
+    printf("%s, 2 writers, 2 readers: %ld loads/s\n", name, load_count.load());
+}
+
+bool benchmark_mpmc_atoms()
+{
+    benchmark_mpmc_atom<MPMC_Atom<Small_Value>>("MPMC_Atom",
+    [](MPMC_Atom<Small_Value> & atom, atomic<bool> & work)
+    {
+        Small_Value value;
+        while(work)
+        {
+            value.data.fill(value.data[0] + 1);
+            atom.store(value);
+        }
+    },
+    [](MPMC_Atom<Small_Value> & atom, atomic<bool> & work)
+    {
+        long count = 0;
+        while(work)
+        {
+            Small_Value value = atom.load();
+            if (value.data.front() != value.data.back())
+                printf("Inconsistent value!\n");
+            ++count;
+        }
+        return count;
+    });
+
+    benchmark_mpmc_atom<Atom<Small_Value>>("Atom",
+    [](Atom<Small_Value> & atom, atomic<bool> & work)
+    {
+        AtomWriter<Small_Value> writer(atom);
+        Small_Value value;
+        while(work)
+        {
+            value.data.fill(value.data[0] + 1);
+            writer.store(value);
+        }
+    },
+    [](Atom<Small_Value> & atom, atomic<bool> & work)
+    {
+        AtomReader<Small_Value> reader(atom);
+        long count = 0;
+        while(work)
+        {
+            const Small_Value & value = reader.load();
+            if (value.data.front() != value.data.back())
+                printf("Inconsistent value!\n");
+            ++count;
+        }
+        return count;
+    });
+
+    return true;
+}
+
+// Threads look up random keys for a fixed duration,
+// and one in 'update_ratio' operations erases and inserts a key instead.
+// Reports operation throughput.
+template <typename Map>
+void benchmark_map(const char * name, int thread_count, int update_ratio)
+{
+    static constexpr int Key_Count = 10000;
+
+    Map map;
+
+    for (int i = 0; i < Key_Count; i += 2)
+        map.insert(i, i);
+
+    atomic<bool> work { true };
+    atomic<long> op_count { 0 };
+
+    vector<thread> threads;
+
+    for (int t = 0; t < thread_count; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            uint32_t random = t + 1;
+            long count = 0;
+
+            while(work)
+            {
+                random = random * 1664525 + 1013904223;
+                int key = (random >> 8) % Key_Count;
+
+                if ((random >> 4) % update_ratio == 0)
+                {
+                    if (!map.erase(key))
+                        map.insert(key, key);
+                }
+                else
+                {
+                    int value;
+                    map.find(key, value);
+                }
+
+                ++count;
+            }
+
+            op_count += count;
+        });
+    }
+
+    this_thread::sleep_for(chrono::seconds(1));
+
+    work = false;
+
+    for (auto & t : threads)
+        t.join();
+
+    printf("%s, %d threads, 1/%d updates: %ld ops/s\n", name, thread_count, update_ratio, op_count.load());
+}
+
+// std::map or std::unordered_map protected by a mutex, with the interface of Hash_Map.
+template <typename Map>
+class Mutex_Map
+{
+public:
+    bool insert(int key, int value)
+    {
+        lock_guard<mutex> lock(d_mutex);
+        return d_map.emplace(key, value).second;
+    }
+
+    bool erase(int key)
+    {
+        lock_guard<mutex> lock(d_mutex);
+        return d_map.erase(key) > 0;
+    }
+
+    bool find(int key, int & value)
+    {
+        lock_guard<mutex> lock(d_mutex);
+        auto it = d_map.find(key);
+        if (it == d_map.end())
+            return false;
+        value = it->second;
+        return true;
+    }
+
+private:
+    mutex d_mutex;
+    Map d_map;
+};
+
+bool benchmark_hash_maps()
+{
+    for (int threads : { 1, 4 })
+    {
+        for (int update_ratio : { 10, 1000 })
+        {
+            benchmark_map<Hash_Map<int,int>>("Hash_Map", threads, update_ratio);
+            benchmark_map<Mutex_Map<unordered_map<int,int>>>("std::unordered_map + mutex", threads, update_ratio);
+        }
+    }
+
+    return true;
+}
+
+bool benchmark_ordered_maps()
+{
+    for (int threads : { 1, 2, 4, 8 })
+    {
+        benchmark_map<Skip_List_Map<int,int>>("Skip_List_Map", threads, 10);
+        benchmark_map<Mutex_Map<map<int,int>>>("std::map + mutex", threads, 10);
+    }
+
+    return true;
+}
+
+}
 
 int main(int argc, char * argv[])
 {
     Testing::Test_Set tests = {
+        { "benchmark-spmc-atom", benchmark_spmc_atoms },
+        { "benchmark-mpmc-atom", benchmark_mpmc_atoms },
+        { "benchmark-hash-map", benchmark_hash_maps },
+        { "benchmark-ordered-map", benchmark_ordered_maps },
     };
 
     return Testing::run(tests, argc, argv);
 }
-
-
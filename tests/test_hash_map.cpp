@@ -0,0 +1,332 @@
+#include "../stitch/hash_map.h"
+#include "../testing/testing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace Testing;
+using namespace Stitch;
+using namespace std;
+
+namespace {
+
+// Makes all keys collide in a single bucket.
+struct Constant_Hash
+{
+    size_t operator()(int) const { return 7; }
+};
+
+// Counts live instances, to check reclamation.
+struct Counted
+{
+    static atomic<int> count;
+
+    Counted() { ++count; }
+    Counted(const Counted &) { ++count; }
+    ~Counted() { --count; }
+    Counted & operator=(const Counted &) = default;
+};
+
+atomic<int> Counted::count { 0 };
+
+}
+
+template <typename M>
+static vector<pair<int,int>> entries(M & map)
+{
+    vector<pair<int,int>> result;
+    for (auto & entry : map)
+        result.emplace_back(entry.first, entry.second);
+    sort(result.begin(), result.end());
+    return result;
+}
+
+static bool test_basic()
+{
+    Test test;
+
+    Hash_Map<int, int> map;
+
+    test.assert("Map empty.", map.empty());
+    test.assert("Begin equals end.", !(map.begin() != map.end()));
+
+    for (int i = 0; i < 10; ++i)
+        test.assert("Key " + to_string(i) + " inserted.", map.insert(i, i * 10));
+
+    test.assert("Key not inserted twice.", !map.insert(3, 0));
+
+    test.assert("Map has 10 elements.", map.size() == 10);
+
+    int value = -1;
+    test.assert("Key 3 found.", map.find(3, value));
+    test.assert("Value of key 3 not replaced.", value == 30);
+    test.assert("Key 10 not found.", !map.find(10, value));
+
+    for (int i : { 0, 4, 5, 3, 7 })
+        test.assert("Key " + to_string(i) + " erased.", map.erase(i));
+
+    test.assert("Key not erased twice.", !map.erase(4));
+
+    test.assert("Map has 5 elements.", map.size() == 5);
+    test.assert("Map contains 6.", map.contains(6));
+    test.assert("Map does not contain 7.", !map.contains(7));
+
+    test.assert("Entries.", entries(map) == vector<pair<int,int>>({ {1,10}, {2,20}, {6,60}, {8,80}, {9,90} }));
+
+    return test.success();
+}
+
+static bool test_string_keys()
+{
+    Test test;
+
+    Hash_Map<string, int> map;
+
+    map.insert("one", 1);
+    map.insert("two", 2);
+
+    int value = 0;
+    test.assert("Found 'two'.", map.find("two", value) && value == 2);
+    test.assert("Did not find 'three'.", !map.contains("three"));
+
+    return test.success();
+}
+
+static bool test_growth()
+{
+    Test test;
+
+    Hash_Map<int, int> map;
+
+    int count = 100000;
+
+    for (int i = 0; i < count; ++i)
+        map.insert(i, -i);
+
+    test.assert("Map size.", map.size() == count);
+
+    bool all_found = true;
+    for (int i = 0; i < count; ++i)
+    {
+        int value;
+        all_found &= map.find(i, value) && value == -i;
+    }
+
+    test.assert("All keys found.", all_found);
+
+    int visited = 0;
+    for (auto & entry : map)
+    {
+        (void) entry;
+        ++visited;
+    }
+
+    test.assert("All entries visited: " + to_string(visited), visited == count);
+
+    for (int i = 0; i < count; i += 2)
+        map.erase(i);
+
+    test.assert("Half erased.", map.size() == count / 2);
+    test.assert("Odd key remains.", map.contains(count - 1));
+    test.assert("Even key erased.", !map.contains(count - 2));
+
+    return test.success();
+}
+
+static bool test_collisions()
+{
+    Test test;
+
+    Hash_Map<int, int, Constant_Hash> map;
+
+    for (int i = 0; i < 20; ++i)
+        map.insert(i, i);
+
+    test.assert("Duplicate not inserted.", !map.insert(5, 0));
+
+    for (int i = 0; i < 20; i += 3)
+        map.erase(i);
+
+    vector<pair<int,int>> expected;
+    for (int i = 0; i < 20; ++i)
+    {
+        if (i % 3)
+            expected.emplace_back(i, i);
+    }
+
+    test.assert("Entries.", entries(map) == expected);
+
+    return test.success();
+}
+
+static bool test_erase_during_iteration()
+{
+    Test test;
+
+    Hash_Map<int, int> map;
+
+    for (int i = 0; i < 100; ++i)
+        map.insert(i, i);
+
+    vector<int> visited;
+
+    for (auto & entry : map)
+    {
+        visited.push_back(entry.first);
+        // Erase the current and some other element.
+        map.erase(entry.first);
+        map.erase((entry.first + 50) % 100);
+    }
+
+    sort(visited.begin(), visited.end());
+
+    test.assert("Elements visited at most once.",
+                adjacent_find(visited.begin(), visited.end()) == visited.end());
+    test.assert("Map empty.", map.empty() && !(map.begin() != map.end()));
+
+    return test.success();
+}
+
+static bool test_erase_colliding_during_iteration()
+{
+    Test test;
+
+    Hash_Map<int, int, Constant_Hash> map;
+
+    for (int i = 0; i < 20; ++i)
+        map.insert(i, i);
+
+    vector<int> visited;
+
+    // Erasing the current element makes the iterator restart,
+    // and it must resume among the elements with equal hash.
+    for (auto & entry : map)
+    {
+        visited.push_back(entry.first);
+        map.erase(entry.first);
+    }
+
+    sort(visited.begin(), visited.end());
+
+    vector<int> expected;
+    for (int i = 0; i < 20; ++i)
+        expected.push_back(i);
+
+    test.assert("Each element visited once.", visited == expected);
+
+    return test.success();
+}
+
+static bool test_reclamation()
+{
+    Test test;
+
+    {
+        Hash_Map<int, Counted> map;
+
+        for (int i = 0; i < 100; ++i)
+            map.insert(i, Counted());
+
+        test.assert("Values alive.", Counted::count == 100);
+
+        for (int i = 0; i < 50; ++i)
+            map.erase(i);
+
+        Detail::Hazard_Pointers::clear();
+
+        test.assert("Erased values reclaimed: " + to_string(Counted::count), Counted::count == 50);
+    }
+
+    test.assert("Values destroyed with map.", Counted::count == 0);
+
+    return test.success();
+}
+
+static bool test_concurrent_modification()
+{
+    Test test;
+
+    Hash_Map<int, int> map;
+
+    int thread_count = 4;
+    int range = 1000;
+
+    auto modify = [&](int t)
+    {
+        // Each thread inserts its own range several times
+        // and then erases odd keys.
+        for (int rep = 0; rep < 10; ++rep)
+        {
+            for (int i = 0; i < range; ++i)
+                map.insert(t * range + i, t);
+            for (int i = 1; i < range; i += 2)
+                map.erase(t * range + i);
+        }
+    };
+
+    vector<thread> threads;
+    for (int t = 0; t < thread_count; ++t)
+        threads.emplace_back(modify, t);
+    for (auto & t : threads)
+        t.join();
+
+    vector<pair<int,int>> expected;
+    for (int i = 0; i < thread_count * range; i += 2)
+        expected.emplace_back(i, i / range);
+
+    test.assert("Map contains even keys.", entries(map) == expected);
+    test.assert("Map size.", map.size() == (int) expected.size());
+
+    return test.success();
+}
+
+static bool test_concurrent_duplicates()
+{
+    Test test;
+
+    Hash_Map<int, int> map;
+
+    int thread_count = 4;
+    int range = 1000;
+    atomic<int> inserted { 0 };
+
+    // All threads insert the same keys.
+    auto insert = [&](int t)
+    {
+        for (int i = 0; i < range; ++i)
+        {
+            if (map.insert(i, t))
+                ++inserted;
+        }
+    };
+
+    vector<thread> threads;
+    for (int t = 0; t < thread_count; ++t)
+        threads.emplace_back(insert, t);
+    for (auto & t : threads)
+        t.join();
+
+    test.assert("Each key inserted once: " + to_string(inserted), inserted == range);
+    test.assert("Map size.", map.size() == range);
+
+    return test.success();
+}
+
+Test_Set hash_map_tests()
+{
+    return {
+        { "basic", test_basic },
+        { "string-keys", test_string_keys },
+        { "growth", test_growth },
+        { "collisions", test_collisions },
+        { "erase-during-iteration", test_erase_during_iteration },
+        { "erase-colliding-during-iteration", test_erase_colliding_during_iteration },
+        { "reclamation", test_reclamation },
+        { "concurrent-modification", test_concurrent_modification },
+        { "concurrent-duplicates", test_concurrent_duplicates },
+    };
+}
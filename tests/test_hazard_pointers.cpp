@@ -1,6 +1,7 @@
 #include "../stitch/hazard_pointers.h"
 #include "../testing/testing.h"
 
+#include <atomic>
 #include <string>
 #include <thread>
 #include <vector>
@@ -211,12 +212,99 @@ bool test_reclaim_reentrant()
     return true;
 }
 
+bool test_thread_cache()
+{
+    Test test;
+
+    auto & hp1 = Hazard_Pointers::acquire<int>();
+    int one = 1;
+    hp1.pointer = &one;
+    hp1.release();
+
+    test.assert("Released pointer cleared.", hp1.pointer == nullptr);
+
+    auto & hp2 = Hazard_Pointers::acquire<int>();
+    test.assert("Released slot reused by same thread.", &hp2 == &hp1);
+
+    bool other_thread_got_slot = false;
+    thread t([&]()
+    {
+        auto & hp3 = Hazard_Pointers::acquire<int>();
+        other_thread_got_slot = &hp3 == &hp2;
+        hp3.release();
+    });
+    t.join();
+
+    test.assert("Slot in use not given to other thread.", !other_thread_got_slot);
+
+    hp2.release();
+
+    return test.success();
+}
+
+bool test_thread_cache_not_reserved()
+{
+    Test test;
+
+    // Enough threads to fill the whole array with their caches,
+    // if cached slots were reserved.
+    int thread_count = Hazard_Pointers::H / Hazard_Pointers::Cache_Size + 1;
+
+    atomic<int> ready { 0 };
+    atomic<bool> done { false };
+
+    vector<thread> threads;
+
+    for (int t = 0; t < thread_count; ++t)
+    {
+        threads.emplace_back([&]()
+        {
+            vector<Hazard_Pointer<int>*> hps;
+            for (int i = 0; i < Hazard_Pointers::Cache_Size; ++i)
+                hps.push_back(&Hazard_Pointers::acquire<int>());
+            for (auto * hp : hps)
+                hp->release();
+
+            ready.fetch_add(1);
+
+            while (!done)
+                this_thread::yield();
+        });
+    }
+
+    while (ready < thread_count)
+        this_thread::yield();
+
+    vector<Hazard_Pointer<int>*> hps;
+
+    try
+    {
+        for (int i = 0; i < Hazard_Pointers::H; ++i)
+            hps.push_back(&Hazard_Pointers::acquire<int>());
+    }
+    catch (std::runtime_error &) {}
+
+    test.assert("All slots acquired: " + to_string(hps.size()), hps.size() == Hazard_Pointers::H);
+
+    for (auto * hp : hps)
+        hp->release();
+
+    done = true;
+
+    for (auto & t : threads)
+        t.join();
+
+    return test.success();
+}
+
 Test_Set hazard_pointers_tests()
 {
     return {
         { "stress-allocation", test_stress_allocation },
         { "reclamation", test_reclamation },
         { "over-allocation", test_over_allocation },
+        { "thread-cache", test_thread_cache },
+        { "thread-cache-not-reserved", test_thread_cache_not_reserved },
         { "stress-reclamation", test_stress_reclamation },
         { "reclaim-reentrant", test_reclaim_reentrant },
     };
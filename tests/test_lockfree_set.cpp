@@ -6,6 +6,8 @@
 #include <thread>
 #include <sstream>
 #include <memory>
+#include <algorithm>
+#include <vector>
 
 using namespace Testing;
 using namespace Stitch;
@@ -26,6 +28,43 @@ static bool test_empty()
     return test.success();
 }
 
+static bool test_iteration_without_hazard_pointers()
+{
+    using Detail::Hazard_Pointers;
+    using Detail::Hazard_Pointer;
+
+    Test test;
+
+    Set<int> set;
+
+    // Use up all hazard pointers.
+    vector<Hazard_Pointer<int>*> hps;
+    for (int i = 0; i < Hazard_Pointers::H; ++i)
+        hps.push_back(&Hazard_Pointers::acquire<int>());
+
+    bool iterated = false;
+
+    try
+    {
+        int count = 0;
+        for (int v : set)
+        {
+            (void) v;
+            ++count;
+        }
+        iterated = count == 0;
+    }
+    catch (std::runtime_error &)
+    {}
+
+    test.assert("Empty set iterated without hazard pointers.", iterated);
+
+    for (auto * hp : hps)
+        hp->release();
+
+    return test.success();
+}
+
 static bool test_contains()
 {
     Test test;
@@ -279,6 +318,91 @@ static bool test_destructor()
     return test.success();
 }
 
+static bool test_concurrent_modification()
+{
+    Test test;
+
+    Set<int> set;
+
+    int thread_count = 4;
+    int range = 200;
+
+    auto modify = [&](int t)
+    {
+        // Each thread inserts its own range several times
+        // and then removes odd values.
+        for (int rep = 0; rep < 20; ++rep)
+        {
+            for (int i = 0; i < range; ++i)
+                set.insert(t * range + i);
+            for (int i = 1; i < range; i += 2)
+                set.remove(t * range + i);
+        }
+    };
+
+    vector<thread> threads;
+    for (int t = 0; t < thread_count; ++t)
+        threads.emplace_back(modify, t);
+    for (auto & t : threads)
+        t.join();
+
+    vector<int> elements;
+    for (int i : set)
+        elements.push_back(i);
+
+    sort(elements.begin(), elements.end());
+
+    vector<int> expected;
+    for (int i = 0; i < thread_count * range; i += 2)
+        expected.push_back(i);
+
+    test.assert("Set contains even values: " + to_string(elements.size()), elements == expected);
+
+    return test.success();
+}
+
+static bool test_concurrent_duplicates()
+{
+    Test test;
+
+    Set<int> set;
+
+    int value_count = 100;
+
+    auto insert = [&]()
+    {
+        for (int i = 0; i < value_count; ++i)
+            set.insert(i);
+    };
+
+    thread t1(insert);
+    thread t2(insert);
+    thread t3(insert);
+
+    t1.join();
+    t2.join();
+    t3.join();
+
+    vector<int> elements;
+    for (int i : set)
+        elements.push_back(i);
+
+    sort(elements.begin(), elements.end());
+
+    vector<int> expected;
+    for (int i = 0; i < value_count; ++i)
+        expected.push_back(i);
+
+    test.assert("Each value is in set once.", elements == expected);
+
+    for (int i = 0; i < value_count; ++i)
+        test.assert("Removed " + to_string(i), set.remove(i));
+
+    test.assert("Set is empty.", set.empty());
+
+    return test.success();
+}
+
 static bool test_stress()
 {
     Test test;
@@ -367,9 +491,12 @@ Test_Set lockfree_set_tests()
         { "empty", test_empty },
         { "contains", test_contains },
         { "iteration", test_iteration },
+        { "iteration-without-hazard-pointers", test_iteration_without_hazard_pointers },
         { "removal-during-iteration", test_removal_during_iteration },
         { "destructor", test_destructor },
         { "reclamation", test_reclamation },
+        { "concurrent-modification", test_concurrent_modification },
+        { "concurrent-duplicates", test_concurrent_duplicates },
         // FIXME: This test is flaky - see comment in test_stress.
         // { "stress", test_stress },
     };
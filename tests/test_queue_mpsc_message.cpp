@@ -0,0 +1,308 @@
+#include "../stitch/queue_mpsc_message.h"
+#include "../stitch/streams.h"
+#include "../testing/testing.h"
+
+#include <string>
+#include <thread>
+#include <chrono>
+
+using namespace Stitch;
+using namespace std;
+
+struct Message
+{
+    int id;
+    double value;
+};
+
+static bool test()
+{
+    Testing::Test test;
+
+    test.assert("Lockfree.", Lockfree_MPSC_Message_Queue::is_lockfree());
+
+    Lockfree_MPSC_Message_Queue q(256);
+
+    test.assert("Empty.", q.empty());
+
+    for (int rep = 0; rep < 10; ++rep)
+    {
+        // Messages of different sizes, making the ring wrap around.
+
+        vector<string> input;
+        for (int i = 0; i < 4; ++i)
+            input.push_back(string(rep * 3 + i, 'a' + i));
+
+        for (auto & text : input)
+        {
+            bool ok = q.push(text.data(), text.size());
+            test.assert("Pushed.", ok);
+        }
+
+        for (auto & text : input)
+        {
+            int size = -1;
+            const void * data = q.front(size);
+            test.assert_critical("Got front.", data != nullptr);
+            test.assert("Size = " + to_string(size), size == (int) text.size());
+            test.assert("Data.", string((const char*) data, size) == text);
+            test.assert("Popped.", q.pop());
+        }
+
+        test.assert("Empty.", q.empty());
+        test.assert("Can't pop when empty.", !q.pop());
+    }
+
+    return test.success();
+}
+
+static bool test_reserve_commit()
+{
+    Testing::Test test;
+
+    Lockfree_MPSC_Message_Queue q(256);
+
+    void * m1 = q.reserve(10);
+    void * m2 = q.reserve(20);
+
+    test.assert_critical("Reserved.", m1 && m2);
+    test.assert("Aligned.", uintptr_t(m1) % 8 == 0 && uintptr_t(m2) % 8 == 0);
+
+    memset(m1, 1, 10);
+    memset(m2, 2, 20);
+
+    q.commit(m2);
+
+    test.assert("Second message blocked by first.", q.empty());
+
+    q.commit(m1);
+
+    int size;
+    const char * data;
+
+    data = (const char*) q.front(size);
+    test.assert_critical("Got first.", data != nullptr);
+    test.assert("First size.", size == 10);
+    test.assert("First data.", data[0] == 1 && data[9] == 1);
+    q.pop();
+
+    data = (const char*) q.front(size);
+    test.assert_critical("Got second.", data != nullptr);
+    test.assert("Second size.", size == 20);
+    test.assert("Second data.", data[0] == 2 && data[19] == 2);
+    q.pop();
+
+    test.assert("Empty.", q.empty());
+
+    return test.success();
+}
+
+static bool test_full()
+{
+    Testing::Test test;
+
+    Lockfree_MPSC_Message_Queue q(128);
+
+    test.assert("Capacity.", q.capacity() == 128);
+
+    test.assert("Too large message.", q.reserve(128) == nullptr);
+
+    int count = 0;
+    while(q.push(Message { count, 0 }))
+        ++count;
+
+    // Each message takes 8 bytes of header and 16 bytes of data.
+    test.assert("Pushed " + to_string(count), count == 128 / 24);
+
+    Message m;
+    test.assert("Popped.", q.pop(m));
+    test.assert("Can push after pop.", q.push(Message { count, 0 }));
+
+    return test.success();
+}
+
+static bool test_typed()
+{
+    Testing::Test test;
+
+    Lockfree_MPSC_Message_Queue q(200);
+
+    for (int rep = 0; rep < 10; ++rep)
+    {
+        for (int i = 0; i < 5; ++i)
+            test.assert("Pushed.", q.push(Message { i, i * 0.5 }));
+
+        for (int i = 0; i < 5; ++i)
+        {
+            Message m;
+            bool ok = q.pop(m);
+            test.assert("Popped.", ok);
+            if (ok)
+                test.assert("Popped " + to_string(m.id), m.id == i && m.value == i * 0.5);
+        }
+    }
+
+    return test.success();
+}
+
+static bool test_bulk()
+{
+    Testing::Test test;
+
+    Lockfree_MPSC_Message_Queue q(256);
+
+    for (int rep = 0; rep < 10; ++rep)
+    {
+        int count = 7;
+
+        {
+            vector<int> data(count);
+            for(int i = 0; i < count; ++i)
+                data[i] = i + rep;
+
+            bool pushed = q.push(count, data.begin());
+            test.assert("Pushed.", pushed);
+        }
+
+        {
+            vector<int> data(count + 1);
+            test.assert("Can't pop more than available.", !q.pop(count + 1, data.begin()));
+        }
+
+        {
+            vector<int> data(count);
+
+            bool popped = q.pop(count, data.begin());
+            test.assert("Popped.", popped);
+
+            for (int i = 0; i < count; ++i)
+                test.assert("Got " + to_string(data[i]), data[i] == i + rep);
+        }
+
+        test.assert("Queue is empty.", q.empty());
+    }
+
+    return test.success();
+}
+
+static bool test_stream()
+{
+    Testing::Test test;
+
+    using Queue = Lockfree_MPSC_Message_Queue;
+
+    Stream_Producer<Message, Queue> source;
+    Stream_Consumer<Message, Queue> sink(1024);
+
+    connect(source, sink);
+
+    source.push(Message { 1, 1.5 });
+
+    string text("hello");
+    source.push(text.data(), text.size());
+
+    Message m;
+    test.assert("Popped typed.", sink.pop(m));
+    test.assert("Typed value.", m.id == 1 && m.value == 1.5);
+
+    int size;
+    const void * data = sink.front(size);
+    test.assert_critical("Got message.", data != nullptr);
+    test.assert("Message.", string((const char*) data, size) == text);
+    test.assert("Popped message.", sink.pop());
+
+    test.assert("Empty.", sink.empty());
+
+    return test.success();
+}
+
+static bool stress_test()
+{
+    Testing::Test test;
+
+    Lockfree_MPSC_Message_Queue q(1000);
+
+    atomic<bool> quit { false };
+
+    // Each producer pushes messages with its id and a counter,
+    // with varying size.
+    auto producer = ([&](int id)
+    {
+        uint8_t v = 0;
+        uint8_t buffer[64];
+
+        while(!quit)
+        {
+            int size = 2 + (v % 60);
+            void * m = q.reserve(size);
+            if (!m)
+            {
+                this_thread::yield();
+                continue;
+            }
+
+            buffer[0] = id;
+            buffer[1] = v;
+            for (int i = 2; i < size; ++i)
+                buffer[i] = v;
+
+            memcpy(m, buffer, size);
+            q.commit(m);
+
+            ++v;
+        }
+    });
+
+    thread p1(producer, 0);
+    thread p2(producer, 1);
+
+    uint8_t expected[2] = { 0, 0 };
+    int count = 0;
+    bool ok = true;
+
+    auto start = chrono::steady_clock::now();
+
+    while(ok && chrono::steady_clock::now() - start < chrono::seconds(3))
+    {
+        int size;
+        const uint8_t * m;
+        while(ok && (m = (const uint8_t*) q.front(size)))
+        {
+            int id = m[0];
+            uint8_t v = m[1];
+
+            ok &= id == 0 || id == 1;
+            ok &= v == expected[id];
+            ok &= size == 2 + (v % 60);
+            for (int i = 2; i < size; ++i)
+                ok &= m[i] == v;
+
+            expected[id] = v + 1;
+            ++count;
+
+            q.pop();
+        }
+    }
+
+    quit = true;
+
+    p1.join();
+    p2.join();
+
+    test.assert("Received " + to_string(count) + " messages in order and intact.", ok);
+
+    return test.success();
+}
+
+Testing::Test_Set lockfree_mpsc_message_queue_tests()
+{
+    return {
+        { "test", test },
+        { "reserve-commit", test_reserve_commit },
+        { "full", test_full },
+        { "typed", test_typed },
+        { "bulk", test_bulk },
+        { "stream", test_stream },
+        { "stress", stress_test },
+    };
+}
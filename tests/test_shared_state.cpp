@@ -0,0 +1,226 @@
+#include "../stitch/shared_state.h"
+#include "../testing/testing.h"
+
+#include <thread>
+#include <chrono>
+#include <string>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace Stitch;
+using namespace Testing;
+using namespace std;
+
+namespace {
+
+struct Pair
+{
+    int64_t a = 0;
+    int64_t b = 0;
+};
+
+}
+
+static string socket_path()
+{
+    return "/tmp/stitch-state-test-" + to_string(getpid()) + ".socket";
+}
+
+static bool is_active(const Event & e)
+{
+    pollfd p { e.fd, e.poll_events, 0 };
+    return poll(&p, 1, 0) == 1;
+}
+
+template <typename T, typename U>
+static void connect(Shared_State<T> & state, Shared_State_Observer<U> & observer)
+{
+    thread connector([&](){
+        try { observer.connect(socket_path()); }
+        catch (std::runtime_error &) {}
+    });
+
+    wait(state.connection_event());
+    state.accept();
+
+    connector.join();
+}
+
+static bool test_basic()
+{
+    Test test;
+
+    Shared_State<int> state(socket_path(), 5);
+    Shared_State_Observer<int> observer(-1);
+
+    test.assert("Not connected.", !observer.is_connected());
+    test.assert("Default value.", observer.load() == -1);
+    test.assert("Not changed.", !observer.has_changed());
+
+    connect(state, observer);
+
+    test.assert("Connected.", observer.is_connected());
+    test.assert("Observer admitted.", state.observer_count() == 1);
+    test.assert("Initial value.", observer.load() == 5);
+    test.assert("Initial version.", observer.version() == 0);
+    test.assert("Not changed after load.", !observer.has_changed());
+
+    state.store(6);
+
+    test.assert("Changed.", observer.has_changed());
+    test.assert("Loaded if changed.", observer.load_if_changed() && observer.value() == 6);
+    test.assert("Version.", observer.version() == 1);
+    test.assert("Not loaded if unchanged.", !observer.load_if_changed());
+
+    state.value() = 7;
+    state.store();
+
+    test.assert("Stored value.", observer.load() == 7);
+
+    observer.disconnect();
+
+    test.assert("Disconnected.", !observer.is_connected());
+    test.assert("Default value after disconnecting.", observer.value() == -1 && observer.load() == -1);
+
+    state.accept();
+
+    test.assert("Disconnected observer released.", state.observer_count() == 0);
+
+    return test.success();
+}
+
+static bool test_notification()
+{
+    Test test;
+
+    Shared_State<int> state(socket_path());
+    Shared_State_Observer<int> observer1;
+    Shared_State_Observer<int> observer2;
+
+    connect(state, observer1);
+    connect(state, observer2);
+
+    test.assert("Observers admitted.", state.observer_count() == 2);
+
+    Event event1 = observer1.changed();
+    Event event2 = observer2.changed();
+
+    test.assert("Not notified initially.", !is_active(event1) && !is_active(event2));
+
+    for (int i = 1; i <= 3; ++i)
+        state.store(i);
+
+    test.assert("Both notified.", is_active(event1) && is_active(event2));
+
+    event1.clear();
+
+    test.assert("Observer 1 notification consumed.", !is_active(event1));
+    test.assert("Observer 1 loads the last value.", observer1.load() == 3);
+
+    state.store(4);
+
+    test.assert("Observer 1 notified again.", is_active(event1));
+    test.assert("Observer 2 still notified.", is_active(event2));
+
+    event2.clear();
+
+    test.assert("Observer 2 notified once for all values.", !is_active(event2));
+    test.assert("Observer 2 loads the last value.", observer2.load() == 4);
+
+    return test.success();
+}
+
+static bool test_value_size_mismatch()
+{
+    Test test;
+
+    Shared_State<int> state(socket_path());
+    Shared_State_Observer<double> observer;
+
+    connect(state, observer);
+
+    test.assert("Not connected.", !observer.is_connected());
+
+    return test.success();
+}
+
+static bool test_processes()
+{
+    Test test;
+
+    constexpr int count = 10000;
+
+    string path = socket_path();
+
+    Shared_State<Pair> state(path);
+
+    pid_t child = fork();
+
+    if (child == 0)
+    {
+        // The child observes and checks that values are consistent and increasing.
+        int status = 0;
+
+        try
+        {
+            Shared_State_Observer<Pair> observer;
+            observer.connect(path);
+
+            Event event = observer.changed();
+            int64_t last = 0;
+
+            auto start = chrono::steady_clock::now();
+
+            while(last < count && chrono::steady_clock::now() - start < chrono::seconds(5))
+            {
+                wait(event);
+
+                Pair value = observer.load();
+                if (value.a != value.b || value.a < last)
+                    status = 2;
+                last = value.a;
+            }
+
+            if (last != count)
+                status = 3;
+        }
+        catch (...)
+        {
+            status = 1;
+        }
+
+        _exit(status);
+    }
+
+    test.assert_critical("Forked.", child > 0);
+
+    wait(state.connection_event());
+    state.accept();
+
+    for (int i = 1; i <= count; ++i)
+    {
+        state.store(Pair { i, i });
+        if (i % 100 == 0)
+            this_thread::sleep_for(chrono::microseconds(100));
+    }
+
+    int status = -1;
+    waitpid(child, &status, 0);
+
+    test.assert("Observer process succeeded: " + to_string(WEXITSTATUS(status)),
+                WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    return test.success();
+}
+
+Test_Set shared_state_tests()
+{
+    return {
+        { "basic", test_basic },
+        { "notification", test_notification },
+        { "value size mismatch", test_value_size_mismatch },
+        { "processes", test_processes },
+    };
+}
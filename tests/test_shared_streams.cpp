@@ -0,0 +1,248 @@
+#include "../stitch/shared_streams.h"
+#include "../testing/testing.h"
+
+#include <thread>
+#include <chrono>
+#include <string>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace Stitch;
+using namespace Testing;
+using namespace std;
+
+static string socket_path()
+{
+    return "/tmp/stitch-test-" + to_string(getpid()) + ".socket";
+}
+
+static bool test_basic()
+{
+    Test test;
+
+    Shared_Stream_Consumer<int> consumer(socket_path(), 256);
+    Shared_Stream_Producer<int> producer;
+
+    test.assert("Not connected.", !producer.is_connected());
+
+    // Pushing while not connected has no effect
+    producer.push(123);
+
+    thread connector([&](){
+        producer.connect(socket_path());
+    });
+
+    wait(consumer.connection_event());
+    consumer.accept();
+
+    connector.join();
+
+    test.assert("Connected.", producer.is_connected());
+    test.assert("Empty.", consumer.empty());
+
+    for (int rep = 0; rep < 5; ++rep)
+    {
+        for (int i = 0; i < 5; ++i)
+            producer.push(i);
+
+        wait(consumer.receive_event());
+
+        for (int i = 0; i < 5; ++i)
+        {
+            int v;
+            bool ok = consumer.pop(v);
+            test.assert("Popped.", ok);
+            if (ok)
+                test.assert("Popped " + to_string(v), v == i);
+        }
+
+        test.assert("Empty.", consumer.empty());
+    }
+
+    {
+        int data[3] = { 7, 8, 9 };
+        producer.push(3, data);
+
+        int output[3] = { 0, 0, 0 };
+        test.assert("Popped bulk.", consumer.pop(3, output));
+        test.assert("Bulk data.", output[0] == 7 && output[1] == 8 && output[2] == 9);
+    }
+
+    {
+        string text("hello");
+        producer.push(text.data(), text.size());
+
+        int size;
+        auto data = (const char*) consumer.front(size);
+        test.assert_critical("Got message.", data != nullptr);
+        test.assert("Message.", string(data, size) == text);
+        test.assert("Popped message.", consumer.pop());
+    }
+
+    producer.disconnect();
+
+    test.assert("Disconnected.", !producer.is_connected());
+
+    return test.success();
+}
+
+static bool test_item_size_mismatch()
+{
+    Test test;
+
+    Shared_Stream_Consumer<int> consumer(socket_path(), 64);
+    Shared_Stream_Producer<double> producer;
+
+    bool failed = false;
+
+    thread connector([&](){
+        try { producer.connect(socket_path()); }
+        catch (std::runtime_error &) { failed = true; }
+    });
+
+    wait(consumer.connection_event());
+    consumer.accept();
+
+    connector.join();
+
+    test.assert("Connection failed.", failed);
+    test.assert("Not connected.", !producer.is_connected());
+
+    return test.success();
+}
+
+// Serves shared memory with the given header values to a producer,
+// like a consumer does, and returns whether the producer connected.
+static bool producer_accepts(uint64_t data_offset, uint64_t capacity, uint64_t size)
+{
+    using Header = Detail::Shared_Stream_Header;
+
+    Unix_Socket_Listener listener(socket_path());
+
+    Shared_Memory memory;
+    memory.create(size);
+
+    auto header = new (memory.data()) Header;
+    header->magic = Header::Magic;
+    header->item_size = sizeof(int);
+    header->data_offset = data_offset;
+    header->queue.capacity = capacity;
+
+    Detail::SignalChannel signal;
+
+    Shared_Stream_Producer<int> producer;
+
+    thread connector([&](){
+        try { producer.connect(socket_path()); }
+        catch (std::runtime_error &) {}
+    });
+
+    wait(listener.event());
+
+    int connection = listener.accept();
+    Detail::Shared_Stream_Handshake handshake { memory.size() };
+    int fds[2] = { memory.fd(), signal.fd };
+    send_file_descriptors(connection, &handshake, sizeof(handshake), fds, 2);
+    close(connection);
+
+    connector.join();
+
+    return producer.is_connected();
+}
+
+static bool test_invalid_header()
+{
+    Test test;
+
+    using Header = Detail::Shared_Stream_Header;
+
+    uint64_t offset = (sizeof(Header) + 63) / 64 * 64;
+
+    test.assert("Valid header accepted.", producer_accepts(offset, 32, offset + 32 * 8));
+    test.assert("Zero capacity rejected.", !producer_accepts(offset, 0, offset + 32 * 8));
+    test.assert("Capacity not a power of two rejected.", !producer_accepts(offset, 24, offset + 32 * 8));
+    test.assert("Capacity exceeding memory rejected.", !producer_accepts(offset, 64, offset + 32 * 8));
+    test.assert("Overflowing capacity rejected.", !producer_accepts(offset, uint64_t(1) << 61, offset + 32 * 8));
+    test.assert("Offset exceeding memory rejected.", !producer_accepts(offset + 4096, 32, offset + 32 * 8));
+    test.assert("Offset within header rejected.", !producer_accepts(8, 32, offset + 32 * 8));
+
+    return test.success();
+}
+
+static bool test_processes()
+{
+    Test test;
+
+    constexpr int count = 10000;
+
+    string path = socket_path();
+
+    // Large enough for all items, so none are dropped.
+    Shared_Stream_Consumer<int> consumer(path, count * 16);
+
+    pid_t child = fork();
+
+    if (child == 0)
+    {
+        try
+        {
+            Shared_Stream_Producer<int> producer(path);
+
+            for (int i = 0; i < count; ++i)
+            {
+                producer.push(i);
+                if (i % 100 == 0)
+                    this_thread::sleep_for(chrono::microseconds(100));
+            }
+        }
+        catch (...)
+        {
+            _exit(1);
+        }
+
+        _exit(0);
+    }
+
+    test.assert_critical("Forked.", child > 0);
+
+    wait(consumer.connection_event());
+    consumer.accept();
+
+    int expected = 0;
+    bool in_order = true;
+
+    auto start = chrono::steady_clock::now();
+
+    while(expected < count && chrono::steady_clock::now() - start < chrono::seconds(5))
+    {
+        wait(consumer.receive_event());
+
+        int v;
+        while(consumer.pop(v))
+        {
+            in_order &= v == expected;
+            expected = v + 1;
+        }
+    }
+
+    int status = -1;
+    waitpid(child, &status, 0);
+
+    test.assert("Producer process succeeded.", WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    test.assert("Received items in order.", in_order);
+    test.assert("Received last item.", expected == count);
+
+    return test.success();
+}
+
+Test_Set shared_stream_tests()
+{
+    return {
+        { "basic", test_basic },
+        { "item size mismatch", test_item_size_mismatch },
+        { "invalid header", test_invalid_header },
+        { "processes", test_processes },
+    };
+}
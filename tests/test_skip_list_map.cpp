@@ -0,0 +1,366 @@
+#include "../stitch/skip_list_map.h"
+#include "../testing/testing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace Testing;
+using namespace Stitch;
+using namespace std;
+
+namespace {
+
+// Counts live instances, to check reclamation.
+struct Counted
+{
+    static atomic<int> count;
+
+    Counted() { ++count; }
+    Counted(const Counted &) { ++count; }
+    ~Counted() { --count; }
+    Counted & operator=(const Counted &) = default;
+};
+
+atomic<int> Counted::count { 0 };
+
+}
+
+template <typename M>
+static vector<pair<int,int>> entries(M & map)
+{
+    vector<pair<int,int>> result;
+    for (auto & entry : map)
+        result.emplace_back(entry.first, entry.second);
+    return result;
+}
+
+static bool test_basic()
+{
+    Test test;
+
+    Skip_List_Map<int, int> map;
+
+    test.assert("Map empty.", map.empty());
+    test.assert("Begin equals end.", !(map.begin() != map.end()));
+
+    for (int i : { 5, 3, 8, 0, 9, 1, 7, 2, 6, 4 })
+        test.assert("Key " + to_string(i) + " inserted.", map.insert(i, i * 10));
+
+    test.assert("Key not inserted twice.", !map.insert(3, 0));
+
+    test.assert("Map has 10 elements.", map.size() == 10);
+
+    int value = -1;
+    test.assert("Key 3 found.", map.find(3, value));
+    test.assert("Value of key 3 not replaced.", value == 30);
+    test.assert("Key 10 not found.", !map.find(10, value));
+
+    for (int i : { 0, 4, 5, 3, 7 })
+        test.assert("Key " + to_string(i) + " erased.", map.erase(i));
+
+    test.assert("Key not erased twice.", !map.erase(4));
+
+    test.assert("Map has 5 elements.", map.size() == 5);
+    test.assert("Map contains 6.", map.contains(6));
+    test.assert("Map does not contain 7.", !map.contains(7));
+
+    test.assert("Entries in order.", entries(map) == vector<pair<int,int>>({ {1,10}, {2,20}, {6,60}, {8,80}, {9,90} }));
+
+    return test.success();
+}
+
+static bool test_compare()
+{
+    Test test;
+
+    Skip_List_Map<string, int, greater<string>> map;
+
+    map.insert("b", 2);
+    map.insert("a", 1);
+    map.insert("c", 3);
+
+    vector<string> keys;
+    for (auto & entry : map)
+        keys.push_back(entry.first);
+
+    test.assert("Keys in descending order.", keys == vector<string>({ "c", "b", "a" }));
+
+    return test.success();
+}
+
+static bool test_bounds()
+{
+    Test test;
+
+    Skip_List_Map<int, int> map;
+
+    for (int i = 0; i < 100; i += 10)
+        map.insert(i, i);
+
+    auto it = map.lower_bound(30);
+    test.assert("Lower bound of existing key.", it != map.end() && it->first == 30);
+
+    it = map.lower_bound(31);
+    test.assert("Lower bound of missing key.", it != map.end() && it->first == 40);
+
+    it = map.upper_bound(30);
+    test.assert("Upper bound of existing key.", it != map.end() && it->first == 40);
+
+    test.assert("Lower bound after last key.", !(map.lower_bound(91) != map.end()));
+    test.assert("Upper bound of last key.", !(map.upper_bound(90) != map.end()));
+
+    vector<int> range;
+    for (auto it = map.lower_bound(25); it != map.end() && it->first < 65; ++it)
+        range.push_back(it->first);
+
+    test.assert("Range.", range == vector<int>({ 30, 40, 50, 60 }));
+
+    return test.success();
+}
+
+static bool test_many()
+{
+    Test test;
+
+    Skip_List_Map<int, int> map;
+
+    int count = 100000;
+
+    // Insert in a scrambled order.
+    for (int i = 0; i < count; ++i)
+        map.insert((i * 7919) % count, i);
+
+    test.assert("Map size.", map.size() == count);
+
+    bool all_found = true;
+    for (int i = 0; i < count; ++i)
+        all_found &= map.contains(i);
+
+    test.assert("All keys found.", all_found);
+
+    int expected = 0;
+    bool ordered = true;
+    for (auto & entry : map)
+        ordered &= entry.first == expected++;
+
+    test.assert("All entries visited in order.", ordered && expected == count);
+
+    for (int i = 0; i < count; i += 2)
+        map.erase(i);
+
+    test.assert("Half erased.", map.size() == count / 2);
+    test.assert("Odd key remains.", map.contains(count - 1));
+    test.assert("Even key erased.", !map.contains(count - 2));
+
+    return test.success();
+}
+
+static bool test_erase_during_iteration()
+{
+    Test test;
+
+    Skip_List_Map<int, int> map;
+
+    for (int i = 0; i < 100; ++i)
+        map.insert(i, i);
+
+    vector<int> visited;
+
+    for (auto & entry : map)
+    {
+        visited.push_back(entry.first);
+        // Erase the current and the following element.
+        map.erase(entry.first);
+        map.erase(entry.first + 1);
+    }
+
+    vector<int> expected;
+    for (int i = 0; i < 100; i += 2)
+        expected.push_back(i);
+
+    test.assert("Iteration continued after erased elements.", visited == expected);
+    test.assert("Map empty.", map.empty() && !(map.begin() != map.end()));
+
+    return test.success();
+}
+
+static bool test_reclamation()
+{
+    Test test;
+
+    {
+        Skip_List_Map<int, Counted> map;
+
+        for (int i = 0; i < 100; ++i)
+            map.insert(i, Counted());
+
+        test.assert("Values alive.", Counted::count == 100);
+
+        for (int i = 0; i < 50; ++i)
+            map.erase(i);
+
+        Detail::Hazard_Pointers::clear();
+
+        test.assert("Erased values reclaimed: " + to_string(Counted::count), Counted::count == 50);
+    }
+
+    test.assert("Values destroyed with map.", Counted::count == 0);
+
+    return test.success();
+}
+
+static bool test_concurrent_modification()
+{
+    Test test;
+
+    Skip_List_Map<int, int> map;
+
+    int thread_count = 4;
+    int range = 1000;
+
+    auto modify = [&](int t)
+    {
+        // Threads insert interleaved keys several times
+        // and then erase odd keys.
+        for (int rep = 0; rep < 10; ++rep)
+        {
+            for (int i = 0; i < range; ++i)
+                map.insert(i * thread_count + t, t);
+            for (int i = 0; i < range; ++i)
+            {
+                int key = i * thread_count + t;
+                if (key % 2)
+                    map.erase(key);
+            }
+        }
+    };
+
+    vector<thread> threads;
+    for (int t = 0; t < thread_count; ++t)
+        threads.emplace_back(modify, t);
+    for (auto & t : threads)
+        t.join();
+
+    vector<pair<int,int>> expected;
+    for (int i = 0; i < thread_count * range; i += 2)
+        expected.emplace_back(i, i % thread_count);
+
+    test.assert("Map contains even keys.", entries(map) == expected);
+    test.assert("Map size.", map.size() == (int) expected.size());
+
+    return test.success();
+}
+
+static bool test_concurrent_same_keys()
+{
+    Test test;
+
+    Skip_List_Map<int, int> map;
+
+    int thread_count = 4;
+    int range = 200;
+    atomic<int> inserted { 0 };
+    atomic<int> erased { 0 };
+
+    // All threads insert and erase the same keys.
+    auto modify = [&](int t)
+    {
+        for (int rep = 0; rep < 20; ++rep)
+        {
+            for (int i = 0; i < range; ++i)
+            {
+                if (map.insert(i, t))
+                    ++inserted;
+            }
+            for (int i = 0; i < range; ++i)
+            {
+                if (map.erase(i))
+                    ++erased;
+            }
+        }
+    };
+
+    vector<thread> threads;
+    for (int t = 0; t < thread_count; ++t)
+        threads.emplace_back(modify, t);
+    for (auto & t : threads)
+        t.join();
+
+    test.assert("Map empty.", map.empty() && !(map.begin() != map.end()));
+    test.assert("Each insertion erased once.", inserted == erased);
+
+    return test.success();
+}
+
+static bool test_concurrent_iteration()
+{
+    Test test;
+
+    Skip_List_Map<int, int> map;
+
+    int range = 1000;
+
+    // Even keys stay, odd keys come and go.
+    for (int i = 0; i < range; i += 2)
+        map.insert(i, i);
+
+    atomic<bool> work { true };
+
+    thread modifier([&]()
+    {
+        while(work)
+        {
+            for (int i = 1; i < range; i += 2)
+                map.insert(i, i);
+            for (int i = 1; i < range; i += 2)
+                map.erase(i);
+        }
+    });
+
+    bool ordered = true;
+    bool complete = true;
+
+    for (int rep = 0; rep < 100; ++rep)
+    {
+        int last = -1;
+        int even_count = 0;
+
+        for (auto & entry : map)
+        {
+            ordered &= entry.first > last;
+            last = entry.first;
+            if (entry.first % 2 == 0)
+                ++even_count;
+        }
+
+        complete &= even_count == range / 2;
+    }
+
+    work = false;
+    modifier.join();
+
+    test.assert("Keys visited in increasing order.", ordered);
+    test.assert("All stable keys visited.", complete);
+
+    return test.success();
+}
+
+Test_Set skip_list_map_tests()
+{
+    return {
+        { "basic", test_basic },
+        { "compare", test_compare },
+        { "bounds", test_bounds },
+        { "many", test_many },
+        { "erase-during-iteration", test_erase_during_iteration },
+        { "reclamation", test_reclamation },
+        { "concurrent-modification", test_concurrent_modification },
+        { "concurrent-same-keys", test_concurrent_same_keys },
+        { "concurrent-iteration", test_concurrent_iteration },
+    };
+}
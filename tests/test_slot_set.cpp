@@ -0,0 +1,434 @@
+#include "../stitch/slot_set.h"
+#include "../testing/testing.h"
+
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Testing;
+using namespace Stitch;
+using namespace std;
+
+namespace {
+
+// Counts live instances, to check destruction of removed elements.
+struct Counted
+{
+    static atomic<int> count;
+
+    Counted() { ++count; }
+    Counted(const Counted &) { ++count; }
+    ~Counted() { --count; }
+    bool operator==(const Counted &) const { return false; }
+};
+
+atomic<int> Counted::count { 0 };
+
+}
+
+template <typename T>
+static vector<T> elements(Slot_Set<T> & set)
+{
+    vector<T> result;
+    for (const T & v : set)
+        result.push_back(v);
+    sort(result.begin(), result.end());
+    return result;
+}
+
+static bool test_basic()
+{
+    Test test;
+
+    Slot_Set<int> set;
+
+    test.assert("Set empty.", set.empty());
+    test.assert("Begin equals end.", !(set.begin() != set.end()));
+    test.assert("No slots allocated.", set.capacity() == 0);
+
+    vector<Slot_Handle> handles;
+    for (int i = 0; i < 10; ++i)
+        handles.push_back(set.insert(i));
+
+    test.assert("Set has 10 elements.", set.size() == 10);
+    test.assert("Elements.", elements(set) == vector<int>({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }));
+    test.assert("Get element.", set.get(handles[3]) == 3);
+
+    test.assert("Removed by handle.", set.remove(handles[3]));
+    test.assert("Not removed twice.", !set.remove(handles[3]));
+    test.assert("Removed by value.", set.remove(7));
+    test.assert("Missing value not removed.", !set.remove(7));
+    test.assert("Empty handle does not remove.", !set.remove(Slot_Handle()));
+
+    test.assert("Elements after removal.", elements(set) == vector<int>({ 0, 1, 2, 4, 5, 6, 8, 9 }));
+
+    // Inserting reuses the slot of element 3, which must not be removed
+    // using the old handle.
+    int capacity = set.capacity();
+    for (int i = 0; i < 2; ++i)
+        set.insert(10 + i);
+
+    test.assert("Slots reused.", set.capacity() == capacity);
+    test.assert("Old handle does not remove reused slot.", !set.remove(handles[3]));
+    test.assert("Set has 10 elements again.", set.size() == 10);
+
+    set.clear();
+
+    test.assert("Set empty after clear.", set.empty() && !(set.begin() != set.end()));
+
+    return test.success();
+}
+
+static bool test_reserve()
+{
+    Test test;
+
+    Slot_Set<int> set;
+
+    set.reserve(100);
+
+    test.assert("Slots reserved.", set.capacity() == 100);
+
+    for (int rep = 0; rep < 10; ++rep)
+    {
+        vector<Slot_Handle> handles;
+        for (int i = 0; i < 100; ++i)
+            handles.push_back(set.insert(i));
+        for (auto & handle : handles)
+            set.remove(handle);
+    }
+
+    test.assert("No slots added: " + to_string(set.capacity()), set.capacity() == 100);
+
+    set.reserve(50);
+
+    test.assert("Reserving less has no effect.", set.capacity() == 100);
+
+    return test.success();
+}
+
+static bool test_remove_during_iteration()
+{
+    Test test;
+
+    Slot_Set<int> set;
+
+    vector<Slot_Handle> handles;
+    for (int i = 0; i < 100; ++i)
+        handles.push_back(set.insert(i));
+
+    vector<int> visited;
+
+    for (auto it = set.begin(); it != set.end(); ++it)
+    {
+        int value = *it;
+        visited.push_back(value);
+        // Remove the current and some other element.
+        set.remove(it.handle());
+        set.remove(handles[(value + 50) % 100]);
+        test.assert("Current element still accessible.", *it == value);
+    }
+
+    sort(visited.begin(), visited.end());
+
+    test.assert("Elements visited at most once.",
+                adjacent_find(visited.begin(), visited.end()) == visited.end());
+    test.assert("Set empty.", set.empty() && !(set.begin() != set.end()));
+
+    return test.success();
+}
+
+static bool test_reclamation()
+{
+    Test test;
+
+    {
+        Slot_Set<Counted> set;
+
+        Slot_Handle a = set.insert(Counted());
+        Slot_Handle b = set.insert(Counted());
+
+        test.assert("Elements alive.", Counted::count == 2);
+
+        set.remove(a);
+
+        test.assert("Removed element destroyed.", Counted::count == 1);
+
+        {
+            auto it = set.begin();
+            set.remove(b);
+            test.assert("Element in use not destroyed.", Counted::count == 1);
+        }
+
+        // Removing or inserting destroys removed elements which are no longer in use.
+        set.insert(Counted());
+
+        test.assert("Element destroyed after use: " + to_string(Counted::count), Counted::count == 1);
+    }
+
+    test.assert("Elements destroyed with set.", Counted::count == 0);
+
+    return test.success();
+}
+
+static bool test_move_only()
+{
+    Test test;
+
+    Slot_Set<unique_ptr<int>> set;
+
+    Slot_Handle handle = set.insert(make_unique<int>(1));
+    set.insert(make_unique<int>(2));
+
+    test.assert("Element moved in.", *set.get(handle) == 1);
+
+    int sum = 0;
+    for (auto it = set.begin(); it != set.end(); ++it)
+        sum += **it;
+
+    test.assert("Elements visited.", sum == 3);
+    test.assert("Removed.", set.remove(handle) && set.size() == 1);
+
+    return test.success();
+}
+
+static bool test_snapshot()
+{
+    Test test;
+
+    Slot_Set<int> set;
+
+    Slot_Handle a = set.insert(1);
+    set.insert(2);
+
+    auto it = set.begin();
+
+    set.update([&](Slot_Set<int>::Update & update)
+    {
+        update.remove(a);
+        update.insert(3);
+    });
+
+    vector<int> visited;
+    for (; it != set.end(); ++it)
+        visited.push_back(*it);
+    sort(visited.begin(), visited.end());
+
+    test.assert("Iterator visits version from start of iteration.", visited == vector<int>({ 1, 2 }));
+    test.assert("New iteration visits new version.", elements(set) == vector<int>({ 2, 3 }));
+    test.assert("Size of new version.", set.size() == 2);
+
+    return test.success();
+}
+
+static bool test_update()
+{
+    Test test;
+
+    Slot_Set<int> set;
+
+    int count = 16;
+    atomic<bool> done { false };
+    atomic<int> torn { 0 };
+    atomic<int> iterations { 0 };
+
+    // Each version contains 'count' elements, all equal.
+    for (int i = 0; i < count; ++i)
+        set.insert(1);
+
+    thread iterator([&]()
+    {
+        while (!done)
+        {
+            vector<int> values;
+            for (int v : set)
+                values.push_back(v);
+
+            if ((int) values.size() != count ||
+                    adjacent_find(values.begin(), values.end(), not_equal_to<int>()) != values.end())
+                ++torn;
+
+            ++iterations;
+            this_thread::yield();
+        }
+    });
+
+    for (int value = 2; value < 2000 || iterations < 100; ++value)
+    {
+        set.update([&](Slot_Set<int>::Update & update)
+        {
+            for (auto it = set.begin(); it != set.end(); ++it)
+                update.remove(it.handle());
+
+            for (int i = 0; i < count; ++i)
+            {
+                update.insert(value);
+                // Give the iterating thread a chance to observe a partial update.
+                if (i % 4 == 0)
+                    this_thread::yield();
+            }
+        });
+    }
+
+    done = true;
+    iterator.join();
+
+    test.assert("No partial update observed: " + to_string(torn), torn == 0);
+    test.assert("Removed slots reused: " + to_string(set.capacity()), set.capacity() <= 8 * count);
+
+    return test.success();
+}
+
+static bool test_concurrent()
+{
+    Test test;
+
+    Slot_Set<int> set;
+
+    int thread_count = 4;
+    int range = 1000;
+    atomic<bool> done { false };
+    atomic<int> invalid { 0 };
+
+    // Elements are always positive, so a destroyed or reused
+    // element would likely be observed as invalid.
+    auto iterate = [&]()
+    {
+        while (!done)
+        {
+            for (int v : set)
+            {
+                if (v <= 0)
+                    ++invalid;
+            }
+            this_thread::yield();
+        }
+    };
+
+    auto modify = [&](int t)
+    {
+        vector<Slot_Handle> handles;
+        for (int rep = 0; rep < 10; ++rep)
+        {
+            for (int i = 1; i <= range; ++i)
+                handles.push_back(set.insert(t * range + i));
+            for (auto & handle : handles)
+                set.remove(handle);
+            handles.clear();
+        }
+        for (int i = 1; i <= range; ++i)
+            set.insert(t * range + i);
+    };
+
+    thread iterator(iterate);
+
+    vector<thread> threads;
+    for (int t = 0; t < thread_count; ++t)
+        threads.emplace_back(modify, t);
+    for (auto & t : threads)
+        t.join();
+
+    done = true;
+    iterator.join();
+
+    vector<int> expected;
+    for (int i = 1; i <= thread_count * range; ++i)
+        expected.push_back(i);
+
+    test.assert("No invalid elements visited.", invalid == 0);
+    test.assert("Set contains last inserted elements.", elements(set) == expected);
+
+    return test.success();
+}
+
+static bool test_concurrent_updates()
+{
+    Test test;
+
+    Slot_Set<int> set;
+
+    int thread_count = 3;
+    int count = 8;
+    int rounds = 500;
+    atomic<bool> done { false };
+    atomic<int> torn { 0 };
+
+    // Each writer replaces its 'count' elements in every update.
+    // Elements of writer t in round r have the value t * rounds + r.
+    auto write = [&](int t)
+    {
+        vector<Slot_Handle> handles;
+
+        for (int round = 0; round < rounds; ++round)
+        {
+            Slot_Set<int>::Update update(set);
+
+            for (auto & handle : handles)
+                update.remove(handle);
+            handles.clear();
+
+            for (int i = 0; i < count; ++i)
+                handles.push_back(update.insert(t * rounds + round));
+
+            update.publish();
+
+            if (round % 8 == 0)
+                this_thread::yield();
+        }
+    };
+
+    thread iterator([&]()
+    {
+        while (!done)
+        {
+            vector<vector<int>> values(thread_count);
+            for (int v : set)
+                values[v / rounds].push_back(v);
+
+            for (auto & vs : values)
+            {
+                if (vs.empty())
+                    continue;
+                if ((int) vs.size() != count ||
+                        adjacent_find(vs.begin(), vs.end(), not_equal_to<int>()) != vs.end())
+                    ++torn;
+            }
+
+            this_thread::yield();
+        }
+    });
+
+    vector<thread> threads;
+    for (int t = 0; t < thread_count; ++t)
+        threads.emplace_back(write, t);
+    for (auto & t : threads)
+        t.join();
+
+    done = true;
+    iterator.join();
+
+    test.assert("No partial update observed: " + to_string(torn), torn == 0);
+    test.assert("Set contains last elements of each writer: " + to_string(set.size()),
+                set.size() == thread_count * count && (int) elements(set).size() == thread_count * count);
+
+    return test.success();
+}
+
+Test_Set slot_set_tests()
+{
+    return {
+        { "basic", test_basic },
+        { "reserve", test_reserve },
+        { "remove-during-iteration", test_remove_during_iteration },
+        { "reclamation", test_reclamation },
+        { "move-only", test_move_only },
+        { "snapshot", test_snapshot },
+        { "update", test_update },
+        { "concurrent", test_concurrent },
+        { "concurrent-updates", test_concurrent_updates },
+    };
+}
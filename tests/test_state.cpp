@@ -1,9 +1,16 @@
 #include "../stitch/state.h"
 #include "../testing/testing.h"
 
+#include <atomic>
+#include <chrono>
 #include <thread>
 #include <sstream>
 #include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
 
 using namespace Stitch;
 using namespace Testing;
@@ -163,6 +170,38 @@ bool test_double_store_load()
     return test.success();
 }
 
+bool test_change_detection()
+{
+    Test test;
+
+    State<int> state(1);
+    State_Observer<int> observer(-1);
+
+    test.assert("Not changed when not connected.", !observer.has_changed());
+    test.assert("Not loaded when not connected.", !observer.load_if_changed());
+    test.assert("Default value.", observer.value() == -1);
+
+    observer.connect(state);
+
+    test.assert("Changed after connecting.", observer.has_changed());
+    test.assert("Loaded if changed.", observer.load_if_changed());
+    test.assert("Loaded value.", observer.value() == 1);
+    test.assert("Not changed after load.", !observer.has_changed());
+    test.assert("Not loaded if not changed.", !observer.load_if_changed());
+
+    auto version = observer.version();
+
+    state.store(2);
+
+    test.assert("Version increased.", observer.version() == version + 1);
+    test.assert("Changed after store.", observer.has_changed());
+    test.assert("Loaded if changed.", observer.load_if_changed());
+    test.assert("Loaded value.", observer.value() == 2);
+    test.assert("Not changed after load.", !observer.has_changed());
+
+    return test.success();
+}
+
 bool test_notification()
 {
     Test test;
@@ -216,6 +255,286 @@ bool test_notification()
     return test.success();
 }
 
+bool test_coalesced_notification()
+{
+    Test test;
+
+    State<int> state;
+    State_Observer<int> observer;
+    observer.connect(state);
+
+    Event event = observer.changed();
+
+    auto signal_count = [&]() -> uint64_t
+    {
+        uint64_t count = 0;
+        if (read(event.fd, &count, sizeof(count)) != sizeof(count))
+            return 0;
+        return count;
+    };
+
+    for (int i = 0; i < 10; ++i)
+        state.store(i);
+
+    test.assert("Notified once for multiple stores.", signal_count() == 1);
+
+    // Event not consumed yet: no further notifications.
+    state.store(10);
+    test.assert("Not notified while notification pending.", signal_count() == 0);
+
+    event.clear();
+
+    state.store(11);
+    test.assert("Notified again after event handled.", signal_count() == 1);
+    test.assert("Latest value loaded.", observer.load() == 11);
+
+    return test.success();
+}
+
+bool test_poll_mode()
+{
+    Test test;
+
+    State<int> state(1);
+    State_Observer<int> observer(State_Observer_Mode::Poll);
+
+    bool thrown = false;
+    try { observer.changed(); }
+    catch (std::runtime_error &) { thrown = true; }
+
+    test.assert("No change event.", thrown);
+
+    observer.connect(state);
+
+    test.assert("Initial value loaded.", observer.load() == 1);
+
+    state.store(2);
+
+    test.assert("Change detected.", observer.has_changed());
+    test.assert("Loaded if changed.", observer.load_if_changed());
+    test.assert("New value loaded.", observer.value() == 2);
+
+    // A notified observer is unaffected.
+    State_Observer<int> notified;
+    notified.connect(state);
+    state.store(3);
+
+    bool notified_changed = false;
+    Event_Reactor reactor;
+    reactor.subscribe(notified.changed(), [&](){ notified_changed = true; });
+    reactor.run(Event_Reactor::NoWait);
+
+    test.assert("Notified observer notified.", notified_changed);
+    test.assert("Polling observer loads value.", observer.load() == 3);
+
+    observer.disconnect();
+
+    test.assert("Default value after disconnecting.", observer.load() == 0);
+
+    return test.success();
+}
+
+bool test_history()
+{
+    Test test;
+
+    State<int> state(0, 4);
+    State_Observer<int> observer;
+    observer.connect(state);
+
+    vector<pair<int,uint64_t>> replayed;
+    auto collect = [&](const int & value, uint64_t version)
+    {
+        replayed.emplace_back(value, version);
+    };
+
+    uint64_t version = observer.load_since(0, collect);
+    test.assert("Nothing to replay.", version == 0 && replayed.empty());
+
+    for (int i = 1; i <= 3; ++i)
+        state.store(i * 10);
+
+    version = observer.load_since(version, collect);
+
+    test.assert("Replayed all values.", replayed == vector<pair<int,uint64_t>>({ {10,1}, {20,2}, {30,3} }));
+    test.assert("Returned last version.", version == 3);
+
+    replayed.clear();
+
+    // Lag behind by more than the history.
+    for (int i = 4; i <= 10; ++i)
+        state.store(i * 10);
+
+    version = observer.load_since(version, collect);
+
+    test.assert("Fell back to latest value.", replayed == vector<pair<int,uint64_t>>({ {100,10} }));
+    test.assert("Returned latest version.", version == 10);
+
+    replayed.clear();
+
+    // Lag behind by exactly the history.
+    for (int i = 11; i <= 14; ++i)
+        state.store(i * 10);
+
+    version = observer.load_since(version, collect);
+
+    test.assert("Replayed full history.", replayed == vector<pair<int,uint64_t>>({ {110,11}, {120,12}, {130,13}, {140,14} }));
+
+    return test.success();
+}
+
+bool test_history_concurrent()
+{
+    Test test;
+
+    State<int> state(0, 16);
+    State_Observer<int> observer;
+    observer.connect(state);
+
+    int count = 10000;
+
+    thread writer([&]()
+    {
+        for (int i = 1; i <= count; ++i)
+            state.store(i);
+    });
+
+    uint64_t version = 0;
+    bool consistent = true;
+    bool ordered = true;
+
+    while (version < (uint64_t) count)
+    {
+        uint64_t last = version;
+
+        version = observer.load_since(version, [&](const int & value, uint64_t v)
+        {
+            consistent &= uint64_t(value) == v;
+            ordered &= v > last;
+            last = v;
+        });
+    }
+
+    writer.join();
+
+    test.assert("Values match their versions.", consistent);
+    test.assert("Versions increase.", ordered);
+
+    return test.success();
+}
+
+bool test_throttle_min_interval()
+{
+    Test test;
+
+    using clock = chrono::steady_clock;
+
+    State<int> state;
+    State_Observer<int> observer;
+    observer.connect(state);
+    observer.throttle(chrono::milliseconds(50));
+
+    int count = 100;
+
+    thread writer([&]()
+    {
+        // Store for about 300 ms
+        for (int i = 1; i <= count; ++i)
+        {
+            state.store(i);
+            this_thread::sleep_for(chrono::milliseconds(3));
+        }
+    });
+
+    int wakeups = 0;
+    int last_value = 0;
+    auto start = clock::now();
+
+    while (last_value < count)
+    {
+        wait(observer.changed());
+        ++wakeups;
+        last_value = observer.load();
+    }
+
+    auto duration = clock::now() - start;
+
+    writer.join();
+
+    int max_wakeups = chrono::duration_cast<chrono::milliseconds>(duration).count() / 50 + 2;
+
+    test.assert("Throttled wakeups: " + to_string(wakeups) + " <= " + to_string(max_wakeups),
+                wakeups <= max_wakeups);
+    test.assert("Received last value.", last_value == count);
+
+    return test.success();
+}
+
+bool test_throttle_delay()
+{
+    Test test;
+
+    State<int> state;
+    State_Observer<int> observer;
+    observer.connect(state);
+    observer.throttle(chrono::nanoseconds(0), chrono::milliseconds(30));
+
+    // Unthrottled observer for comparison
+    State_Observer<int> fast_observer;
+    fast_observer.connect(state);
+
+    Event event = observer.changed();
+
+    auto is_active = [](const Event & e, int timeout_ms)
+    {
+        pollfd p { e.fd, e.poll_events, 0 };
+        return poll(&p, 1, timeout_ms) == 1;
+    };
+
+    for (int i = 1; i <= 10; ++i)
+        state.store(i);
+
+    test.assert("Unthrottled observer notified immediately.", is_active(fast_observer.changed(), 0));
+    test.assert("Not notified immediately.", !is_active(event, 0));
+    test.assert("Notified after delay.", is_active(event, 1000));
+
+    event.clear();
+
+    test.assert("Notified once.", !is_active(event, 60));
+    test.assert("Latest value loaded.", observer.load() == 10);
+
+    return test.success();
+}
+
+bool test_throttle_destroyed_observer()
+{
+    Test test;
+
+    State<int> state;
+
+    State_Observer<int> observer;
+    observer.connect(state);
+    observer.throttle(chrono::nanoseconds(0), chrono::milliseconds(30));
+
+    {
+        // Destroyed while its notification is scheduled
+        State_Observer<int> other;
+        other.connect(state);
+        other.throttle(chrono::nanoseconds(0), chrono::milliseconds(10));
+
+        state.store(1);
+    }
+
+    Event event = observer.changed();
+
+    pollfd p { event.fd, event.poll_events, 0 };
+
+    test.assert("Notified after delay.", poll(&p, 1, 1000) == 1);
+    test.assert("Latest value loaded.", observer.load() == 1);
+
+    return test.success();
+}
+
 bool test_stress()
 {
     struct Value
@@ -355,7 +674,15 @@ Test_Set state_tests()
         { "value-after-connect", test_value_after_connecting },
         { "store-load", test_store_load },
         { "double-store-load", test_double_store_load },
+        { "change-detection", test_change_detection },
         { "notification", test_notification },
+        { "coalesced-notification", test_coalesced_notification },
+        { "poll-mode", test_poll_mode },
+        { "history", test_history },
+        { "history-concurrent", test_history_concurrent },
+        { "throttle-min-interval", test_throttle_min_interval },
+        { "throttle-delay", test_throttle_delay },
+        { "throttle-destroyed-observer", test_throttle_destroyed_observer },
         { "stress", test_stress },
         { "stress-connect-disconnect", stress_connect_disconnect },
     };
@@ -0,0 +1,201 @@
+#include "../stitch/state_group.h"
+#include "../testing/testing.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+
+using namespace Stitch;
+using namespace Testing;
+using namespace std;
+
+namespace {
+
+// Counts copies, to check that unchanged members are not copied.
+struct Counted
+{
+    static atomic<int> copies;
+
+    Counted() {}
+    Counted(int value): value(value) {}
+    Counted(const Counted & other): value(other.value) { ++copies; }
+    Counted & operator=(const Counted & other) { value = other.value; ++copies; return *this; }
+
+    int value = 0;
+};
+
+atomic<int> Counted::copies { 0 };
+
+bool is_active(const Event & e)
+{
+    pollfd p { e.fd, e.poll_events, 0 };
+    return poll(&p, 1, 0) == 1;
+}
+
+}
+
+static bool test_basic()
+{
+    Test test;
+
+    State_Group<int, string> group(1, "a");
+    State_Group_Observer<int, string> observer;
+
+    test.assert("Default value.", observer.get<0>() == 0 && observer.get<1>() == "");
+
+    observer.connect(group);
+    observer.load();
+
+    test.assert("Initial value.", observer.get<0>() == 1 && observer.get<1>() == "a");
+    test.assert("Initial version.", observer.version() == 0);
+
+    group.value<0>() = 2;
+    group.store();
+
+    test.assert("Changed.", observer.has_changed());
+    observer.load();
+
+    test.assert("Member 0 changed.", observer.get<0>() == 2);
+    test.assert("Member 1 unchanged.", observer.get<1>() == "a");
+    test.assert("Version.", observer.version() == 1 && group.version() == 1);
+    test.assert("Member versions.", observer.value().version<0>() == 1 && observer.value().version<1>() == 0);
+
+    group.value<0>() += 1;
+    group.set<1>("b");
+    group.store();
+    observer.load();
+
+    test.assert("Both members changed.", observer.get<0>() == 3 && observer.get<1>() == "b");
+    test.assert("Member versions after both changed.",
+                observer.value().version<0>() == 2 && observer.value().version<1>() == 2);
+
+    group.store();
+
+    test.assert("Store without change does nothing.", !observer.has_changed() && group.version() == 2);
+
+    return test.success();
+}
+
+static bool test_unchanged_not_copied()
+{
+    Test test;
+
+    State_Group<Counted, Counted> group;
+    State_Group_Observer<Counted, Counted> observer;
+    observer.connect(group);
+
+    Counted::copies = 0;
+
+    for (int i = 1; i <= 10; ++i)
+    {
+        group.set<0>(Counted(i));
+        group.store();
+    }
+
+    test.assert("Only changed member copied: " + to_string(Counted::copies), Counted::copies == 10);
+
+    Counted::copies = 0;
+
+    for (int i = 0; i < 10; ++i)
+        observer.load();
+
+    test.assert("Loading does not copy: " + to_string(Counted::copies), Counted::copies == 0);
+    test.assert("Value.", observer.get<0>().value == 10 && observer.get<1>().value == 0);
+
+    return test.success();
+}
+
+static bool test_notification()
+{
+    Test test;
+
+    State_Group<int, int> group;
+    State_Group_Observer<int, int> observer;
+    observer.connect(group);
+
+    Event event = observer.changed();
+
+    group.set<1>(5);
+    group.store();
+
+    test.assert("Notified.", is_active(event));
+    event.clear();
+
+    test.assert("Not notified after clearing.", !is_active(event));
+
+    State_Group_Observer<int, int> poller(State_Observer_Mode::Poll);
+    poller.connect(group);
+
+    group.set<0>(3);
+    group.store();
+
+    test.assert("Poll mode observer loads.", poller.load_if_changed() && poller.get<0>() == 3 && poller.get<1>() == 5);
+
+    return test.success();
+}
+
+static bool test_consistency()
+{
+    Test test;
+
+    // Members are always stored equal, so observers must always load them equal.
+    State_Group<int, long, string> group(0, 0, "0");
+
+    atomic<bool> done { false };
+    atomic<int> inconsistent { 0 };
+    atomic<int> loads { 0 };
+
+    auto observe = [&]()
+    {
+        State_Group_Observer<int, long, string> observer(State_Observer_Mode::Poll);
+        observer.connect(group);
+
+        while (!done)
+        {
+            auto & snapshot = observer.load();
+            int a = snapshot.get<0>();
+            long b = snapshot.get<1>();
+            const string & c = snapshot.get<2>();
+            if (a != b || c != to_string(a))
+                ++inconsistent;
+            ++loads;
+            this_thread::yield();
+        }
+    };
+
+    vector<thread> observers;
+    for (int i = 0; i < 3; ++i)
+        observers.emplace_back(observe);
+
+    for (int i = 1; i <= 20000; ++i)
+    {
+        group.value<0>() = i;
+        group.value<1>() = i;
+        group.set<2>(to_string(i));
+        group.store();
+        if (i % 100 == 0)
+            this_thread::yield();
+    }
+
+    done = true;
+    for (auto & t : observers)
+        t.join();
+
+    test.assert("Loads: " + to_string(loads), loads > 0);
+    test.assert("No torn snapshots: " + to_string(inconsistent), inconsistent == 0);
+
+    return test.success();
+}
+
+Test_Set state_group_tests()
+{
+    return {
+        { "basic", test_basic },
+        { "unchanged-not-copied", test_unchanged_not_copied },
+        { "notification", test_notification },
+        { "consistency", test_consistency },
+    };
+}
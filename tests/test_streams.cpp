@@ -1,6 +1,13 @@
 #include "../stitch/streams.h"
 #include "../testing/testing.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <poll.h>
+
 using namespace Stitch;
 using namespace Testing;
 using namespace std;
@@ -296,6 +303,509 @@ static bool test_bulk_array()
     return test.success();
 }
 
+static bool is_active(const Event & event)
+{
+    pollfd data;
+    data.fd = event.fd;
+    data.events = event.poll_events;
+    return poll(&data, 1, 0) == 1;
+}
+
+static bool test_wake_on_every_push()
+{
+    Test test;
+
+    Stream_Producer<int> source;
+    Stream_Consumer<int> sink(10);
+
+    connect(source, sink);
+
+    auto event = sink.receive_event();
+
+    test.assert("Event not active.", !is_active(event));
+
+    source.push(1);
+
+    test.assert("Event active after push.", is_active(event));
+
+    event.clear();
+
+    test.assert("Event not active after clear.", !is_active(event));
+
+    return test.success();
+}
+
+static bool test_wake_high_watermark()
+{
+    Test test;
+
+    Stream_Wake_Policy policy;
+    policy.high_watermark = 4;
+
+    Stream_Producer<int> source;
+    Stream_Consumer<int> sink(10, policy);
+
+    connect(source, sink);
+
+    auto event = sink.receive_event();
+
+    for (int rep = 0; rep < 3; ++rep)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            source.push(i);
+            this_thread::sleep_for(chrono::milliseconds(5));
+            test.assert("Event not active below watermark.", !is_active(event));
+        }
+
+        source.push(3);
+        this_thread::sleep_for(chrono::milliseconds(5));
+        test.assert("Event active at watermark.", is_active(event));
+
+        event.clear();
+
+        int v;
+        int count = 0;
+        while(sink.pop(v))
+            ++count;
+
+        test.assert("Popped 4 items.", count == 4);
+    }
+
+    {
+        // Bulk push across the watermark
+
+        int data[5] = { 0, 1, 2, 3, 4 };
+        source.push(5, data);
+        this_thread::sleep_for(chrono::milliseconds(5));
+        test.assert("Event active after bulk push.", is_active(event));
+        event.clear();
+
+        int output[5];
+        test.assert("Popped bulk.", sink.pop(5, output));
+    }
+
+    return test.success();
+}
+
+static bool test_wake_max_latency()
+{
+    Test test;
+
+    Stream_Wake_Policy policy;
+    policy.high_watermark = 100;
+    policy.max_latency = chrono::milliseconds(100);
+
+    Stream_Producer<int> source;
+    Stream_Consumer<int> sink(200, policy);
+
+    connect(source, sink);
+
+    auto event = sink.receive_event();
+
+    for (int rep = 0; rep < 3; ++rep)
+    {
+        auto start = chrono::steady_clock::now();
+
+        for (int i = 0; i < 10; ++i)
+            source.push(i);
+
+        test.assert("Event not active before deadline.", !is_active(event));
+
+        wait(event);
+
+        double elapsed = Testing::time_since(start);
+        test.assert("Elapsed time ~= 0.1: " + to_string(elapsed), elapsed > 0.09 && elapsed < 0.15);
+
+        int v;
+        int count = 0;
+        while(sink.pop(v))
+            ++count;
+
+        test.assert("Popped 10 items.", count == 10);
+    }
+
+    return test.success();
+}
+
+static bool test_wake_watermark_before_latency()
+{
+    Test test;
+
+    Stream_Wake_Policy policy;
+    policy.high_watermark = 4;
+    policy.max_latency = chrono::milliseconds(100);
+
+    Stream_Producer<int> source;
+    Stream_Consumer<int> sink(10, policy);
+
+    connect(source, sink);
+
+    auto event = sink.receive_event();
+
+    for (int rep = 0; rep < 3; ++rep)
+    {
+        // The latency deadline armed by the first item
+        // must not delay the wake at the watermark.
+        for (int i = 0; i < 4; ++i)
+            source.push(i);
+
+        this_thread::sleep_for(chrono::milliseconds(5));
+        test.assert("Event active at watermark.", is_active(event));
+
+        event.clear();
+
+        int v;
+        while(sink.pop(v)) {}
+
+        // The expired deadline must not prevent arming a new one.
+        auto start = chrono::steady_clock::now();
+
+        source.push(0);
+
+        this_thread::sleep_for(chrono::milliseconds(5));
+        test.assert("Event not active before deadline.", !is_active(event));
+
+        wait(event);
+
+        double elapsed = Testing::time_since(start);
+        test.assert("Elapsed time ~= 0.1: " + to_string(elapsed), elapsed > 0.09 && elapsed < 0.15);
+
+        event.clear();
+        while(sink.pop(v)) {}
+    }
+
+    return test.success();
+}
+
+static bool test_one_to_one_threads()
+{
+    Test test;
+
+    Stream_Producer<int> source;
+    Stream_Consumer<int> sink(64);
+
+    connect(source, sink);
+
+    int count = 200000;
+    atomic<bool> done { false };
+
+    thread producer([&]()
+    {
+        for (int i = 1; i <= count; ++i)
+        {
+            // Avoid dropping items
+            while(sink.data().lane.full()) {}
+            source.push(i);
+        }
+        done = true;
+    });
+
+    int last = 0;
+    bool ordered = true;
+
+    while(!done || !sink.empty())
+    {
+        int v;
+        if (!sink.pop(v))
+            continue;
+        if (v <= last)
+            ordered = false;
+        last = v;
+    }
+
+    producer.join();
+
+    test.assert("Only the SPSC lane used.", sink.data().queue.size() == 0);
+    test.assert("Items are ordered.", ordered);
+    test.assert("Received last item.", last == count);
+
+    return test.success();
+}
+
+static bool test_switch_producers()
+{
+    Test test;
+
+    Stream_Producer<int> source1;
+    Stream_Producer<int> source2;
+    Stream_Consumer<int> sink(100);
+
+    connect(source1, sink);
+
+    // Only one producer: uses the SPSC lane.
+
+    source1.push(1);
+    source1.push(2);
+
+    test.assert("Source 1 owns lane.", sink.data().lane_owner == source1.id());
+
+    connect(source2, sink);
+
+    // Source 1 keeps the lane until it is empty.
+
+    source1.push(3);
+    source2.push(100);
+
+    test.assert("Source 1 still owns lane.", sink.data().lane_owner == source1.id());
+
+    vector<int> received;
+
+    int v;
+    while(sink.pop(v))
+        received.push_back(v);
+
+    // Lane is empty, so source 1 switches to the MPSC queue.
+
+    source1.push(4);
+    source2.push(200);
+    source1.push(5);
+
+    test.assert("Lane released.", sink.data().lane_owner == nullptr);
+
+    disconnect(source2, sink);
+
+    // Source 1 is alone again, but the queue is not empty yet.
+
+    source1.push(6);
+
+    test.assert("Lane not claimed.", sink.data().lane_owner == nullptr);
+
+    while(sink.pop(v))
+        received.push_back(v);
+
+    source1.push(7);
+
+    test.assert("Lane claimed again.", sink.data().lane_owner == source1.id());
+
+    while(sink.pop(v))
+        received.push_back(v);
+
+    vector<int> expected = { 1, 2, 3, 100, 4, 200, 5, 6, 7 };
+
+    test.assert("Received all items in order.", received == expected);
+
+    return test.success();
+}
+
+static bool test_transaction_producers()
+{
+    Test test;
+
+    Stream_Consumer<int> sink(100);
+
+    {
+        Stream_Producer<int> source1;
+        Stream_Producer<int> source2;
+
+        Topology_Transaction<Stream_Buffer<int>> transaction;
+        transaction.connect(source1, sink);
+        transaction.connect(source2, sink);
+        transaction.commit();
+
+        test.assert("Producers counted.", sink.data().producers == 2);
+
+        transaction.disconnect(source2, sink);
+        transaction.commit();
+
+        test.assert("Disconnected producer not counted.", sink.data().producers == 1);
+
+        // Disconnecting again has no effect.
+        disconnect(source2, sink);
+
+        test.assert("Producer not counted twice.", sink.data().producers == 1);
+    }
+
+    test.assert("Destroyed producer not counted.", sink.data().producers == 0);
+
+    Stream_Producer<int> source3;
+    connect(source3, sink);
+
+    source3.push(1);
+
+    test.assert("Lane used by new producer.", sink.data().lane_owner == source3.id());
+
+    int v = 0;
+    test.assert("Received item.", sink.pop(v) && v == 1);
+
+    return test.success();
+}
+
+static bool test_switch_producers_threads()
+{
+    Test test;
+
+    Stream_Producer<int> source1;
+    Stream_Consumer<int> sink(64);
+
+    connect(source1, sink);
+
+    int count = 200000;
+    atomic<bool> done { false };
+
+    // Source 2 connects and disconnects repeatedly while source 1 pushes,
+    // so source 1 switches between the lane and the MPSC queue.
+
+    thread producer1([&]()
+    {
+        for (int i = 1; i <= count; ++i)
+        {
+            source1.push(i);
+        }
+        done = true;
+    });
+
+    thread producer2([&]()
+    {
+        while(!done)
+        {
+            Stream_Producer<int> source2;
+            connect(source2, sink);
+            for (int i = 0; i < 10; ++i)
+                source2.push(-1);
+        }
+    });
+
+    int last = 0;
+    bool ordered = true;
+    int received = 0;
+
+    while(!done || !sink.empty())
+    {
+        int v;
+        if (!sink.pop(v))
+            continue;
+        if (v < 0)
+            continue;
+        if (v <= last)
+            ordered = false;
+        last = v;
+        ++received;
+    }
+
+    producer1.join();
+    producer2.join();
+
+    test.assert("Items from source 1 are ordered.", ordered);
+    test.assert("Received items from source 1.", received > 0);
+
+    return test.success();
+}
+
+static bool test_distribute_round_robin()
+{
+    Test test;
+
+    Stream_Distributor<int> source;
+    Stream_Consumer<int> sinks[3] = { {10}, {10}, {10} };
+
+    test.assert("Push without consumers fails.", !source.push(0));
+
+    for (auto & sink : sinks)
+        connect(source, sink);
+
+    for (int i = 0; i < 9; ++i)
+        test.assert("Pushed.", source.push(i));
+
+    for (auto & sink : sinks)
+    {
+        vector<int> received;
+        int v;
+        while(sink.pop(v))
+            received.push_back(v);
+
+        test.assert("Received 3 items.", received.size() == 3);
+        if (received.size() == 3)
+        {
+            test.assert("Items are in turns.",
+                        received[1] == received[0] + 3 && received[2] == received[1] + 3);
+        }
+    }
+
+    return test.success();
+}
+
+static bool test_distribute_least_occupied()
+{
+    Test test;
+
+    Stream_Distributor<int> source(Stream_Distribution::Least_Occupied);
+    Stream_Consumer<int> sink1(10);
+    Stream_Consumer<int> sink2(10);
+
+    connect(source, sink1);
+    connect(source, sink2);
+
+    for (int i = 0; i < 4; ++i)
+        source.push(i);
+
+    int v;
+    while(sink1.pop(v)) {}
+
+    // Sink 1 is empty, sink 2 has 2 items.
+
+    source.push(10);
+    source.push(11);
+
+    int count1 = 0;
+    while(sink1.pop(v))
+        ++count1;
+
+    int count2 = 0;
+    while(sink2.pop(v))
+        ++count2;
+
+    test.assert("Sink 1 received 2 items: " + to_string(count1), count1 == 2);
+    test.assert("Sink 2 has 2 items: " + to_string(count2), count2 == 2);
+
+    return test.success();
+}
+
+static bool test_distribute_by_key()
+{
+    Test test;
+
+    Stream_Distributor<int> source;
+    Stream_Consumer<int> sinks[4] = { {100}, {100}, {100}, {100} };
+
+    for (int i = 0; i < 3; ++i)
+        connect(source, sinks[i]);
+
+    auto assignment = [&]()
+    {
+        vector<int> result(20, -1);
+        for (int key = 0; key < 20; ++key)
+        {
+            source.push(key, key);
+            for (int s = 0; s < 4; ++s)
+            {
+                int v;
+                if (sinks[s].pop(v))
+                    result[key] = s;
+            }
+        }
+        return result;
+    };
+
+    auto first = assignment();
+    auto second = assignment();
+
+    test.assert("All keys assigned.", std::count(first.begin(), first.end(), -1) == 0);
+    test.assert("Assignment is stable.", first == second);
+
+    connect(source, sinks[3]);
+
+    auto third = assignment();
+
+    for (int key = 0; key < 20; ++key)
+    {
+        test.assert("Key kept or moved to new consumer.",
+                    third[key] == first[key] || third[key] == 3);
+    }
+
+    return test.success();
+}
+
 Test_Set stream_tests()
 {
     return {
@@ -308,5 +818,16 @@ Test_Set stream_tests()
         { "many to one", test_many_to_one },
         { "bulk", test_bulk },
         { "bulk-array", test_bulk_array },
+        { "wake on every push", test_wake_on_every_push },
+        { "wake at high watermark", test_wake_high_watermark },
+        { "wake after max latency", test_wake_max_latency },
+        { "wake at watermark before max latency", test_wake_watermark_before_latency },
+        { "one to one threads", test_one_to_one_threads },
+        { "switch producers", test_switch_producers },
+        { "switch producers threads", test_switch_producers_threads },
+        { "transaction producers", test_transaction_producers },
+        { "distribute round robin", test_distribute_round_robin },
+        { "distribute least occupied", test_distribute_least_occupied },
+        { "distribute by key", test_distribute_by_key },
     };
 }
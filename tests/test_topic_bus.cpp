@@ -0,0 +1,222 @@
+#include "../stitch/topic_bus.h"
+#include "../testing/testing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Stitch;
+using namespace Testing;
+using namespace std;
+
+static vector<int> received(Topic_Subscriber<int> & subscriber)
+{
+    vector<int> values;
+    int v;
+    while (subscriber.pop(v))
+        values.push_back(v);
+    return values;
+}
+
+static bool test_exact()
+{
+    Test test;
+
+    Topic_Bus<int> bus;
+
+    Topic_Subscriber<int> a(bus, 100);
+    Topic_Subscriber<int> b(bus, 100);
+
+    a.subscribe("sensors/temperature");
+    b.subscribe("sensors/pressure");
+
+    auto temperature = bus.topic("sensors/temperature");
+    auto pressure = bus.topic("sensors/pressure");
+    auto other = bus.topic("other");
+
+    test.assert("Topic name.", temperature.name() == "sensors/temperature");
+    test.assert("Topic has subscribers.", temperature.has_subscribers());
+    test.assert("Topic without subscribers.", !other.has_subscribers());
+
+    temperature.publish(1);
+    pressure.publish(2);
+    other.publish(3);
+
+    test.assert("A received temperature.", received(a) == vector<int>({ 1 }));
+    test.assert("B received pressure.", received(b) == vector<int>({ 2 }));
+
+    test.assert("Same topic for same name.", bus.topic("sensors/temperature").has_subscribers());
+
+    return test.success();
+}
+
+static bool test_prefix()
+{
+    Test test;
+
+    Topic_Bus<int> bus;
+
+    // Topic created before the subscription
+    auto temperature = bus.topic("sensors/temperature");
+
+    Topic_Subscriber<int> subscriber(bus, 100);
+    subscriber.subscribe("sensors/", Topic_Match::Prefix);
+    // Also matches exactly; items must be received once.
+    subscriber.subscribe("sensors/temperature");
+
+    // Topics created after the subscription
+    auto pressure = bus.topic("sensors/pressure");
+    auto other = bus.topic("sensorsX");
+
+    temperature.publish(1);
+    pressure.publish(2);
+    other.publish(3);
+
+    test.assert("Received matching topics once.", received(subscriber) == vector<int>({ 1, 2 }));
+
+    subscriber.unsubscribe("sensors/", Topic_Match::Prefix);
+
+    temperature.publish(4);
+    pressure.publish(5);
+
+    test.assert("Exact subscription kept.", received(subscriber) == vector<int>({ 4 }));
+
+    subscriber.unsubscribe("sensors/temperature");
+
+    test.assert("No subscribers left.", !temperature.has_subscribers());
+
+    return test.success();
+}
+
+static bool test_lifetime()
+{
+    Test test;
+
+    auto bus = make_unique<Topic_Bus<int>>();
+    auto topic = bus->topic("a");
+
+    auto subscriber = make_unique<Topic_Subscriber<int>>(*bus, 100);
+    subscriber->subscribe("a");
+
+    test.assert("Subscribed.", topic.has_subscribers());
+
+    subscriber.reset();
+
+    test.assert("Destroyed subscriber unsubscribed.", !topic.has_subscribers());
+
+    subscriber = make_unique<Topic_Subscriber<int>>(*bus, 100);
+    subscriber->subscribe("a");
+
+    // The topic and subscriber outlive the bus.
+    bus.reset();
+
+    topic.publish(1);
+
+    test.assert("Published after bus destroyed.", received(*subscriber) == vector<int>({ 1 }));
+
+    subscriber.reset();
+
+    test.assert("Unsubscribed after bus destroyed.", !topic.has_subscribers());
+
+    return test.success();
+}
+
+static bool test_stream_producer()
+{
+    Test test;
+
+    Topic_Bus<int> bus;
+    Topic_Subscriber<int> subscriber(bus, 100);
+    Stream_Producer<int> producer;
+
+    subscriber.subscribe("a");
+    connect(producer, subscriber);
+
+    bus.topic("a").publish(1);
+    producer.push(2);
+
+    auto values = received(subscriber);
+    sort(values.begin(), values.end());
+
+    test.assert("Received from topic and producer.", values == vector<int>({ 1, 2 }));
+
+    return test.success();
+}
+
+static bool test_concurrent()
+{
+    Test test;
+
+    Topic_Bus<int> bus;
+
+    int count = 20000;
+    int publisher_count = 2;
+
+    Topic_Subscriber<int> subscriber(bus, count * publisher_count);
+    subscriber.subscribe("p/", Topic_Match::Prefix);
+
+    atomic<bool> done { false };
+
+    // Subscriptions of other subscribers change while publishing.
+    thread churn([&]()
+    {
+        while (!done)
+        {
+            Topic_Subscriber<int> other(bus, 10);
+            other.subscribe("p/", Topic_Match::Prefix);
+            this_thread::yield();
+        }
+    });
+
+    vector<thread> publishers;
+    for (int p = 0; p < publisher_count; ++p)
+    {
+        publishers.emplace_back([&, p]()
+        {
+            auto topic = bus.topic("p/" + to_string(p));
+            for (int i = 0; i < count; ++i)
+            {
+                topic.publish(p * count + i);
+                if (i % 100 == 0)
+                    this_thread::yield();
+            }
+        });
+    }
+
+    for (auto & t : publishers)
+        t.join();
+
+    done = true;
+    churn.join();
+
+    auto values = received(subscriber);
+
+    // Items of each topic are received in order.
+    bool ordered = true;
+    int last[2] = { -1, -1 };
+    for (int v : values)
+    {
+        int p = v / count;
+        ordered &= v > last[p];
+        last[p] = v;
+    }
+
+    test.assert("Received all: " + to_string(values.size()), (int) values.size() == count * publisher_count);
+    test.assert("Received in order.", ordered);
+
+    return test.success();
+}
+
+Test_Set topic_bus_tests()
+{
+    return {
+        { "exact", test_exact },
+        { "prefix", test_prefix },
+        { "lifetime", test_lifetime },
+        { "stream-producer", test_stream_producer },
+        { "concurrent", test_concurrent },
+    };
+}